@@ -0,0 +1,38 @@
+#ifndef LIGHT_CLUSTERS_GLSL
+#define LIGHT_CLUSTERS_GLSL
+
+// Light lists of the view frustum clusters built by LightClusters, a cluster
+// holds the offset of its first index and its point and spot light counts
+// packed into the low and high 16 bits. The grid size is defined by the
+// program, clusterDepthRange holds the near and far planes of the camera.
+uniform usamplerBuffer lightClusters;
+uniform usamplerBuffer lightIndices;
+uniform vec4 clusterScale;
+uniform vec2 clusterDepthRange;
+
+struct LightCluster {
+    int firstIndex;
+    int numPointLights;
+    int numSpotLights;
+};
+
+LightCluster fetchLightCluster(vec4 fragCoord) {
+    float near = clusterDepthRange.x;
+    float far = clusterDepthRange.y;
+    float viewDepth = near * far / (far - fragCoord.z * (far - near));
+    ivec3 grid = ivec3(CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z);
+    ivec3 cell = ivec3(fragCoord.xy * clusterScale.xy, log(viewDepth) * clusterScale.z + clusterScale.w);
+    cell = clamp(cell, ivec3(0), grid - 1);
+    uvec2 range = texelFetch(lightClusters, (cell.z * grid.y + cell.y) * grid.x + cell.x).xy;
+    LightCluster cluster;
+    cluster.firstIndex = int(range.x);
+    cluster.numPointLights = int(range.y & 0xffffu);
+    cluster.numSpotLights = int(range.y >> 16);
+    return cluster;
+}
+
+int fetchClusterLightIndex(int index) {
+    return int(texelFetch(lightIndices, index).x);
+}
+
+#endif
@@ -1,27 +1,29 @@
 #ifndef LIGHTING_GLSL
 #define LIGHTING_GLSL
 
-struct LightColor {  // 48 bytes
+struct LightColor {
     vec3 ambient;
     vec3 diffuse;
     vec3 specular;
 };
 
-struct PointLight {  // 64 bytes
+struct PointLight {
     LightColor color;
     vec3 position;
     float radius;
+    float range;
 };
 
-struct DirLight {  // 64 bytes
+struct DirLight {
     LightColor color;
     vec3 direction;
 };
 
-struct SpotLight {  // 96 bytes
+struct SpotLight {
     LightColor color;
     vec3 position;
     float radius;
+    float range;
     vec3 direction;
     float inner;
     float outer;
@@ -33,8 +35,10 @@ struct MaterialColor {
     float shininess;
 };
 
-float lightDistanceAtt(float distance, float radius) {
-    return pow(radius / max(distance, radius), 2.0f);
+// Inverse square falloff, windowed to reach zero at the range of the light
+float lightDistanceAtt(float distance, float radius, float range) {
+    float window = clamp(1.0f - pow(distance / range, 4.0f), 0.0f, 1.0f);
+    return pow(radius / max(distance, radius), 2.0f) * window * window;
 }
 
 float lightAngleAtt(float angle, float inner, float outer) {
@@ -61,14 +65,14 @@ vec3 dirLightLighting(DirLight dl, vec3 fragPos, vec3 fragNormal, vec3 cameraDir
 
 vec3 pointLightLighting(PointLight pl, vec3 fragPos, vec3 fragNormal, vec3 cameraDir, MaterialColor fragMaterial, float lightingFactor) {
     vec3 resLighting = generalLighting(pl.color, fragNormal, normalize(pl.position - fragPos), cameraDir, fragMaterial, lightingFactor);
-    resLighting *= lightDistanceAtt(length(pl.position - fragPos), pl.radius);
+    resLighting *= lightDistanceAtt(length(pl.position - fragPos), pl.radius, pl.range);
     return resLighting;
 }
 
 vec3 spotLightLighting(SpotLight sl, vec3 fragPos, vec3 fragNormal, vec3 cameraDir, MaterialColor fragMaterial, float lightingFactor) {
     vec3 lightDir = normalize(sl.position - fragPos);
     vec3 resLighting = generalLighting(sl.color, fragNormal, lightDir, cameraDir, fragMaterial, lightingFactor);
-    resLighting *= lightDistanceAtt(length(sl.position - fragPos), sl.radius);
+    resLighting *= lightDistanceAtt(length(sl.position - fragPos), sl.radius, sl.range);
     resLighting *= lightAngleAtt(dot(-lightDir, sl.direction), sl.inner, sl.outer);
     return resLighting;
 }
@@ -0,0 +1,64 @@
+#ifndef LIGHT_STORAGE_GLSL
+#define LIGHT_STORAGE_GLSL
+#include "lighting.glsl"
+
+// Lights packed into vec4 texels by LightStorage, the including shader
+// enables GL_ARB_shader_storage_buffer_object when LIGHT_STORAGE_SSBO is set.
+// The w of the first texel holds the range of point and spot lights.
+#define POINT_LIGHT_TEXELS 4
+#define SPOT_LIGHT_TEXELS 6
+#define DIR_LIGHT_TEXELS 4
+
+#if LIGHT_STORAGE_SSBO
+layout(std430) buffer LightStorageBlock {
+    vec4 lightTexels[];
+};
+#define fetchLightTexel(texel) lightTexels[texel]
+#else
+uniform samplerBuffer lightStorage;
+#define fetchLightTexel(texel) texelFetch(lightStorage, texel)
+#endif
+
+LightColor fetchLightColor(int texel) {
+    LightColor color;
+    color.ambient = fetchLightTexel(texel).xyz;
+    color.diffuse = fetchLightTexel(texel + 1).xyz;
+    color.specular = fetchLightTexel(texel + 2).xyz;
+    return color;
+}
+
+PointLight fetchPointLight(int firstTexel, int i) {
+    int texel = firstTexel + POINT_LIGHT_TEXELS * i;
+    vec4 positionRadius = fetchLightTexel(texel + 3);
+    PointLight pl;
+    pl.color = fetchLightColor(texel);
+    pl.position = positionRadius.xyz;
+    pl.radius = positionRadius.w;
+    pl.range = fetchLightTexel(texel).w;
+    return pl;
+}
+
+SpotLight fetchSpotLight(int firstTexel, int i) {
+    int texel = firstTexel + SPOT_LIGHT_TEXELS * i;
+    vec4 positionRadius = fetchLightTexel(texel + 3);
+    vec4 directionInner = fetchLightTexel(texel + 4);
+    SpotLight sl;
+    sl.color = fetchLightColor(texel);
+    sl.position = positionRadius.xyz;
+    sl.radius = positionRadius.w;
+    sl.range = fetchLightTexel(texel).w;
+    sl.direction = directionInner.xyz;
+    sl.inner = directionInner.w;
+    sl.outer = fetchLightTexel(texel + 5).x;
+    return sl;
+}
+
+DirLight fetchDirLight(int firstTexel, int i) {
+    int texel = firstTexel + DIR_LIGHT_TEXELS * i;
+    DirLight dl;
+    dl.color = fetchLightColor(texel);
+    dl.direction = fetchLightTexel(texel + 3).xyz;
+    return dl;
+}
+
+#endif
@@ -0,0 +1,8 @@
+#version 330 core
+out vec4 fColor;
+
+uniform vec4 barColor;
+
+void main() {
+    fColor = barColor;
+}
@@ -0,0 +1,9 @@
+#version 330 core
+layout(location = 0) in vec2 vPos;
+
+uniform vec4 rect;
+
+void main() {
+    vec2 pos = rect.xy + (vPos * 0.5f + 0.5f) * rect.zw;
+    gl_Position = vec4(pos, 0.0f, 1.0f);
+}
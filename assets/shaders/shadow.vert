@@ -1,8 +1,33 @@
 #version 330 core
+// Layered instancing picks the layer per instance in the vertex shader, the
+// geometry shader path amplifies every triangle into all layers instead
+#ifndef LAYERED_INSTANCING
+#define LAYERED_INSTANCING 0
+#endif
+#if LAYERED_INSTANCING
+#ifdef GL_ARB_shader_viewport_layer_array
+#extension GL_ARB_shader_viewport_layer_array : require
+#else
+#extension GL_AMD_vertex_shader_layer : require
+#endif
+#define MAX_LIGHT_TRANSFORMS 60
+#endif
 layout(location = 0) in vec3 vPos;
+layout(location = 3) in mat4 model;
 
-uniform mat4 model;
+#if LAYERED_INSTANCING
+// Shadow casters carry their layer in place of the material
+layout(location = 10) in vec3 instanceLayer;
 
+uniform mat4 lightTransforms[MAX_LIGHT_TRANSFORMS];
+
+void main() {
+    int layer = int(instanceLayer.x);
+    gl_Layer = layer;
+    gl_Position = lightTransforms[layer] * model * vec4(vPos, 1.0f);
+}
+#else
 void main() {
     gl_Position = model * vec4(vPos, 1.0f);
 }
+#endif
@@ -8,6 +8,7 @@ out VERT_OUT {
     vec3 pos;
     vec3 normal;
     vec2 tex;
+    flat vec3 material;
 }
 vOut;
 
@@ -20,6 +21,7 @@ matrices;
 uniform mat4 model;
 uniform float freq;
 uniform float time;
+uniform float shininess;
 
 void main() {
     float phase = gl_InstanceID;
@@ -28,5 +30,6 @@ void main() {
     vOut.pos = worldPos.xyz;
     vOut.normal = vNormal;
     vOut.tex = vec2(0.0f);
+    vOut.material = vec3(0.0f, 0.0f, shininess);
     gl_Position = matrices.projection * matrices.view * worldPos;
 }
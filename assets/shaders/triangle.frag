@@ -1,51 +1,89 @@
 #version 330 core
 #extension GL_ARB_texture_cube_map_array : require
-#define MAX_POINT_LIGHTS 10
-#define MAX_DIR_LIGHTS 10
-#define MAX_SPOT_LIGHTS 10
+#if LIGHT_STORAGE_SSBO
+#extension GL_ARB_shader_storage_buffer_object : require
+#endif
+#define MAX_SHADOWED_POINT_LIGHTS 10
+#define MAX_SHADOWED_DIR_LIGHTS 10
+#define MAX_SHADOWED_SPOT_LIGHTS 10
 #define MAX_DIR_LIGHT_CASCADES 4
-#include "lighting.glsl"
-
-struct Material {
-    sampler2D diffuseMap;
-    sampler2D specularMap;
-    float shininess;
-};
-
+#include "lightstorage.glsl"
+#include "lightclusters.glsl"
+
+// Permutations define the light counts, the cascade count and whether
+// shadows are sampled, the generic program reads them at runtime
+#ifdef NUM_POINT_LIGHTS
+#define POINT_LIGHT_COUNT NUM_POINT_LIGHTS
+#else
+#define POINT_LIGHT_COUNT lights.numPointLights
+#endif
+#ifdef NUM_SPOT_LIGHTS
+#define SPOT_LIGHT_COUNT NUM_SPOT_LIGHTS
+#else
+#define SPOT_LIGHT_COUNT lights.numSpotLights
+#endif
+#ifdef NUM_DIR_LIGHTS
+#define DIR_LIGHT_COUNT NUM_DIR_LIGHTS
+#else
+#define DIR_LIGHT_COUNT lights.numDirLights
+#endif
+#ifdef NUM_DIR_LIGHT_CASCADES
+#define DIR_LIGHT_CASCADE_COUNT NUM_DIR_LIGHT_CASCADES
+#else
+#define DIR_LIGHT_CASCADE_COUNT dirLightNumCascades
+#endif
+#ifndef SHADOWS
+#define SHADOWS 1
+#endif
+
+// Only the first lights of each type have shadow maps
+#if SHADOWS
+#define SHADOWED_POINT_LIGHT_COUNT min(POINT_LIGHT_COUNT, MAX_SHADOWED_POINT_LIGHTS)
+#define SHADOWED_SPOT_LIGHT_COUNT min(SPOT_LIGHT_COUNT, MAX_SHADOWED_SPOT_LIGHTS)
+#define SHADOWED_DIR_LIGHT_COUNT min(DIR_LIGHT_COUNT, MAX_SHADOWED_DIR_LIGHTS)
+#else
+#define SHADOWED_POINT_LIGHT_COUNT 0
+#define SHADOWED_SPOT_LIGHT_COUNT 0
+#define SHADOWED_DIR_LIGHT_COUNT 0
+#endif
+
+// Diffuse layer, specular layer and shininess
 in VERT_OUT {
     vec3 pos;
     vec3 normal;
     vec2 tex;
+    flat vec3 material;
 }
 fIn;
 
 out vec4 fColor;
 
+// Light parameters are in the light storage, starting at these texels
 layout(std140) uniform LightsBlock {
-    PointLight pointLights[MAX_POINT_LIGHTS];                          // 640 bytes
-    SpotLight spotLights[MAX_SPOT_LIGHTS];                             // 960 bytes
-    DirLight dirLights[MAX_DIR_LIGHTS];                                // 640 bytes
-    mat4 pointLightTransforms[MAX_POINT_LIGHTS];                       // 640 bytes
-    mat4 spotLightTransforms[MAX_SPOT_LIGHTS];                         // 640 bytes
-    mat4 dirLightTransforms[MAX_DIR_LIGHTS * MAX_DIR_LIGHT_CASCADES];  // 2560 bytes
-    int numPointLights;                                                // 4 bytes
-    int numSpotLights;                                                 // 4 bytes
-    int numDirLights;                                                  // 4 bytes
+    mat4 pointLightTransforms[MAX_SHADOWED_POINT_LIGHTS];                       // 640 bytes
+    mat4 spotLightTransforms[MAX_SHADOWED_SPOT_LIGHTS];                         // 640 bytes
+    mat4 dirLightTransforms[MAX_SHADOWED_DIR_LIGHTS * MAX_DIR_LIGHT_CASCADES];  // 2560 bytes
+    int numPointLights;                                                         // 4 bytes
+    int numSpotLights;                                                          // 4 bytes
+    int numDirLights;                                                           // 4 bytes
+    int spotLightsStart;                                                        // 4 bytes
+    int dirLightsStart;                                                         // 4 bytes
 }
 lights;
 
-uniform float pointLightMinSampleSizes[MAX_POINT_LIGHTS];
-uniform float pointLightMaxSampleSizes[MAX_POINT_LIGHTS];
-uniform float spotLightMinSampleSizes[MAX_SPOT_LIGHTS];
-uniform float spotLightMaxSampleSizes[MAX_SPOT_LIGHTS];
-uniform float dirLightSampleSizes[MAX_DIR_LIGHTS * MAX_DIR_LIGHT_CASCADES];
+uniform float pointLightMinSampleSizes[MAX_SHADOWED_POINT_LIGHTS];
+uniform float pointLightMaxSampleSizes[MAX_SHADOWED_POINT_LIGHTS];
+uniform float spotLightMinSampleSizes[MAX_SHADOWED_SPOT_LIGHTS];
+uniform float spotLightMaxSampleSizes[MAX_SHADOWED_SPOT_LIGHTS];
+uniform float dirLightSampleSizes[MAX_SHADOWED_DIR_LIGHTS * MAX_DIR_LIGHT_CASCADES];
 
 uniform vec4 dirLightCascadeNearDepths;
 uniform vec4 dirLightCascadeFarDepths;
 uniform int dirLightNumCascades;
 
 uniform vec3 cameraPos;
-uniform Material material;
+uniform sampler2DArray diffuseMaps;
+uniform sampler2DArray specularMaps;
 
 uniform samplerCubeArrayShadow pointLightShadowMapArray;
 uniform sampler2DArrayShadow spotLightShadowMapArray;
@@ -54,49 +92,69 @@ uniform sampler2DArrayShadow dirLightShadowMapArray;
 void main() {
     vec3 fragPos = fIn.pos;
     vec3 fragNormal = normalize(fIn.normal);
+    vec4 diffuseColor = texture(diffuseMaps, vec3(fIn.tex, fIn.material.x));
     MaterialColor fragMaterial;
-    fragMaterial.diffuseColor = texture(material.diffuseMap, fIn.tex).rgb;
-    fragMaterial.specularColor = texture(material.specularMap, fIn.tex).rgb;
-    fragMaterial.shininess = material.shininess;
+    fragMaterial.diffuseColor = diffuseColor.rgb;
+    fragMaterial.specularColor = texture(specularMaps, vec3(fIn.tex, fIn.material.y)).rgb;
+    fragMaterial.shininess = fIn.material.z;
     vec3 cameraDir = normalize(cameraPos - fragPos);
 
     vec3 resColor = vec3(0.0f, 0.0f, 0.0f);
-    for (int i = 0; i < min(lights.numPointLights, MAX_POINT_LIGHTS); i++) {
-        PointLight pl = lights.pointLights[i];
-        vec3 lightDir = normalize(pl.position - fragPos);
-        resColor += pointLightLighting(pl, fragPos, fragNormal, cameraDir, fragMaterial,
-                                       lightShadowingCube(pointLightShadowMapArray, i, fragPos, fragNormal, lightDir, lights.pointLightTransforms[i], pl.radius, 100.0f, pointLightMinSampleSizes[i], pointLightMaxSampleSizes[i]));
+
+    // Point and spot lights come from the cluster of the fragment, which only
+    // lists the lights whose range reaches it. The first lights of each type
+    // use the shadow map of the same index. Shadow maps have no mipmaps, so
+    // sampling them in divergent branches is fine.
+    LightCluster cluster = fetchLightCluster(gl_FragCoord);
+    for (int j = 0; j < cluster.numPointLights; j++) {
+        int i = fetchClusterLightIndex(cluster.firstIndex + j);
+        if (i < POINT_LIGHT_COUNT) {
+            PointLight pl = fetchPointLight(0, i);
+            float lightFactor = 1.0f;
+            if (i < SHADOWED_POINT_LIGHT_COUNT) {
+                vec3 lightDir = normalize(pl.position - fragPos);
+                lightFactor = lightShadowingCube(pointLightShadowMapArray, i, fragPos, fragNormal, lightDir, lights.pointLightTransforms[i], pl.radius, 100.0f, pointLightMinSampleSizes[i], pointLightMaxSampleSizes[i]);
+            }
+            resColor += pointLightLighting(pl, fragPos, fragNormal, cameraDir, fragMaterial, lightFactor);
+        }
     }
-    for (int i = 0; i < min(lights.numSpotLights, MAX_SPOT_LIGHTS); i++) {
-        SpotLight sl = lights.spotLights[i];
-        vec3 lightDir = normalize(sl.position - fragPos);
-        resColor += spotLightLighting(sl, fragPos, fragNormal, cameraDir, fragMaterial,
-                                      lightShadowing2D(spotLightShadowMapArray, i, fragPos, fragNormal, lightDir, lights.spotLightTransforms[i], spotLightMinSampleSizes[i], spotLightMaxSampleSizes[i]));
+    for (int j = cluster.numPointLights; j < cluster.numPointLights + cluster.numSpotLights; j++) {
+        int i = fetchClusterLightIndex(cluster.firstIndex + j);
+        if (i < SPOT_LIGHT_COUNT) {
+            SpotLight sl = fetchSpotLight(lights.spotLightsStart, i);
+            float lightFactor = 1.0f;
+            if (i < SHADOWED_SPOT_LIGHT_COUNT) {
+                vec3 lightDir = normalize(sl.position - fragPos);
+                lightFactor = lightShadowing2D(spotLightShadowMapArray, i, fragPos, fragNormal, lightDir, lights.spotLightTransforms[i], spotLightMinSampleSizes[i], spotLightMaxSampleSizes[i]);
+            }
+            resColor += spotLightLighting(sl, fragPos, fragNormal, cameraDir, fragMaterial, lightFactor);
+        }
     }
 
+#if SHADOWS
     ivec4 dirLightCascadeSelection = ivec4(
-        dirLightNumCascades > 0,
-        dirLightNumCascades > 1,
-        dirLightNumCascades > 2,
-        dirLightNumCascades > 3);
+        DIR_LIGHT_CASCADE_COUNT > 0,
+        DIR_LIGHT_CASCADE_COUNT > 1,
+        DIR_LIGHT_CASCADE_COUNT > 2,
+        DIR_LIGHT_CASCADE_COUNT > 3);
 
-    for (int i = 0; i < min(lights.numDirLights, MAX_DIR_LIGHTS); i++) {
-        DirLight dl = lights.dirLights[i];
+    for (int i = 0; i < SHADOWED_DIR_LIGHT_COUNT; i++) {
+        DirLight dl = fetchDirLight(lights.dirLightsStart, i);
         vec3 lightDir = normalize(-dl.direction);
 
         ivec4 comparison = ivec4(greaterThanEqual(vec4(gl_FragCoord.z), dirLightCascadeNearDepths));
         int cascadeFarIndex = int(dot(dirLightCascadeSelection, comparison)) - 1;
         comparison = ivec4(lessThanEqual(vec4(gl_FragCoord.z), dirLightCascadeFarDepths));
-        int cascadeNearIndex = dirLightNumCascades - int(dot(dirLightCascadeSelection, comparison));
+        int cascadeNearIndex = DIR_LIGHT_CASCADE_COUNT - int(dot(dirLightCascadeSelection, comparison));
 
-        int iCascadePropertiesFarIndex = dirLightNumCascades * i + cascadeFarIndex;
+        int iCascadePropertiesFarIndex = DIR_LIGHT_CASCADE_COUNT * i + cascadeFarIndex;
         mat4 m4CascadeFarTransform = lights.dirLightTransforms[iCascadePropertiesFarIndex];
         float fCascadeSampleSizeFar = dirLightSampleSizes[iCascadePropertiesFarIndex];
 
         float lightFactor = lightShadowing2D(dirLightShadowMapArray, iCascadePropertiesFarIndex, fragPos, fragNormal, lightDir, m4CascadeFarTransform, fCascadeSampleSizeFar, fCascadeSampleSizeFar);
 
         if (cascadeNearIndex < cascadeFarIndex) {
-            int iCascadePropertiesNearIndex = dirLightNumCascades * i + cascadeNearIndex;
+            int iCascadePropertiesNearIndex = DIR_LIGHT_CASCADE_COUNT * i + cascadeNearIndex;
             mat4 m4CascadeNearTransform = lights.dirLightTransforms[iCascadePropertiesNearIndex];
             float fCascadeSampleSizeNear = dirLightSampleSizes[iCascadePropertiesNearIndex];
 
@@ -107,7 +165,10 @@ void main() {
 
         resColor += dirLightLighting(dl, fragPos, fragNormal, cameraDir, fragMaterial, lightFactor);
     }
+#endif
+    for (int i = SHADOWED_DIR_LIGHT_COUNT; i < DIR_LIGHT_COUNT; i++) {
+        resColor += dirLightLighting(fetchDirLight(lights.dirLightsStart, i), fragPos, fragNormal, cameraDir, fragMaterial, 1.0f);
+    }
 
-    float alpha = texture(material.diffuseMap, fIn.tex).a;
-    fColor = vec4(resColor, alpha);
+    fColor = vec4(resColor, diffuseColor.a);
 }
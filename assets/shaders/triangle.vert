@@ -2,11 +2,15 @@
 layout(location = 0) in vec3 vPos;
 layout(location = 1) in vec3 vNormal;
 layout(location = 2) in vec2 vTex;
+layout(location = 3) in mat4 model;
+layout(location = 7) in mat3 normal;
+layout(location = 10) in vec3 material;
 
 out VERT_OUT {
     vec3 pos;
     vec3 normal;
     vec2 tex;
+    flat vec3 material;
 }
 vOut;
 
@@ -16,12 +20,10 @@ layout(std140) uniform MatrixBlock {
 }
 matrices;
 
-uniform mat4 model;
-uniform mat3 normal;
-
 void main() {
     vOut.pos = vec3(model * vec4(vPos, 1.0f));
     vOut.normal = normal * vNormal;
     vOut.tex = vTex;
+    vOut.material = material;
     gl_Position = matrices.projection * matrices.view * model * vec4(vPos, 1.0f);
 }
@@ -0,0 +1,78 @@
+#pragma once
+#include "glad.h"
+
+#include <glm/vec3.hpp>
+
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+class Camera;
+
+struct CameraKeyframe {
+    float time;
+    glm::vec3 position;
+    float yaw;
+    float pitch;
+};
+
+struct BenchmarkConfiguration {
+    std::string name;
+    bool bMSAA;
+    bool bTAA;
+    bool bBloom;
+    bool bSnow;
+    bool bSkybox;
+};
+
+class Benchmark {
+public:
+    static constexpr float TIMESTEP = 1.0f / 60.0f;
+    static constexpr int WARMUP_FRAMES = 30;
+    static constexpr unsigned RANDOM_SEED = 1;
+
+    Benchmark();
+    Benchmark(const Benchmark& other) = delete;
+    Benchmark(Benchmark&& other) = delete;
+    ~Benchmark();
+
+    bool loadCameraPath(const std::filesystem::path& pathFile);
+
+    int getNumFrames() const;
+    const BenchmarkConfiguration& getConfiguration(int frameNumber) const;
+    float getFrameTime(int frameNumber) const;
+    void applyCameraPath(Camera& camera, int frameNumber) const;
+
+    void beginFrame(int frameNumber);
+    void endFrame();
+    void finish();
+    bool writeReport(const std::filesystem::path& reportFile) const;
+
+private:
+    struct FrameSample {
+        int configurationIndex;
+        double cpuTime;
+        double gpuTime;
+    };
+
+    struct PendingQuery {
+        GLuint startQuery = 0;
+        GLuint endQuery = 0;
+        int sampleIndex = -1;
+    };
+
+    std::vector<CameraKeyframe> keyframes;
+    std::vector<BenchmarkConfiguration> configurations;
+    int framesPerConfiguration = 0;
+
+    std::array<PendingQuery, 4> queries;
+    std::size_t currentQuery = 0;
+    std::vector<FrameSample> samples;
+    int currentSample = -1;
+    std::chrono::steady_clock::time_point frameStart;
+
+    CameraKeyframe sampleCameraPath(float time) const;
+    void collectQuery(PendingQuery& pendingQuery, bool bWait);
+};
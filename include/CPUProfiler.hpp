@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct CPUZoneEvent {
+    const char* name;
+    std::int64_t startTime;
+    std::int64_t endTime;
+};
+
+// Records named CPU zones into a fixed size ring buffer owned by the calling
+// thread, so recording a zone takes no locks and never allocates. Once a ring
+// is full the oldest zones are overwritten. The captured zones are exported
+// in the Chrome trace_event JSON format, which Perfetto and chrome://tracing
+// can open. Zone names must be string literals, only the pointer is stored.
+class CPUProfiler {
+public:
+    CPUProfiler() = delete;
+
+    static std::int64_t now();
+    static void recordZone(const char* zoneName, std::int64_t startTime, std::int64_t endTime);
+    static void setThreadName(const std::string& threadName);
+
+    // Must be called while no other thread is recording zones
+    static bool writeTrace(const std::filesystem::path& tracePath);
+
+    static bool bEnabled;
+
+private:
+    static constexpr std::size_t RING_SIZE = 1 << 16;
+
+    struct ThreadBuffer {
+        std::vector<CPUZoneEvent> events;
+        std::atomic<std::size_t> numRecorded = 0;
+        unsigned threadId = 0;
+        std::string threadName;
+    };
+
+    static std::chrono::steady_clock::time_point epoch;
+    static std::mutex threadBuffersMutex;
+    static std::vector<std::unique_ptr<ThreadBuffer>> threadBuffers;
+
+    static ThreadBuffer& getThreadBuffer();
+};
+
+class ScopedCPUZone {
+public:
+    explicit ScopedCPUZone(const char* zoneName) : zoneName(zoneName) {
+        if (CPUProfiler::bEnabled) {
+            this->startTime = CPUProfiler::now();
+        }
+    }
+    ScopedCPUZone(const ScopedCPUZone& other) = delete;
+    ~ScopedCPUZone() {
+        if (this->startTime >= 0) {
+            CPUProfiler::recordZone(this->zoneName, this->startTime, CPUProfiler::now());
+        }
+    }
+
+private:
+    const char* zoneName;
+    std::int64_t startTime = -1;
+};
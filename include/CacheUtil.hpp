@@ -0,0 +1,27 @@
+#pragma once
+
+#include "MappedFile.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// Hashing, bounds checks and file writes shared by the on disk caches
+class CacheUtil {
+public:
+    static constexpr std::uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ull;
+
+    CacheUtil() = delete;
+
+    // 64 bit FNV-1a, pass a previous hash to continue it
+    static std::uint64_t fnv1a(const std::byte* data, std::size_t size, std::uint64_t hash = FNV_OFFSET_BASIS);
+    // Whether size bytes from offset lie within the file, without overflowing
+    static bool isInside(const MappedFile& file, std::uint64_t offset, std::uint64_t size);
+    // The file is written under a temporary name unique to this call and
+    // renamed into place, so concurrent readers never see it partially
+    // written and concurrent writers of the same file do not collide. The
+    // temporary file is removed if either step fails. Missing directories
+    // are created.
+    static bool writeFile(const std::filesystem::path& filePath, const std::vector<std::byte>& contents);
+};
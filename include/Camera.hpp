@@ -9,6 +9,8 @@ public:
     glm::vec3 getCameraForwardVector();
     glm::vec3 getCameraRightVector();
     glm::vec3 getCameraUpVector();
+    float getPitch();
+    float getYaw();
 
     void addPitch(float degrees);
     void addYaw(float degrees);
@@ -47,10 +47,15 @@ public:
     static void enableCameraLook();
     static void disableCameraLook();
 
-    static void initialize(int viewportW, int viewportH);
+    static bool initialize(int viewportW, int viewportH, bool bHeadless = false);
     static void terminate();
 
     static GLFWwindow* getWindow();
+    static bool isHeadless();
+    static bool shouldClose();
+    static void swapBuffers();
+    static double getTime();
+    static void* getProcAddress(const char* procName);
 
     static bool bInvertMouseX;
     static bool bInvertMouseY;
@@ -67,6 +72,10 @@ private:
     static glm::mat4 projection;
 
     static GLFWwindow* currentWindow;
+    static bool bHeadless;
+    static void* headlessDisplay;
+    static void* headlessSurface;
+    static void* headlessContext;
     static float mouseX;
     static float mouseY;
     static bool bStartup;
@@ -78,4 +87,7 @@ private:
 
     static void updateProjectionMatrix();
     static void updateViewMatrix();
+
+    static bool initializeWindow(int viewportW, int viewportH);
+    static bool initializeHeadless(int viewportW, int viewportH);
 };
@@ -0,0 +1,45 @@
+#pragma once
+#include "glad.h"
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+// Data rewritten every frame, such as uniform blocks, laid out once with
+// reserve and then written straight into buffer memory. With
+// GL_ARB_buffer_storage the buffer holds NUM_FRAMES copies of the layout and
+// stays persistently mapped, frames use the copies round robin and
+// beginFrame only waits for the fence of the frame that last used the copy
+// it is about to overwrite. Without the extension the frame is written into
+// CPU memory and flush orphans the buffer with it, one upload per frame.
+// Data is written between beginFrame and flush and used by draws between
+// flush and endFrame.
+class FrameRingBuffer {
+public:
+    static constexpr std::size_t NUM_FRAMES = 3;
+
+    FrameRingBuffer() = default;
+    FrameRingBuffer(const FrameRingBuffer& other) = delete;
+    ~FrameRingBuffer();
+
+    // Offset of a new range within each frame, aligned for binding it as a uniform block
+    GLintptr reserve(GLsizeiptr size);
+    void create();
+    void free();
+
+    void beginFrame();
+    std::byte* getPointer(GLintptr offset);
+    void flush();
+    void bindRange(GLenum target, GLuint index, GLintptr offset, GLsizeiptr size) const;
+    void endFrame();
+
+    static bool isPersistentMappingSupported();
+
+private:
+    GLuint buffer = 0;
+    GLsizeiptr frameSize = 0;
+    std::size_t currentFrame = 0;
+    std::byte* mappedData = nullptr;
+    std::vector<std::byte> stagingData;
+    std::array<GLsync, NUM_FRAMES> fences = {};
+};
@@ -0,0 +1,55 @@
+#pragma once
+#include "glad.h"
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+struct BoundingSphere {
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+};
+
+// Centered on the bounding box of the positions, which start every stride floats
+BoundingSphere computeBoundingSphere(const std::vector<GLfloat>& vertexData, std::size_t stride);
+// Scaled by the longest axis of the model matrix, so it stays conservative under nonuniform scale
+BoundingSphere transformBoundingSphere(const BoundingSphere& sphere, const glm::mat4& model);
+
+// Inward facing planes of the view volume of a view projection matrix, left,
+// right, bottom, top, near and far. Views drawn with depth clamping keep
+// everything in front of their near and behind their far plane, for them
+// bDepth replaces both with planes every sphere passes.
+std::array<glm::vec4, 6> extractFrustumPlanes(const glm::mat4& viewProjection, bool bDepth = true);
+
+// Bounding spheres tested against view volumes several at a time. Spheres
+// are kept as a structure of arrays padded to the widest vector, each kernel
+// tests 4 spheres per SSE2 or 8 per AVX register against every plane and
+// turns the result into a lane mask. The kernel is picked once for the CPU.
+class FrustumCuller {
+public:
+    FrustumCuller() = default;
+
+    void setSpheres(const std::vector<BoundingSphere>& spheres);
+    std::size_t getNumSpheres() const;
+
+    // Appends the ascending indices in [first, first + count) of the spheres
+    // touching at least one of the view volumes
+    void cull(const std::vector<glm::mat4>& viewProjections, bool bDepth, std::size_t first, std::size_t count, std::vector<GLuint>& visible) const;
+
+private:
+    using CullKernel = void (*)(const float* x, const float* y, const float* z, const float* radius, const std::vector<glm::vec4>& planes, std::size_t first, std::size_t end, std::vector<GLuint>& visible);
+
+    static constexpr std::size_t SPHERE_ALIGNMENT = 8;
+
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    std::vector<float> radius;
+    std::size_t numSpheres = 0;
+
+    static CullKernel selectKernel();
+};
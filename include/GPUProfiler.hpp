@@ -0,0 +1,76 @@
+#pragma once
+#include "glad.h"
+
+#include "CPUProfiler.hpp"
+
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+struct GPUSectionTime {
+    std::string name;
+    double lastTime;
+    double averageTime;
+    bool bActive;
+};
+
+// Measures GPU time of named render passes with GL_TIME_ELAPSED queries.
+// Queries of the last few frames are kept in flight and only read back once
+// their results are available, so profiling never waits on the GPU.
+// Elapsed time queries cannot nest, only the outermost section is timed.
+class GPUProfiler {
+public:
+    GPUProfiler() = delete;
+
+    static void beginFrame();
+    static void endFrame();
+    static void beginSection(const char* sectionName);
+    static void endSection();
+
+    static const std::vector<GPUSectionTime>& getSectionTimes();
+    static double getFrameTime();
+
+    static bool openLog(const std::filesystem::path& logPath);
+    static void terminate();
+
+    static bool bEnabled;
+
+private:
+    static constexpr std::size_t FRAME_LATENCY = 5;
+
+    struct FrameQueries {
+        std::vector<GLuint> queries;
+        std::vector<const char*> sectionNames;
+        std::size_t numSections = 0;
+        unsigned long frameNumber = 0;
+        bool bPending = false;
+    };
+
+    static std::array<FrameQueries, FRAME_LATENCY> frames;
+    static std::size_t currentFrame;
+    static unsigned long frameNumber;
+    static int sectionDepth;
+    static bool bFrameActive;
+    static std::vector<GPUSectionTime> sectionTimes;
+    static std::ofstream log;
+
+    static void collectFrame(FrameQueries& frame);
+};
+
+// Also records a CPU zone of the same name, so the cost of submitting a pass
+// shows up in CPU traces next to its GPU time.
+class ScopedGPUTimer {
+public:
+    explicit ScopedGPUTimer(const char* sectionName) : cpuZone(sectionName) {
+        GPUProfiler::beginSection(sectionName);
+    }
+    ScopedGPUTimer(const ScopedGPUTimer& other) = delete;
+    ~ScopedGPUTimer() {
+        GPUProfiler::endSection();
+    }
+
+private:
+    ScopedCPUZone cpuZone;
+};
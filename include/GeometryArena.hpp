@@ -0,0 +1,136 @@
+#pragma once
+#include "glad.h"
+
+#include "FrustumCuller.hpp"
+
+#include <vector>
+
+// Location of one mesh inside of a GeometryArena
+struct MeshRange {
+    GLuint firstIndex = 0;
+    GLuint numIndices = 0;
+    GLint baseVertex = 0;
+    BoundingSphere bounds;
+
+    const void* getIndexOffset() const {
+        return reinterpret_cast<const void*>(sizeof(GLuint) * this->firstIndex);
+    }
+};
+
+// Layout defined by GL_ARB_draw_indirect
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// Vertices and indices of all meshes, suballocated from one vertex buffer and
+// one element buffer. Vertices use the MeshData layout of position, normal
+// and texture coordinates, indices are relative to the first vertex of their
+// mesh and applied with a base vertex.
+class GeometryArena {
+public:
+    static constexpr GLsizei VERTEX_SIZE = 8;
+
+    GeometryArena() = default;
+    GeometryArena(const GeometryArena& other) = delete;
+    ~GeometryArena();
+
+    MeshRange addMesh(const std::vector<GLfloat>& vertexData, const std::vector<GLuint>& vertexIndices);
+    void upload();
+    void free();
+
+    // Position, normal and texture coordinates at locations 0, 1 and 2
+    void setupVertexArray(GLuint VAO) const;
+    // Position only at location 0
+    void setupPositionVertexArray(GLuint VAO) const;
+
+    GLuint getVertexBuffer() const;
+    GLuint getElementBuffer() const;
+
+    static void drawMesh(const MeshRange& mesh, GLsizei numInstances = 1);
+
+private:
+    std::vector<GLfloat> vertexData;
+    std::vector<GLuint> vertexIndices;
+    GLuint VBO = 0;
+    GLuint EBO = 0;
+};
+
+// Per instance model and normal matrices are laid out as a mat4 at location 3
+// followed by a mat3 at location 7 and the material as a vec3 at location 10,
+// holding the diffuse layer, the specular layer and the shininess
+class InstanceAttributes {
+public:
+    static constexpr GLsizei INSTANCE_SIZE = 28;
+    static constexpr GLsizei MATERIAL_OFFSET = 25;
+
+    InstanceAttributes() = delete;
+
+    static void setup(GLuint VAO, GLuint instanceVBO);
+    static void bind(GLuint instanceVBO, GLuint baseInstance);
+};
+
+// Draws of instanced meshes from a GeometryArena. With GL_ARB_multi_draw_indirect
+// the commands live in a GPU buffer and any consecutive range of them is
+// submitted with a single glMultiDrawElementsIndirect call, otherwise they are
+// issued one by one.
+class DrawCommandBuffer {
+public:
+    DrawCommandBuffer() = default;
+    DrawCommandBuffer(const DrawCommandBuffer& other) = delete;
+    ~DrawCommandBuffer();
+
+    int addDraw(const MeshRange& mesh, GLuint numInstances, GLuint baseInstance);
+    int addDraw(const DrawElementsIndirectCommand& command);
+    const DrawElementsIndirectCommand& getCommand(int command) const;
+    void clear();
+    // Commands rewritten every frame are uploaded with GL_STREAM_DRAW
+    void upload(GLuint instanceVBO, GLenum usage = GL_STATIC_DRAW);
+    void draw(int firstCommand, int numCommands) const;
+    void free();
+
+    static bool isMultiDrawIndirectSupported();
+
+private:
+    std::vector<DrawElementsIndirectCommand> commands;
+    GLuint commandBuffer = 0;
+    GLuint instanceVBO = 0;
+};
+
+// Instances of a DrawCommandBuffer that survived culling for one view. The
+// full instance data stays on the CPU, update copies the visible instances
+// of a range of commands into a buffer of their own and rebuilds the
+// commands to start at the first visible instance of each. Every update
+// orphans the buffers, so views drawn one after another can share them.
+class VisibleInstanceBuffer {
+public:
+    VisibleInstanceBuffer() = default;
+    VisibleInstanceBuffer(const VisibleInstanceBuffer& other) = delete;
+    ~VisibleInstanceBuffer();
+
+    // Instances are laid out as described by InstanceAttributes
+    void create(std::vector<GLfloat> instanceData);
+    void free();
+    void setupVertexArray(GLuint VAO) const;
+
+    // visibleInstances holds ascending instance indices, commands keep their index from drawCommands
+    void update(const DrawCommandBuffer& drawCommands, int firstCommand, int numCommands, const std::vector<GLuint>& visibleInstances);
+    // Every layer lists its own visible instances. Each command draws the
+    // instances of all layers, every copy holds its layer in place of the
+    // material for a vertex shader that selects gl_Layer.
+    void updateLayered(const DrawCommandBuffer& drawCommands, int firstCommand, int numCommands, const std::vector<std::vector<GLuint>>& layerInstances);
+    void draw(int firstCommand, int numCommands) const;
+
+private:
+    std::vector<GLfloat> instanceData;
+    std::vector<GLfloat> visibleInstanceData;
+    DrawCommandBuffer visibleCommands;
+    int firstCommand = 0;
+    GLuint instanceVBO = 0;
+
+    GLuint appendInstances(const DrawElementsIndirectCommand& command, const std::vector<GLuint>& visibleInstances);
+    void upload();
+};
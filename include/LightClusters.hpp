@@ -0,0 +1,93 @@
+#pragma once
+#include "glad.h"
+
+#include "Lights.hpp"
+#include "ShaderPreprocessor.hpp"
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// Point and spot lights sorted into clusters of the view frustum, screen
+// tiles in x and y and exponentially deeper slices in z, so a fragment only
+// shades the lights whose range reaches its cluster. Lights are bounded by
+// spheres, spot lights by the smallest sphere around their cone, and are
+// assigned on the CPU every frame. Depth slices are spread over the thread
+// pool, each first culls all lights against its depth range four at a time
+// with SSE2 and then tests the survivors against the boxes of its clusters.
+// Every cluster lists the indices of its point lights followed by those of
+// its spot lights, indices refer to the lights in LightStorage and, for the
+// first lights of each type, to their shadow maps. Cluster ranges and
+// indices are read through texture buffers.
+class LightClusters {
+public:
+    static constexpr int GRID_X = 16;
+    static constexpr int GRID_Y = 9;
+    static constexpr int GRID_Z = 24;
+    static constexpr GLuint CLUSTER_TEXTURE_UNIT = 14;
+    static constexpr GLuint INDEX_TEXTURE_UNIT = 15;
+
+    LightClusters() = default;
+    LightClusters(const LightClusters& other) = delete;
+    ~LightClusters();
+
+    void create();
+    void free();
+
+    void setLights(const std::vector<PointLight>& pointLights, const std::vector<SpotLight>& spotLights);
+    void updateSpotLight(std::size_t index, const SpotLight& light);
+    // verticalFOV is in degrees, like CameraManager
+    void setFrustum(float verticalFOV, float aspectRatio, float nearPlane, float farPlane);
+    // Assigns the point lights and the first numSpotLights spot lights
+    void assign(const glm::mat4& view, int numSpotLights);
+    void upload();
+    void bind() const;
+    // Points the lightClusters and lightIndices samplers of a program at the buffers
+    void setupProgram(GLuint program) const;
+
+    // Maps gl_FragCoord to the grid, xy per pixel and zw applied to the log of the view depth
+    glm::vec4 getClusterScale(int viewportW, int viewportH) const;
+    ShaderDefines getShaderDefines() const;
+
+private:
+    static constexpr std::size_t NUM_CLUSTERS = GRID_X * GRID_Y * GRID_Z;
+
+    // Structure of arrays padded to a multiple of four for the SIMD loops
+    struct BoundingSpheres {
+        std::vector<float> x;
+        std::vector<float> y;
+        std::vector<float> z;
+        std::vector<float> radius;
+
+        void resize(std::size_t count);
+        void set(std::size_t index, const glm::vec3& center, float sphereRadius);
+    };
+
+    struct ClusterLights {
+        std::vector<GLuint> indices;
+        GLuint numPointLights = 0;
+    };
+
+    GLuint buffers[2] = {0, 0};
+    GLuint textures[2] = {0, 0};
+    std::size_t maxIndices = 0;
+
+    std::size_t numPointLights = 0;
+    std::size_t numSpotLights = 0;
+    BoundingSpheres worldSpheres;
+    BoundingSpheres viewSpheres;
+
+    float tanHalfFOVX = 1.0f;
+    float tanHalfFOVY = 1.0f;
+    float nearPlane = 0.1f;
+    float farPlane = 100.0f;
+
+    std::vector<ClusterLights> clusters;
+    std::vector<glm::uvec2> clusterRanges;
+    std::vector<GLuint> indices;
+
+    void assignSlice(int slice, std::size_t numSpheres, GLuint numAssignedPointLights);
+};
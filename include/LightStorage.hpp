@@ -0,0 +1,93 @@
+#pragma once
+#include "glad.h"
+
+#include "Lights.hpp"
+#include "ShaderPreprocessor.hpp"
+
+#include <glm/vec4.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// GPU layouts of the lights, read back by lightstorage.glsl. Every member is
+// one vec4 texel, so the same bytes work as RGBA32F texels of a texture
+// buffer and as a vec4 array of a std430 shader storage block. Point and
+// spot lights keep their range in the w of the ambient color.
+struct PackedLightColor {
+    glm::vec4 ambient;
+    glm::vec4 diffuse;
+    glm::vec4 specular;
+};
+
+struct PackedPointLight {
+    PackedLightColor color;
+    glm::vec4 positionRadius;
+};
+
+struct PackedSpotLight {
+    PackedLightColor color;
+    glm::vec4 positionRadius;
+    glm::vec4 directionInnerAngleCos;
+    glm::vec4 outerAngleCos;
+};
+
+struct PackedDirectionalLight {
+    PackedLightColor color;
+    glm::vec4 direction;
+};
+
+PackedPointLight packLight(const PointLight& light);
+PackedSpotLight packLight(const SpotLight& light);
+PackedDirectionalLight packLight(const DirectionalLight& light);
+
+// Parameters of every light in one buffer, point lights first, followed by
+// spot lights and directional lights, so the number of lights is only
+// limited by the buffer size. The buffer is read as a shader storage block
+// where GL_ARB_shader_storage_buffer_object is supported and as a texture
+// buffer otherwise, which GL 3.3 always has. Programs reading the lights are
+// built with getShaderDefines to select the same backend.
+class LightStorage {
+public:
+    static constexpr std::size_t POINT_LIGHT_TEXELS = sizeof(PackedPointLight) / sizeof(glm::vec4);
+    static constexpr std::size_t SPOT_LIGHT_TEXELS = sizeof(PackedSpotLight) / sizeof(glm::vec4);
+    static constexpr std::size_t DIRECTIONAL_LIGHT_TEXELS = sizeof(PackedDirectionalLight) / sizeof(glm::vec4);
+    static constexpr GLuint STORAGE_BLOCK_BINDING = 0;
+    static constexpr GLuint TEXTURE_UNIT = 13;
+
+    LightStorage() = default;
+    LightStorage(const LightStorage& other) = delete;
+    ~LightStorage();
+
+    void create(bool bPreferShaderStorage);
+    void free();
+
+    // Fails without changing the stored lights if they do not fit into the buffer
+    bool setLights(const std::vector<PointLight>& pointLights, const std::vector<SpotLight>& spotLights, const std::vector<DirectionalLight>& directionalLights);
+    void updateSpotLight(std::size_t index, const SpotLight& light);
+    // Does nothing unless lights were stored since the last upload
+    void upload();
+    void bind() const;
+    // Points the LightStorageBlock or the lightStorage sampler of a program at the buffer
+    void setupProgram(GLuint program) const;
+
+    GLint getSpotLightsStart() const;
+    GLint getDirectionalLightsStart() const;
+    std::size_t getMaxTexels() const;
+    bool isShaderStorage() const;
+    ShaderDefines getShaderDefines() const;
+
+    static bool isShaderStorageSupported();
+
+private:
+    GLuint buffer = 0;
+    GLuint texture = 0;
+    bool bShaderStorage = false;
+    std::size_t maxTexels = 0;
+    std::vector<glm::vec4> texels;
+    bool bDirty = false;
+    std::size_t spotLightsStart = 0;
+    std::size_t directionalLightsStart = 0;
+
+    template<typename Light>
+    void store(std::size_t texel, const Light& light);
+};
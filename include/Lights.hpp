@@ -27,6 +27,8 @@ struct PointLight: virtual LightCommon {
     void genPosition();
     void genRadius();
     virtual void genColor() override;
+    // Distance at which the light fades out completely
+    float getRange() const;
 
     glm::vec3 position;
     float radius;
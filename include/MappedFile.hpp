@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <vector>
+
+// Read only view of a whole file. The file is memory mapped where the
+// platform supports it and read into memory otherwise.
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::filesystem::path& filePath);
+    MappedFile(const MappedFile& other) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    ~MappedFile();
+
+    bool isOpen() const;
+    const std::byte* data() const;
+    std::size_t size() const;
+
+private:
+    const std::byte* fileData = nullptr;
+    std::size_t fileSize = 0;
+    bool bMapped = false;
+    std::vector<std::byte> fileContents;
+
+    void close();
+};
@@ -0,0 +1,33 @@
+#pragma once
+#include "MeshData.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+// Binary copies of imported models, stored as one file per source model.
+// A cache file holds the interleaved vertex data, indices and material names
+// of every mesh and is memory mapped on load, so no parsing is involved.
+// It is only used while its format version, source path, modification time
+// and size match. A source whose time or size changed is still accepted if
+// its content hash is unchanged.
+class MeshCache {
+public:
+    static constexpr std::uint32_t VERSION = 1;
+
+    MeshCache() = delete;
+
+    static bool load(const std::filesystem::path& sourcePath, std::vector<MeshData>& meshes);
+    // The source is hashed unless its hash is already known
+    static bool store(const std::filesystem::path& sourcePath, const std::vector<MeshData>& meshes, std::optional<std::uint64_t> sourceHash = std::nullopt);
+    static void setCacheRoot(const std::filesystem::path& newCacheRoot);
+
+    static bool bEnabled;
+
+private:
+    static std::filesystem::path cacheRoot;
+
+    static std::filesystem::path getCachePath(const std::filesystem::path& sourcePath);
+    static std::uint64_t hashFile(const std::filesystem::path& filePath);
+};
@@ -0,0 +1,26 @@
+#pragma once
+#include "glad.h"
+
+#include <string>
+#include <vector>
+
+struct Material {
+    std::string diffuseMap;
+    std::string specularMap;
+    float shininess;
+};
+
+inline bool operator==(const Material& m1, const Material& m2) {
+    return m1.diffuseMap == m2.diffuseMap and m1.specularMap == m2.specularMap and m1.shininess == m2.shininess;
+}
+
+inline bool operator!=(const Material& m1, const Material& m2) {
+    return m1.diffuseMap != m2.diffuseMap or m1.specularMap != m2.specularMap or m1.shininess != m2.shininess;
+}
+
+// Vertices are interleaved position, normal and texture coordinates
+struct MeshData {
+    std::vector<GLfloat> vertexData;
+    std::vector<GLuint> vertexIndices;
+    Material meshMaterial;
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Builds mipmap chains of RGBA8 images on the CPU, so textures are uploaded
+// with every level instead of relying on glGenerateMipmap. Levels are box
+// filtered in linear space, color channels of sRGB images are decoded before
+// filtering and encoded again afterwards. The filter runs on AVX2 or SSE2
+// when the CPU has them and falls back to scalar code otherwise.
+class MipmapGenerator {
+public:
+    // Alpha value that separates covered from uncovered texels
+    static constexpr float ALPHA_REFERENCE = 0.5f;
+
+    MipmapGenerator() = delete;
+
+    static int getNumLevels(int width, int height);
+
+    // Returns all levels starting with a copy of the image. Level i is
+    // max(width >> i, 1) by max(height >> i, 1) texels. If the image is not
+    // fully opaque, the alpha of every smaller level is scaled so that the
+    // same fraction of texels passes ALPHA_REFERENCE as in the image itself,
+    // which keeps cutouts from thinning out in the distance.
+    static std::vector<std::vector<std::byte>> generate(const std::vector<std::byte>& image, int width, int height, bool bSRGB);
+
+private:
+    using DownsampleKernel = void (*)(const float* row0, const float* row1, int width, int nextWidth, float* nextRow);
+
+    static DownsampleKernel selectKernel();
+    static float getCoverage(const std::vector<float>& level, float alphaScale);
+    static float findAlphaScale(const std::vector<float>& level, float targetCoverage);
+};
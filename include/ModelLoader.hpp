@@ -0,0 +1,24 @@
+#pragma once
+#include "MeshData.hpp"
+
+#include <filesystem>
+#include <vector>
+
+struct aiMesh;
+struct aiScene;
+
+class ModelLoader {
+public:
+    ModelLoader() = delete;
+
+    // Meshes are read from the mesh cache when it is up to date, otherwise
+    // imported with Assimp and written to the cache
+    static std::vector<MeshData> loadModelData(const std::filesystem::path& modelPath);
+
+    // Loads every model concurrently on the thread pool, results are in the order of modelPaths
+    static std::vector<std::vector<MeshData>> loadModels(const std::vector<std::filesystem::path>& modelPaths);
+
+private:
+    static std::vector<MeshData> importModelData(const std::filesystem::path& modelPath);
+    static void convertMesh(const aiScene* scene, const aiMesh* mesh, MeshData& meshData);
+};
@@ -0,0 +1,73 @@
+#pragma once
+#include "glad.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct ShaderSource {
+    GLenum type;
+    std::string source;
+    // Hash of source if already known, such as from ShaderPreprocessor
+    std::uint64_t sourceHash = 0;
+};
+
+// Linked shader programs as driver specific binaries, one file per program.
+// Files are named after a hash of the preprocessed sources of every stage
+// and of the GL vendor, renderer and version strings, so an edited shader or
+// an updated driver simply misses the cache. A program found in the cache is
+// created without compiling anything. On a miss the stages are compiled, the
+// program is linked and its binary is written back. Drivers may reject a
+// binary they produced earlier, such programs are compiled from source too.
+//
+// With KHR_parallel_shader_compile, programs built from source are only
+// submitted and the driver compiles and links them on its own threads.
+// Their binaries are stored once update() finds them complete or once
+// finishPrograms() waits for the rest, so startup work can go on meanwhile.
+// Without the extension every program is finished right away.
+class ProgramCache {
+public:
+    static constexpr std::uint32_t VERSION = 1;
+
+    ProgramCache() = delete;
+
+    static bool isSupported();
+    static bool isParallelSupported();
+    static GLuint createProgram(const std::vector<ShaderSource>& shaders);
+    // Finishes submitted programs the driver is done with, never waits
+    static void update();
+    static void finishPrograms();
+    // Waits for one submitted program only, the others keep compiling
+    static void finishProgram(GLuint program);
+    // Whether a program is still compiling, as of the last update()
+    static bool isPending(GLuint program);
+    // Shaders compiled on misses are shared by every program with the same
+    // stage source until they are released. Shaders of pending programs are
+    // kept for a later release.
+    static void releaseShaders();
+    static void setCacheRoot(const std::filesystem::path& newCacheRoot);
+
+    static bool bEnabled;
+    static bool bParallelCompile;
+
+private:
+    struct PendingProgram {
+        GLuint program;
+        std::uint64_t programKey;
+        std::vector<GLuint> shaderIds;
+    };
+
+    static std::filesystem::path cacheRoot;
+    static std::string driverName;
+    static std::unordered_map<std::uint64_t, GLuint> compiledShaders;
+    static std::vector<PendingProgram> pendingPrograms;
+
+    static std::uint64_t getProgramKey(const std::vector<ShaderSource>& shaders);
+    static std::filesystem::path getCachePath(std::uint64_t programKey);
+    static bool loadProgram(GLuint program, std::uint64_t programKey);
+    static bool storeProgram(GLuint program, std::uint64_t programKey);
+    static GLuint getShader(const ShaderSource& shader);
+    static void finishProgram(const PendingProgram& pendingProgram);
+};
@@ -0,0 +1,97 @@
+#pragma once
+#include "glad.h"
+
+#include "ProgramCache.hpp"
+#include "ShaderReloader.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// Variants of one program specialized with defines, such as light counts
+// compiled into loop bounds. The generic program is built without any of
+// them and handles every case at runtime. A variant is created the first
+// time it is requested and kept for the rest of the run, while it is still
+// compiling in parallel the generic program is returned in its place, so a
+// new permutation never stalls a frame. Without parallel compilation the
+// first request waits for the variant instead. Every variant is watched by
+// ShaderReloader and resolves its own Uniforms once its program is ready.
+// Variants are looked up by a small comparable Key, such as the light counts,
+// whose getShaderDefines only runs when a new variant is compiled.
+template<typename Uniforms, typename Key>
+class ProgramPermutations {
+public:
+    struct Variant {
+        Key key;
+        GLuint program = 0;
+        std::optional<Uniforms> uniforms;
+        bool bReady = false;
+    };
+
+    ProgramPermutations() = default;
+    ProgramPermutations(const ProgramPermutations& other) = delete;
+
+    void createGenericProgram(const std::vector<ShaderStage>& newStages) {
+        this->stages = newStages;
+        this->variants.clear();
+        auto& generic = this->variants.emplace_back();
+        ShaderReloader::createProgram(generic.program, this->stages);
+    }
+
+    // Runs on the generic program right away and on every variant once it is ready
+    void setSetupFunction(ShaderReloader::SetupFunction newSetupFunction) {
+        this->setupFunction = std::move(newSetupFunction);
+        this->setupVariant(this->variants.front());
+    }
+
+    // The generic program in front is never matched by a key
+    const Variant& get(const Key& key) {
+        auto it = std::find_if(this->variants.begin() + 1, this->variants.end(), [&key](const Variant& v) {
+            return v.key == key;
+        });
+        if (it == this->variants.end()) {
+            ShaderDefines defines = key.getShaderDefines();
+            auto stageVariants = this->stages;
+            for (auto& stage: stageVariants) {
+                stage.defines.insert(stage.defines.end(), defines.begin(), defines.end());
+            }
+            it = this->variants.insert(this->variants.end(), Variant{key, 0, std::nullopt, false});
+            ShaderReloader::createProgram(it->program, stageVariants);
+        }
+        if (!it->bReady) {
+            if (!it->program or ProgramCache::isPending(it->program)) {
+                return this->variants.front();
+            }
+            // A variant that failed to link is used once a reload fixes it
+            GLint bLinked = GL_FALSE;
+            glGetProgramiv(it->program, GL_LINK_STATUS, &bLinked);
+            if (!bLinked) {
+                return this->variants.front();
+            }
+            this->setupVariant(*it);
+        }
+        return *it;
+    }
+
+    std::size_t getNumVariants() const {
+        return this->variants.size();
+    }
+
+private:
+    std::vector<ShaderStage> stages;
+    ShaderReloader::SetupFunction setupFunction;
+    // Deque elements stay in place, ShaderReloader updates their programs
+    std::deque<Variant> variants;
+
+    void setupVariant(Variant& variant) {
+        variant.bReady = true;
+        ShaderReloader::setSetupFunction(variant.program, [this, &variant](GLuint program) {
+            if (this->setupFunction) {
+                this->setupFunction(program);
+            }
+            variant.uniforms.emplace(program);
+        });
+    }
+};
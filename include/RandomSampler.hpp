@@ -8,6 +8,7 @@ public:
     static float randomFloat();
     static float randomFloat(float a, float b);
     static void seed();
+    static void seed(std::mt19937::result_type seedValue);
 
 private:
     static bool bSeeded;
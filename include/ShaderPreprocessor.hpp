@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using ShaderDefines = std::vector<std::pair<std::string, std::string>>;
+
+struct PreprocessedShader {
+    std::string source;
+    // FNV-1a hash of source, for caches keyed by the final shader text
+    std::uint64_t sourceHash = 0;
+    // Every file the source was expanded from, the loaded file first
+    std::vector<std::string> files;
+    bool bValid = false;
+};
+
+// Expands #include "file" directives of GLSL sources, resolved relative to
+// the including file. Files are read once and kept in memory, a file with
+// #pragma once or an include guard around its whole body is only expanded
+// the first time it is included into a shader. Every file is numbered once
+// per run and #line directives are emitted around includes, so compiler
+// messages name the right source string and line. Defines are injected
+// right after #version. Everything besides #include and #pragma once is
+// left for the GLSL compiler.
+class ShaderPreprocessor {
+public:
+    ShaderPreprocessor() = delete;
+
+    static PreprocessedShader load(const std::filesystem::path& filePath, const ShaderDefines& defines = {});
+    // Name of the file behind a source string number of #line directives
+    static std::string getFileName(int sourceStringNumber);
+    static void clearCache();
+    // Forgets a cached file so the next shader including it reads it again
+    static void invalidateFile(const std::string& fileName);
+
+private:
+    static constexpr int MAX_INCLUDE_DEPTH = 32;
+
+    struct SourceFile {
+        std::string contents;
+        int sourceStringNumber;
+        bool bGuarded;
+    };
+
+    static std::unordered_map<std::string, SourceFile> fileCache;
+    static std::vector<std::string> fileNames;
+
+    static const SourceFile* getFile(const std::string& fileName);
+    static bool isGuarded(std::string_view contents);
+    static bool expandFile(const std::string& fileName, const ShaderDefines& defines, int depth, std::vector<std::string>& expandedFiles, std::string& output);
+};
@@ -0,0 +1,58 @@
+#pragma once
+#include "glad.h"
+
+#include "ShaderPreprocessor.hpp"
+
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct ShaderStage {
+    GLenum type;
+    std::filesystem::path filePath;
+    ShaderDefines defines = {};
+};
+
+// Shader programs built from files, rebuilt while running whenever one of
+// their files changes, including files they only reach through #include.
+// Changes are picked up with inotify where available. Rebuilt programs are
+// swapped in together by update() between frames: the old program is
+// deleted, the program handle given to createProgram is pointed at the new
+// one and its setup function runs again to restore uniform block bindings,
+// sampler units and cached uniform locations. A program that fails to
+// compile or link is dropped and the old one stays in use.
+class ShaderReloader {
+public:
+    using SetupFunction = std::function<void(GLuint program)>;
+
+    ShaderReloader() = delete;
+
+    static bool initialize();
+    static void terminate();
+
+    // program must outlive the reloader, it is updated in place
+    static void createProgram(GLuint& program, const std::vector<ShaderStage>& stages);
+    // Runs setupFunction on the program now and after every rebuild
+    static void setSetupFunction(const GLuint& program, SetupFunction setupFunction);
+    static void update();
+
+    static bool bEnabled;
+
+private:
+    struct WatchedProgram {
+        GLuint* program;
+        std::vector<ShaderStage> stages;
+        std::vector<std::string> files;
+        SetupFunction setupFunction;
+    };
+
+    static std::vector<WatchedProgram> programs;
+    static int inotifyFd;
+    static std::unordered_map<int, std::filesystem::path> watchedDirectories;
+
+    static GLuint buildProgram(WatchedProgram& watchedProgram);
+    static void watchDirectory(const std::filesystem::path& directory);
+    static std::vector<std::string> readChangedFiles();
+};
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+// Hash map split into shards that are locked independently, so threads that
+// access different keys rarely contend. Values are only reached through
+// callbacks that run with their shard locked, the callbacks must not access
+// the map again.
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class ShardedMap {
+public:
+    static constexpr int SHARD_BITS = 4;
+    static constexpr std::size_t NUM_SHARDS = 1 << SHARD_BITS;
+
+    // Inserts a default constructed value if the key is missing
+    template<typename F>
+    void update(const Key& key, F&& function) {
+        auto& shard = this->getShard(key);
+        std::lock_guard lock(shard.mutex);
+        function(shard.map[key]);
+    }
+
+    template<typename F>
+    bool updateIfPresent(const Key& key, F&& function) {
+        auto& shard = this->getShard(key);
+        std::lock_guard lock(shard.mutex);
+        auto it = shard.map.find(key);
+        if (it == shard.map.end()) {
+            return false;
+        }
+        function(it->second);
+        return true;
+    }
+
+    bool find(const Key& key, Value& value) const {
+        auto& shard = this->getShard(key);
+        std::lock_guard lock(shard.mutex);
+        auto it = shard.map.find(key);
+        if (it == shard.map.end()) {
+            return false;
+        }
+        value = it->second;
+        return true;
+    }
+
+    bool extract(const Key& key, Value& value) {
+        auto& shard = this->getShard(key);
+        std::lock_guard lock(shard.mutex);
+        auto it = shard.map.find(key);
+        if (it == shard.map.end()) {
+            return false;
+        }
+        value = std::move(it->second);
+        shard.map.erase(it);
+        return true;
+    }
+
+    // Shards are locked one after another, not all at once
+    template<typename F>
+    void forEach(F&& function) {
+        for (auto& shard: this->shards) {
+            std::lock_guard lock(shard.mutex);
+            for (auto& [key, value]: shard.map) {
+                function(key, value);
+            }
+        }
+    }
+
+    void clear() {
+        for (auto& shard: this->shards) {
+            std::lock_guard lock(shard.mutex);
+            shard.map.clear();
+        }
+    }
+
+private:
+    struct Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<Key, Value, Hash> map;
+    };
+
+    std::array<Shard, NUM_SHARDS> shards;
+
+    // The shard is picked from the high bits of the mixed hash, the maps
+    // inside the shards use the low bits of the same hash
+    const Shard& getShard(const Key& key) const {
+        std::uint64_t mixedHash = static_cast<std::uint64_t>(Hash{}(key)) * 0x9e3779b97f4a7c15ull;
+        return this->shards[mixedHash >> (64 - SHARD_BITS)];
+    }
+
+    Shard& getShard(const Key& key) {
+        return const_cast<Shard&>(static_cast<const ShardedMap*>(this)->getShard(key));
+    }
+};
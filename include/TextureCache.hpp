@@ -0,0 +1,49 @@
+#pragma once
+#include "glad.h"
+
+#include "MappedFile.hpp"
+#include "TextureCompressor.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// Block compressed texture with its whole mipmap chain, the levels point
+// into the memory mapped cache file
+struct CompressedTexture {
+    CompressedFormat format;
+    int width = 0;
+    int height = 0;
+    std::vector<const std::byte*> levelData;
+    std::vector<std::size_t> levelSizes;
+    MappedFile file;
+
+    std::size_t getSize() const;
+    GLenum getInternalFormat(bool bSRGBA) const;
+};
+
+// Baked copies of PNG textures, one file per source image and color space.
+// A cache file holds every mip level compressed to BC1, or BC3 if the image
+// has any transparency. Entries are baked on a worker thread the first time
+// a texture is decoded from PNG and are used from then on while their format
+// version, source path, modification time and size match.
+class TextureCache {
+public:
+    static constexpr std::uint32_t VERSION = 2;
+
+    TextureCache() = delete;
+
+    static bool isSupported(bool bSRGBA);
+    static bool load(const std::filesystem::path& sourcePath, bool bSRGBA, CompressedTexture& texture);
+    // Takes the full mip chain of an RGBA8 image as built by MipmapGenerator
+    static bool store(const std::filesystem::path& sourcePath, bool bSRGBA, const std::vector<std::vector<std::byte>>& levels, int width, int height);
+    static void setCacheRoot(const std::filesystem::path& newCacheRoot);
+
+    static bool bEnabled;
+
+private:
+    static std::filesystem::path cacheRoot;
+
+    static std::filesystem::path getCachePath(const std::filesystem::path& sourcePath, bool bSRGBA);
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+enum class CompressedFormat : std::uint32_t {
+    BC1 = 1,
+    BC3 = 3,
+};
+
+// CPU encoder for the S3TC block formats. BC1 stores opaque color in 8 bytes
+// per 4x4 block, BC3 adds an interpolated alpha block for 16 bytes in total.
+// Endpoints are fitted along the principal axis of each block's colors.
+class TextureCompressor {
+public:
+    TextureCompressor() = delete;
+
+    static bool hasAlpha(const std::byte* image, int width, int height);
+    static std::size_t getCompressedSize(CompressedFormat format, int width, int height);
+
+    // Edge blocks of images that are not a multiple of 4 repeat their last texels
+    static void compress(CompressedFormat format, const std::byte* image, int width, int height, std::byte* compressedImage);
+
+private:
+    static void encodeColorBlock(const std::uint8_t block[16][4], std::byte* output);
+    static void encodeAlphaBlock(const std::uint8_t block[16][4], std::byte* output);
+};
@@ -1,27 +1,229 @@
 #pragma once
 #include "glad.h"
 
+#include "ShardedMap.hpp"
+#include "TextureCache.hpp"
+
 #include <boost/functional/hash.hpp>
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
 #include <filesystem>
-#include <unordered_map>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct TextureStats {
+    std::size_t residentBytes;
+    std::size_t budgetBytes;
+    std::size_t numResident;
+    std::size_t numPending;
+    // Lookups of textures to bind, a miss binds a placeholder
+    std::uint64_t numHits;
+    std::uint64_t numMisses;
+    std::uint64_t numEvictions;
+    // Milliseconds from the request that started a load until residency
+    double averageLoadTime;
+    double maxLoadTime;
+};
 
+// A layer of one of the texture arrays, -1 for both if there is none
+struct TextureLayer {
+    GLint textureArray = -1;
+    GLint layer = -1;
+};
+
+// Textures are streamed by default. The first request for a texture queues
+// its images for decoding on the thread pool and returns a placeholder.
+// Images with an up to date entry in the texture cache are read from it
+// precompressed, the others are decoded from PNG, mipmapped on the decoding
+// thread and baked into the cache in the background. Every texture is
+// uploaded with all of its mip levels. Once
+// per frame, update uploads decoded images through pixel buffer objects and
+// fences them, a texture only replaces its placeholder after its fence has
+// signaled, so no frame waits on decoding or on the upload itself.
+// With a memory budget set, textures that were not bound for a number of
+// frames are evicted least recently used first whenever the resident bytes
+// exceed the budget. They stream in again the next time they are bound.
+// Material textures can also be packed into layers of GL_TEXTURE_2D_ARRAYs,
+// so draws of materials sharing an array bind it once and select images by
+// layer. There is one array per image size and color space, images keep
+// their size. With S3TC the arrays hold BC3 blocks, which cached BC1 images
+// are widened to, otherwise RGBA8 texels.
+// Requests may come from any thread, everything else touches GL and belongs
+// to the render thread.
 class TextureLoader {
 public:
+    using Callback = std::function<void(GLuint textureId)>;
+
     TextureLoader() = delete;
 
     static GLuint getTextureId2D(const std::string& textureName, bool bSRGBA = true);
     static GLuint getTextureIdCubeMap(const std::vector<std::string>& textureNames, bool bSRGBA = true);
+
+    // The callback runs on the render thread during update every time the
+    // texture becomes resident, so also after it was evicted and loaded
+    // again. Missing textures report an ID of 0.
+    static void requestTexture2D(const std::string& textureName, bool bSRGBA = true, Callback callback = nullptr);
+    static void requestTextureCubeMap(const std::vector<std::string>& textureNames, bool bSRGBA = true, Callback callback = nullptr);
+
+    // The layer is allocated by the first call and stays the same until the
+    // texture is freed, it shows a placeholder until the image is resident.
+    // The array is picked by the size in the image's header, which is read
+    // right away. Freed layers are reused before the array grows. Arrays
+    // count toward the resident bytes, but their layers are never evicted,
+    // and all of them share repeat wrapping.
+    static TextureLayer getTextureLayer(const std::string& textureName, bool bSRGBA = true);
+    // The array may be replaced by a larger one when layers are allocated
+    static GLuint getTextureArrayId(GLint textureArray);
+
+    static void update();
+    static void waitForTextures();
+    static std::size_t getNumPendingTextures();
+
+    // A budget of 0 disables eviction
+    static void setBudget(std::size_t budgetBytes, unsigned long evictionFrames = 120);
+    static TextureStats getStats();
+
     static void freeTexture2D(const std::string& textureName);
     static void freeTextureCubeMap(const std::vector<std::string>& textureNames);
+    static void freeTextureLayer(const std::string& textureName);
     static void freeTextures();
+    // Must not be called while other threads request textures
     static void setTextureRoot(const std::filesystem::path& newTextureRoot);
 
+    static bool bStreaming;
+
 private:
-    static void loadTexture2D(const std::string& textureKey, bool bSRGBA);
-    static void loadTextureCubeMap(const std::vector<std::string>& textureKey, bool bSRGBA);
+    // Uploads started per update are limited to this many bytes, at least one
+    // texture is always started
+    static constexpr std::size_t UPLOAD_BUDGET = 16 << 20;
+    static constexpr GLsizei INITIAL_ARRAY_LAYERS = 8;
+
+    // Level i is max(width >> i, 1) by max(height >> i, 1) texels
+    struct DecodedImage {
+        int width = 0;
+        int height = 0;
+        std::vector<std::vector<std::byte>> levels;
+    };
+
+    // Decoding only touches imagePaths, images, compressedImages, layerLevels
+    // and bValid and reads the layer format, everything else belongs to the
+    // render thread
+    struct StreamJob {
+        GLenum target;
+        std::vector<std::string> textureNames;
+        std::vector<std::filesystem::path> imagePaths;
+        bool bSRGBA;
+        GLint textureArray = -1;
+        GLint layer = -1;
+        int layerWidth = 0;
+        int layerHeight = 0;
+        bool bCompressedLayer = false;
+        std::vector<DecodedImage> images;
+        std::vector<CompressedTexture> compressedImages;
+        // Mip levels of a layer in the format of its array
+        std::vector<std::vector<std::byte>> layerLevels;
+        bool bValid = false;
+        GLuint textureId = 0;
+        std::size_t numBytes = 0;
+        GLuint pixelBuffer = 0;
+        GLsync fence = nullptr;
+        std::chrono::steady_clock::time_point requestTime;
+    };
+
+    // A texture is resident, has a job streaming it in, or was evicted.
+    // Callbacks are guarded by the lock of the entry's map shard. Entries of
+    // array layers have no texture of their own.
+    struct TextureEntry {
+        GLuint textureId = 0;
+        GLint textureArray = -1;
+        GLint layer = -1;
+        bool bResident = false;
+        std::size_t numBytes = 0;
+        unsigned long lastUsedFrame = 0;
+        std::shared_ptr<StreamJob> job;
+        std::vector<Callback> callbacks;
+    };
+
+    // Layers past numUsedLayers have never been handed out
+    struct TextureArray {
+        int width = 0;
+        int height = 0;
+        bool bSRGBA = true;
+        bool bCompressed = false;
+        GLuint textureId = 0;
+        GLsizei numLayers = 0;
+        GLsizei numUsedLayers = 0;
+        std::vector<GLint> freeLayers;
+    };
+
+    using Texture2DMap = ShardedMap<std::string, TextureEntry, boost::hash<std::string>>;
+    using TextureCubeMapMap = ShardedMap<std::vector<std::string>, TextureEntry, boost::hash<std::vector<std::string>>>;
 
-    static std::unordered_map<std::string, GLuint, boost::hash<std::string>> texture2DMap;
-    static std::unordered_map<std::vector<std::string>, GLuint, boost::hash<std::vector<std::string>>> textureCubeMapMap;
+    template<typename Map, typename Key>
+    static GLuint getTextureId(Map& map, const Key& key, GLenum target, const std::vector<std::string>& textureNames, bool bSRGBA);
+    template<typename Map, typename Key>
+    static void requestTexture(Map& map, const Key& key, GLenum target, const std::vector<std::string>& textureNames, bool bSRGBA, Callback callback);
+
+    static std::shared_ptr<StreamJob> createJob(GLenum target, const std::vector<std::string>& textureNames, bool bSRGBA);
+    template<typename Function>
+    static bool updateJobEntry(const StreamJob& job, Function function);
+    static std::shared_ptr<StreamJob> createLayerJob(const std::string& textureName, bool bSRGBA, GLint textureArray, GLint layer);
+    static void decodeJob(const std::shared_ptr<StreamJob>& job);
+    static bool loadCompressedImages(StreamJob& job);
+    static void convertLayer(StreamJob& job);
+    static bool isJobPending(const std::shared_ptr<StreamJob>& job);
+    static void startUploads(std::size_t uploadBudget);
+    static void finishUploads(bool bWait);
+    static void uploadJob(StreamJob& job);
+    static bool finishJob(const std::shared_ptr<StreamJob>& job);
+    static void forgetEntry(const TextureEntry& entry);
+    static void deleteStagingData(StreamJob& job);
+    static void runReadyCallbacks();
+    static void evictTextures();
+    static GLuint getPlaceholder(GLenum target);
+    static GLint findTextureArray(int width, int height, bool bSRGBA);
+    static GLint allocateLayer(GLint textureArray);
+    static void growTextureArray(GLint textureArray);
+    static void clearLayers(const TextureArray& textureArray, GLuint textureId, GLint firstLayer, GLsizei numLayers);
+    static void restreamLayers(GLint textureArray);
+    static std::size_t getLayerLevelSize(const TextureArray& textureArray, int level);
+    static std::size_t getTextureArraySize(const TextureArray& textureArray, GLsizei numLayers);
+
+    static Texture2DMap texture2DMap;
+    static TextureCubeMapMap textureCubeMapMap;
+    static Texture2DMap textureLayerMap;
+    static std::vector<TextureArray> textureArrays;
     static std::filesystem::path textureRoot;
+    static std::atomic<std::size_t> numPending;
+    static unsigned long frameNumber;
+
+    static std::size_t budgetBytes;
+    static unsigned long evictionFrames;
+    static std::atomic<std::size_t> residentBytes;
+    static std::atomic<std::size_t> numResident;
+    static std::atomic<std::uint64_t> numHits;
+    static std::atomic<std::uint64_t> numMisses;
+    static std::uint64_t numEvictions;
+    static std::uint64_t numLoads;
+    static double totalLoadTime;
+    static double maxLoadTime;
+
+    static std::vector<std::shared_ptr<StreamJob>> uploadingJobs;
+    static GLuint placeholder2D;
+    static GLuint placeholderCubeMap;
+
+    static std::mutex decodedMutex;
+    static std::condition_variable decodedCondition;
+    static std::deque<std::shared_ptr<StreamJob>> decodedJobs;
+    static std::size_t numDecoding;
+    static std::vector<std::pair<Callback, GLuint>> readyCallbacks;
 };
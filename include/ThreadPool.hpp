@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads shared by everything that loads or prepares
+// assets off the main thread. Workers are started on first use and named in
+// CPU traces. parallelFor lets the calling thread work through the range as
+// well, so it may be called from inside a task without deadlocking.
+class ThreadPool {
+public:
+    ThreadPool() = delete;
+
+    static void initialize(unsigned numThreads = 0);
+    static unsigned getNumThreads();
+
+    static void enqueue(std::function<void()> task);
+
+    template<typename F>
+    static auto submit(F&& function) -> std::future<decltype(function())> {
+        using Result = decltype(function());
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(function));
+        auto result = task->get_future();
+        ThreadPool::enqueue([task]() {
+            (*task)();
+        });
+        return result;
+    }
+
+    // Calls function(i) for every i in [0, count) and returns once all calls finished
+    static void parallelFor(std::size_t count, const std::function<void(std::size_t)>& function);
+
+    // Waits for queued tasks to finish and joins the workers
+    static void terminate();
+
+private:
+    struct ParallelRange {
+        std::size_t count;
+        const std::function<void(std::size_t)>* function;
+        std::atomic<std::size_t> nextIndex = 0;
+        std::atomic<std::size_t> numFinished = 0;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+
+    static std::mutex queueMutex;
+    static std::condition_variable queueCondition;
+    static std::queue<std::function<void()>> tasks;
+    static std::vector<std::thread> workers;
+    static bool bStopping;
+
+    static void workerLoop(unsigned workerIndex);
+    static void runRange(ParallelRange& range);
+};
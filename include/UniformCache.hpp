@@ -0,0 +1,75 @@
+#pragma once
+#include "glad.h"
+
+#include <glm/mat3x3.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include <string>
+#include <unordered_map>
+
+// Uniform locations of linked programs. Every active uniform is reflected
+// the first time a program is looked up, so later lookups never reach the
+// driver. Reflection waits for the program to link, so programs still being
+// compiled in parallel should be finished first.
+class UniformCache {
+public:
+    UniformCache() = delete;
+
+    static void reflectProgram(GLuint program);
+    static void forgetProgram(GLuint program);
+    static GLint getLocation(GLuint program, const std::string& uniformName);
+
+private:
+    static std::unordered_map<GLuint, std::unordered_map<std::string, GLint>> programUniforms;
+};
+
+// Location of a single uniform resolved at startup. Setting a uniform that
+// is not active in the program is a no-op, same as with location -1 in GL.
+template <typename T>
+class Uniform {
+public:
+    Uniform() = default;
+    Uniform(GLuint program, const std::string& uniformName) : location(UniformCache::getLocation(program, uniformName)) {}
+
+    void set(const T& value) const;
+    void set(const T* values, GLsizei count) const;
+
+    GLint getLocation() const {
+        return this->location;
+    }
+
+private:
+    GLint location = -1;
+};
+
+template <>
+void Uniform<GLint>::set(const GLint& value) const;
+template <>
+void Uniform<GLint>::set(const GLint* values, GLsizei count) const;
+template <>
+void Uniform<GLfloat>::set(const GLfloat& value) const;
+template <>
+void Uniform<GLfloat>::set(const GLfloat* values, GLsizei count) const;
+template <>
+void Uniform<glm::vec2>::set(const glm::vec2& value) const;
+template <>
+void Uniform<glm::vec2>::set(const glm::vec2* values, GLsizei count) const;
+template <>
+void Uniform<glm::vec3>::set(const glm::vec3& value) const;
+template <>
+void Uniform<glm::vec3>::set(const glm::vec3* values, GLsizei count) const;
+template <>
+void Uniform<glm::vec4>::set(const glm::vec4& value) const;
+template <>
+void Uniform<glm::vec4>::set(const glm::vec4* values, GLsizei count) const;
+template <>
+void Uniform<glm::mat3>::set(const glm::mat3& value) const;
+template <>
+void Uniform<glm::mat3>::set(const glm::mat3* values, GLsizei count) const;
+template <>
+void Uniform<glm::mat4>::set(const glm::mat4& value) const;
+template <>
+void Uniform<glm::mat4>::set(const glm::mat4* values, GLsizei count) const;
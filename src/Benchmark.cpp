@@ -0,0 +1,236 @@
+#include "Benchmark.hpp"
+#include "Camera.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace {
+struct TimingSummary {
+    double min = 0.0;
+    double median = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+};
+
+TimingSummary summarize(std::vector<double> values) {
+    TimingSummary summary;
+    if (values.empty()) {
+        return summary;
+    }
+    std::sort(values.begin(), values.end());
+    auto percentile = [&values](double p) {
+        std::size_t rank = static_cast<std::size_t>(std::ceil(p * values.size()));
+        return values[std::clamp<std::size_t>(rank, 1, values.size()) - 1];
+    };
+    summary.min = values.front();
+    summary.median = percentile(0.5);
+    summary.p95 = percentile(0.95);
+    summary.p99 = percentile(0.99);
+    return summary;
+}
+}  // namespace
+
+Benchmark::Benchmark() {
+    this->configurations = {
+        {"baseline", false, false, false, false, false},
+        {"msaa", true, false, false, false, false},
+        {"taa", false, true, false, false, false},
+        {"bloom", false, false, true, false, false},
+        {"snow", false, false, false, true, false},
+        {"skybox", false, false, false, false, true},
+        {"all", true, true, true, true, true},
+    };
+}
+
+Benchmark::~Benchmark() {
+    this->finish();
+}
+
+bool Benchmark::loadCameraPath(const std::filesystem::path& pathFile) {
+    std::ifstream is(pathFile);
+    if (!is) {
+        return false;
+    }
+    std::vector<CameraKeyframe> loadedKeyframes;
+    std::string line;
+    while (std::getline(is, line)) {
+        auto commentStart = line.find('#');
+        if (commentStart != std::string::npos) {
+            line.erase(commentStart);
+        }
+        std::istringstream lineStream(line);
+        CameraKeyframe keyframe;
+        if (!(lineStream >> keyframe.time)) {
+            continue;
+        }
+        if (!(lineStream >> keyframe.position.x >> keyframe.position.y >> keyframe.position.z >> keyframe.yaw >> keyframe.pitch)) {
+            return false;
+        }
+        if (!loadedKeyframes.empty() and keyframe.time <= loadedKeyframes.back().time) {
+            return false;
+        }
+        loadedKeyframes.push_back(keyframe);
+    }
+    if (loadedKeyframes.empty()) {
+        return false;
+    }
+    this->keyframes = std::move(loadedKeyframes);
+    float duration = this->keyframes.back().time - this->keyframes.front().time;
+    this->framesPerConfiguration = Benchmark::WARMUP_FRAMES + static_cast<int>(duration / Benchmark::TIMESTEP) + 1;
+    return true;
+}
+
+int Benchmark::getNumFrames() const {
+    return this->framesPerConfiguration * this->configurations.size();
+}
+
+const BenchmarkConfiguration& Benchmark::getConfiguration(int frameNumber) const {
+    return this->configurations[frameNumber / this->framesPerConfiguration];
+}
+
+float Benchmark::getFrameTime(int frameNumber) const {
+    int configurationFrame = frameNumber % this->framesPerConfiguration;
+    return std::max(configurationFrame - Benchmark::WARMUP_FRAMES, 0) * Benchmark::TIMESTEP;
+}
+
+CameraKeyframe Benchmark::sampleCameraPath(float time) const {
+    time += this->keyframes.front().time;
+    auto next = std::upper_bound(this->keyframes.begin(), this->keyframes.end(), time, [](float t, const CameraKeyframe& k) {
+        return t < k.time;
+    });
+    if (next == this->keyframes.begin()) {
+        return this->keyframes.front();
+    }
+    if (next == this->keyframes.end()) {
+        return this->keyframes.back();
+    }
+    const auto& k0 = *(next - 1);
+    const auto& k1 = *next;
+    float t = (time - k0.time) / (k1.time - k0.time);
+    return {time, glm::mix(k0.position, k1.position, t), glm::mix(k0.yaw, k1.yaw, t), glm::mix(k0.pitch, k1.pitch, t)};
+}
+
+// Camera only exposes relative movement, so the keyframe pose is reached
+// through offsets from wherever the camera currently is.
+void Benchmark::applyCameraPath(Camera& camera, int frameNumber) const {
+    auto keyframe = this->sampleCameraPath(this->getFrameTime(frameNumber));
+    camera.addLocationOffset(keyframe.position - camera.getCameraPos());
+    camera.addYaw(keyframe.yaw - camera.getYaw());
+    camera.addPitch(keyframe.pitch - camera.getPitch());
+}
+
+void Benchmark::collectQuery(PendingQuery& pendingQuery, bool bWait) {
+    if (pendingQuery.sampleIndex < 0) {
+        return;
+    }
+    GLint bAvailable = GL_FALSE;
+    glGetQueryObjectiv(pendingQuery.endQuery, GL_QUERY_RESULT_AVAILABLE, &bAvailable);
+    if (!bAvailable and !bWait) {
+        return;
+    }
+    GLuint64 startTime, endTime;
+    glGetQueryObjectui64v(pendingQuery.startQuery, GL_QUERY_RESULT, &startTime);
+    glGetQueryObjectui64v(pendingQuery.endQuery, GL_QUERY_RESULT, &endTime);
+    this->samples[pendingQuery.sampleIndex].gpuTime = (endTime - startTime) / 1.0e6;
+    pendingQuery.sampleIndex = -1;
+}
+
+// GPU time is measured with timestamp queries rather than GL_TIME_ELAPSED so
+// that it can enclose the whole frame without conflicting with any elapsed
+// time queries issued inside of it.
+void Benchmark::beginFrame(int frameNumber) {
+    this->currentSample = -1;
+    if (frameNumber % this->framesPerConfiguration < Benchmark::WARMUP_FRAMES) {
+        return;
+    }
+    auto& pendingQuery = this->queries[this->currentQuery];
+    if (!pendingQuery.startQuery) {
+        glGenQueries(1, &pendingQuery.startQuery);
+        glGenQueries(1, &pendingQuery.endQuery);
+    }
+    this->collectQuery(pendingQuery, true);
+
+    this->currentSample = this->samples.size();
+    this->samples.push_back({frameNumber / this->framesPerConfiguration, 0.0, 0.0});
+    pendingQuery.sampleIndex = this->currentSample;
+    glQueryCounter(pendingQuery.startQuery, GL_TIMESTAMP);
+    this->frameStart = std::chrono::steady_clock::now();
+}
+
+void Benchmark::endFrame() {
+    if (this->currentSample < 0) {
+        return;
+    }
+    auto frameEnd = std::chrono::steady_clock::now();
+    this->samples[this->currentSample].cpuTime = std::chrono::duration<double, std::milli>(frameEnd - this->frameStart).count();
+    glQueryCounter(this->queries[this->currentQuery].endQuery, GL_TIMESTAMP);
+    this->currentQuery = (this->currentQuery + 1) % this->queries.size();
+    for (auto& pendingQuery: this->queries) {
+        this->collectQuery(pendingQuery, false);
+    }
+}
+
+void Benchmark::finish() {
+    for (auto& pendingQuery: this->queries) {
+        if (!pendingQuery.startQuery) {
+            continue;
+        }
+        this->collectQuery(pendingQuery, true);
+        glDeleteQueries(1, &pendingQuery.startQuery);
+        glDeleteQueries(1, &pendingQuery.endQuery);
+        pendingQuery = {};
+    }
+}
+
+bool Benchmark::writeReport(const std::filesystem::path& reportFile) const {
+    std::ofstream os(reportFile);
+    if (!os) {
+        return false;
+    }
+    bool bJSON = reportFile.extension() == ".json";
+    if (bJSON) {
+        os << "[\n";
+    } else {
+        os << "configuration,frames,"
+              "cpu_min_ms,cpu_median_ms,cpu_p95_ms,cpu_p99_ms,"
+              "gpu_min_ms,gpu_median_ms,gpu_p95_ms,gpu_p99_ms\n";
+    }
+    for (std::size_t i = 0; i < this->configurations.size(); i++) {
+        std::vector<double> cpuTimes, gpuTimes;
+        for (const auto& sample: this->samples) {
+            if (sample.configurationIndex == static_cast<int>(i)) {
+                cpuTimes.push_back(sample.cpuTime);
+                gpuTimes.push_back(sample.gpuTime);
+            }
+        }
+        auto cpu = summarize(cpuTimes);
+        auto gpu = summarize(gpuTimes);
+        const auto& name = this->configurations[i].name;
+        char line[512];
+        if (bJSON) {
+            std::snprintf(line, sizeof(line),
+                          "  {\"configuration\": \"%s\", \"frames\": %zu, "
+                          "\"cpu_ms\": {\"min\": %.4f, \"median\": %.4f, \"p95\": %.4f, \"p99\": %.4f}, "
+                          "\"gpu_ms\": {\"min\": %.4f, \"median\": %.4f, \"p95\": %.4f, \"p99\": %.4f}}%s\n",
+                          name.c_str(), cpuTimes.size(),
+                          cpu.min, cpu.median, cpu.p95, cpu.p99,
+                          gpu.min, gpu.median, gpu.p95, gpu.p99,
+                          i + 1 < this->configurations.size() ? "," : "");
+        } else {
+            std::snprintf(line, sizeof(line), "%s,%zu,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f\n",
+                          name.c_str(), cpuTimes.size(),
+                          cpu.min, cpu.median, cpu.p95, cpu.p99,
+                          gpu.min, gpu.median, gpu.p95, gpu.p99);
+        }
+        os << line;
+    }
+    if (bJSON) {
+        os << "]\n";
+    }
+    return static_cast<bool>(os);
+}
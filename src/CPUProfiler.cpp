@@ -0,0 +1,94 @@
+#include "CPUProfiler.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+bool CPUProfiler::bEnabled = true;
+std::chrono::steady_clock::time_point CPUProfiler::epoch = std::chrono::steady_clock::now();
+std::mutex CPUProfiler::threadBuffersMutex;
+std::vector<std::unique_ptr<CPUProfiler::ThreadBuffer>> CPUProfiler::threadBuffers;
+
+namespace {
+void writeJSONString(std::ostream& os, const std::string& str) {
+    os << '"';
+    for (char c: str) {
+        if (c == '"' or c == '\\') {
+            os << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            os << escaped;
+        } else {
+            os << c;
+        }
+    }
+    os << '"';
+}
+}  // namespace
+
+std::int64_t CPUProfiler::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - CPUProfiler::epoch).count();
+}
+
+// Buffers are owned by the profiler rather than the thread so that zones of
+// threads that already exited are still exported.
+CPUProfiler::ThreadBuffer& CPUProfiler::getThreadBuffer() {
+    thread_local ThreadBuffer* threadBuffer = nullptr;
+    if (!threadBuffer) {
+        auto newBuffer = std::make_unique<ThreadBuffer>();
+        newBuffer->events.resize(CPUProfiler::RING_SIZE);
+        std::lock_guard lock(CPUProfiler::threadBuffersMutex);
+        newBuffer->threadId = CPUProfiler::threadBuffers.size() + 1;
+        newBuffer->threadName = "thread " + std::to_string(newBuffer->threadId);
+        threadBuffer = newBuffer.get();
+        CPUProfiler::threadBuffers.push_back(std::move(newBuffer));
+    }
+    return *threadBuffer;
+}
+
+void CPUProfiler::recordZone(const char* zoneName, std::int64_t startTime, std::int64_t endTime) {
+    if (!CPUProfiler::bEnabled) {
+        return;
+    }
+    auto& threadBuffer = CPUProfiler::getThreadBuffer();
+    std::size_t index = threadBuffer.numRecorded.load(std::memory_order_relaxed);
+    threadBuffer.events[index % CPUProfiler::RING_SIZE] = {zoneName, startTime, endTime};
+    threadBuffer.numRecorded.store(index + 1, std::memory_order_release);
+}
+
+void CPUProfiler::setThreadName(const std::string& threadName) {
+    auto& threadBuffer = CPUProfiler::getThreadBuffer();
+    std::lock_guard lock(CPUProfiler::threadBuffersMutex);
+    threadBuffer.threadName = threadName;
+}
+
+bool CPUProfiler::writeTrace(const std::filesystem::path& tracePath) {
+    std::ofstream os(tracePath);
+    if (!os) {
+        return false;
+    }
+    std::lock_guard lock(CPUProfiler::threadBuffersMutex);
+    os << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool bFirst = true;
+    char line[128];
+    for (const auto& threadBuffer: CPUProfiler::threadBuffers) {
+        os << (bFirst ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << threadBuffer->threadId << ", \"args\": {\"name\": ";
+        writeJSONString(os, threadBuffer->threadName);
+        os << "}}";
+        bFirst = false;
+
+        std::size_t numRecorded = threadBuffer->numRecorded.load(std::memory_order_acquire);
+        std::size_t first = numRecorded - std::min(numRecorded, CPUProfiler::RING_SIZE);
+        for (std::size_t i = first; i < numRecorded; i++) {
+            const auto& event = threadBuffer->events[i % CPUProfiler::RING_SIZE];
+            os << ",\n{\"name\": ";
+            writeJSONString(os, event.name);
+            std::snprintf(line, sizeof(line), ", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}",
+                          threadBuffer->threadId, event.startTime / 1.0e3, (event.endTime - event.startTime) / 1.0e3);
+            os << line;
+        }
+    }
+    os << "\n]}\n";
+    return static_cast<bool>(os);
+}
@@ -0,0 +1,43 @@
+#include "CacheUtil.hpp"
+
+#include <atomic>
+#include <fstream>
+#include <string>
+
+namespace {
+// Tells apart the temporary files of writers racing on the same path
+std::atomic<std::uint64_t> nextTemporaryId{0};
+}  // namespace
+
+std::uint64_t CacheUtil::fnv1a(const std::byte* data, std::size_t size, std::uint64_t hash) {
+    for (std::size_t i = 0; i < size; i++) {
+        hash ^= static_cast<std::uint64_t>(data[i]);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+bool CacheUtil::isInside(const MappedFile& file, std::uint64_t offset, std::uint64_t size) {
+    return offset <= file.size() and size <= file.size() - offset;
+}
+
+bool CacheUtil::writeFile(const std::filesystem::path& filePath, const std::vector<std::byte>& contents) {
+    std::error_code error;
+    std::filesystem::create_directories(filePath.parent_path(), error);
+    auto temporaryPath = filePath;
+    temporaryPath += "." + std::to_string(nextTemporaryId++) + ".tmp";
+    bool bWritten;
+    {
+        std::ofstream os(temporaryPath, std::ios::binary);
+        os.write(reinterpret_cast<const char*>(contents.data()), contents.size());
+        bWritten = static_cast<bool>(os);
+    }
+    if (bWritten) {
+        std::filesystem::rename(temporaryPath, filePath, error);
+    }
+    if (!bWritten or error) {
+        std::filesystem::remove(temporaryPath, error);
+        return false;
+    }
+    return true;
+}
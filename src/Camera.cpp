@@ -35,6 +35,14 @@ glm::vec3 Camera::getCameraUpVector() {
     return this->cameraUpVector;
 }
 
+float Camera::getPitch() {
+    return this->pitch;
+}
+
+float Camera::getYaw() {
+    return this->yaw;
+}
+
 void Camera::addPitch(float degrees) {
     this->pitch += degrees;
     this->pitch = glm::clamp(this->pitch, -80.0f, 80.0f);
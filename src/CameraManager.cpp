@@ -3,9 +3,20 @@
 
 #include <GLFW/glfw3.h>
 #include <glm/gtc/matrix_transform.hpp>
+#ifdef TUTORIAL_HAS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <chrono>
+#include <cstdio>
 
 std::weak_ptr<Camera> CameraManager::currentCamera;
 GLFWwindow* CameraManager::currentWindow = nullptr;
+bool CameraManager::bHeadless = false;
+void* CameraManager::headlessDisplay = nullptr;
+void* CameraManager::headlessSurface = nullptr;
+void* CameraManager::headlessContext = nullptr;
 float CameraManager::mouseX = 0.0f;
 float CameraManager::mouseY = 0.0f;
 float CameraManager::mouseSensitivityX = 0.05f;
@@ -125,25 +136,171 @@ void CameraManager::disableCameraLook() {
     CameraManager::removeMouseMovementCallback();
 }
 
-void CameraManager::initialize(int viewportW, int viewportH) {
-    glfwInit();
+bool CameraManager::initialize(int viewportW, int viewportH, bool bHeadless) {
+    CameraManager::bHeadless = bHeadless;
+    bool bInitialized = bHeadless ? CameraManager::initializeHeadless(viewportW, viewportH) : CameraManager::initializeWindow(viewportW, viewportH);
+    if (!bInitialized) {
+        return false;
+    }
+    CameraManager::aspectRatio = static_cast<float>(viewportW) / static_cast<float>(viewportH);
+    CameraManager::setVerticalFOV(CameraManager::horizontalFOV / CameraManager::aspectRatio);
+    return true;
+}
+
+bool CameraManager::initializeWindow(int viewportW, int viewportH) {
+    if (!glfwInit()) {
+        return false;
+    }
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
     glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
     CameraManager::currentWindow = glfwCreateWindow(viewportW, viewportH, "OpenGL tutorial", nullptr, nullptr);
+    if (!CameraManager::currentWindow) {
+        return false;
+    }
     glfwMakeContextCurrent(CameraManager::currentWindow);
-    CameraManager::aspectRatio = static_cast<float>(viewportW) / static_cast<float>(viewportH);
-    CameraManager::setVerticalFOV(CameraManager::horizontalFOV / CameraManager::aspectRatio);
+    return true;
+}
+
+#ifdef TUTORIAL_HAS_EGL
+// Render into a pbuffer so that the default framebuffer exists exactly like
+// it does for a window. The surfaceless platform lets this work without any
+// display server, e.g. with Mesa's llvmpipe on CI machines.
+bool CameraManager::initializeHeadless(int viewportW, int viewportH) {
+    EGLDisplay display = EGL_NO_DISPLAY;
+    auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay) {
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    if (display == EGL_NO_DISPLAY) {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    if (display == EGL_NO_DISPLAY or !eglInitialize(display, nullptr, nullptr)) {
+        std::fprintf(stderr, "Failed to initialize EGL display\n");
+        return false;
+    }
+    CameraManager::headlessDisplay = display;
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        std::fprintf(stderr, "EGL does not support desktop OpenGL\n");
+        return false;
+    }
+
+    const EGLint configAttributes[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_STENCIL_SIZE, 8,
+        EGL_NONE};
+    EGLConfig config;
+    EGLint numConfigs = 0;
+    if (!eglChooseConfig(display, configAttributes, &config, 1, &numConfigs) or numConfigs < 1) {
+        std::fprintf(stderr, "No suitable EGL config for a pbuffer surface\n");
+        return false;
+    }
+
+    const EGLint surfaceAttributes[] = {
+        EGL_WIDTH, viewportW,
+        EGL_HEIGHT, viewportH,
+        EGL_NONE};
+    EGLSurface surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+    if (surface == EGL_NO_SURFACE) {
+        std::fprintf(stderr, "Failed to create EGL pbuffer surface\n");
+        return false;
+    }
+    CameraManager::headlessSurface = surface;
+
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_CONTEXT_OPENGL_DEBUG, EGL_TRUE,
+        EGL_NONE};
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+    if (context == EGL_NO_CONTEXT) {
+        std::fprintf(stderr, "Failed to create OpenGL 3.3 core EGL context\n");
+        return false;
+    }
+    CameraManager::headlessContext = context;
+
+    return eglMakeCurrent(display, surface, surface, context);
+}
+#else
+bool CameraManager::initializeHeadless(int, int) {
+    std::fprintf(stderr, "Headless rendering requires building with EGL\n");
+    return false;
 }
+#endif
 
 void CameraManager::terminate() {
     CameraManager::currentCamera.reset();
-    CameraManager::currentWindow = nullptr;
-    glfwTerminate();
+#ifdef TUTORIAL_HAS_EGL
+    if (CameraManager::headlessDisplay) {
+        eglMakeCurrent(CameraManager::headlessDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (CameraManager::headlessContext) {
+            eglDestroyContext(CameraManager::headlessDisplay, CameraManager::headlessContext);
+        }
+        if (CameraManager::headlessSurface) {
+            eglDestroySurface(CameraManager::headlessDisplay, CameraManager::headlessSurface);
+        }
+        eglTerminate(CameraManager::headlessDisplay);
+    }
+#endif
+    CameraManager::headlessDisplay = nullptr;
+    CameraManager::headlessSurface = nullptr;
+    CameraManager::headlessContext = nullptr;
+    if (!CameraManager::bHeadless) {
+        CameraManager::currentWindow = nullptr;
+        glfwTerminate();
+    }
 }
 
 GLFWwindow* CameraManager::getWindow() {
     return CameraManager::currentWindow;
 }
+
+bool CameraManager::isHeadless() {
+    return CameraManager::bHeadless;
+}
+
+bool CameraManager::shouldClose() {
+    if (!CameraManager::currentWindow) {
+        return false;
+    }
+    return glfwWindowShouldClose(CameraManager::currentWindow);
+}
+
+void CameraManager::swapBuffers() {
+#ifdef TUTORIAL_HAS_EGL
+    if (CameraManager::headlessSurface) {
+        eglSwapBuffers(CameraManager::headlessDisplay, CameraManager::headlessSurface);
+        return;
+    }
+#endif
+    if (CameraManager::currentWindow) {
+        glfwSwapBuffers(CameraManager::currentWindow);
+        glfwPollEvents();
+    }
+}
+
+double CameraManager::getTime() {
+    if (!CameraManager::bHeadless) {
+        return glfwGetTime();
+    }
+    static const auto startTime = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void* CameraManager::getProcAddress(const char* procName) {
+#ifdef TUTORIAL_HAS_EGL
+    if (CameraManager::bHeadless) {
+        return reinterpret_cast<void*>(eglGetProcAddress(procName));
+    }
+#endif
+    return reinterpret_cast<void*>(glfwGetProcAddress(procName));
+}
@@ -0,0 +1,101 @@
+#include "FrameRingBuffer.hpp"
+#include "CPUProfiler.hpp"
+
+FrameRingBuffer::~FrameRingBuffer() {
+    this->free();
+}
+
+GLintptr FrameRingBuffer::reserve(GLsizeiptr size) {
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    GLintptr offset = (this->frameSize + alignment - 1) / alignment * alignment;
+    this->frameSize = offset + size;
+    return offset;
+}
+
+// Frames start on the alignment too, as reserve only aligns within a frame
+void FrameRingBuffer::create() {
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    this->frameSize = (this->frameSize + alignment - 1) / alignment * alignment;
+    glGenBuffers(1, &this->buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, this->buffer);
+    if (FrameRingBuffer::isPersistentMappingSupported()) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_WRITE_BUFFER, this->frameSize * NUM_FRAMES, nullptr, flags);
+        this->mappedData = static_cast<std::byte*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, this->frameSize * NUM_FRAMES, flags));
+    } else {
+        glBufferData(GL_COPY_WRITE_BUFFER, this->frameSize, nullptr, GL_STREAM_DRAW);
+        this->stagingData.resize(this->frameSize);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void FrameRingBuffer::free() {
+    for (auto& fence: this->fences) {
+        if (fence) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+    if (this->buffer) {
+        if (this->mappedData) {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, this->buffer);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        }
+        glDeleteBuffers(1, &this->buffer);
+        this->buffer = 0;
+    }
+    this->mappedData = nullptr;
+    this->stagingData.clear();
+    this->frameSize = 0;
+}
+
+// Usually the fence signaled long ago, a wait means the GPU is NUM_FRAMES - 1 frames behind
+void FrameRingBuffer::beginFrame() {
+    auto& fence = this->fences[this->currentFrame];
+    if (!fence) {
+        return;
+    }
+    if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+        ScopedCPUZone cpuZone("Wait for frame ring buffer");
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {
+        }
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+std::byte* FrameRingBuffer::getPointer(GLintptr offset) {
+    if (this->mappedData) {
+        return this->mappedData + this->frameSize * this->currentFrame + offset;
+    }
+    return this->stagingData.data() + offset;
+}
+
+// The mapping is coherent, so only the orphaning path has work to do
+void FrameRingBuffer::flush() {
+    if (this->mappedData) {
+        return;
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, this->buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, this->frameSize, this->stagingData.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void FrameRingBuffer::bindRange(GLenum target, GLuint index, GLintptr offset, GLsizeiptr size) const {
+    GLintptr frameOffset = this->mappedData ? this->frameSize * this->currentFrame : 0;
+    glBindBufferRange(target, index, this->buffer, frameOffset + offset, size);
+}
+
+void FrameRingBuffer::endFrame() {
+    if (this->mappedData) {
+        this->fences[this->currentFrame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        this->currentFrame = (this->currentFrame + 1) % NUM_FRAMES;
+    }
+}
+
+bool FrameRingBuffer::isPersistentMappingSupported() {
+    return GLAD_GL_ARB_buffer_storage;
+}
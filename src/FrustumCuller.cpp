@@ -0,0 +1,210 @@
+#include "FrustumCuller.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#define TUTORIAL_HAS_SSE2
+#if defined(__GNUC__) || defined(__clang__)
+#define TUTORIAL_TARGET_AVX __attribute__((target("avx")))
+#define TUTORIAL_HAS_AVX
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#define TUTORIAL_TARGET_AVX
+#define TUTORIAL_HAS_AVX
+#endif
+#endif
+
+BoundingSphere computeBoundingSphere(const std::vector<GLfloat>& vertexData, std::size_t stride) {
+    if (vertexData.size() < 3) {
+        return {};
+    }
+    glm::vec3 minCorner(std::numeric_limits<float>::max()), maxCorner(std::numeric_limits<float>::lowest());
+    for (std::size_t i = 0; i + 2 < vertexData.size(); i += stride) {
+        glm::vec3 position(vertexData[i], vertexData[i + 1], vertexData[i + 2]);
+        minCorner = glm::min(minCorner, position);
+        maxCorner = glm::max(maxCorner, position);
+    }
+    BoundingSphere sphere;
+    sphere.center = 0.5f * (minCorner + maxCorner);
+    for (std::size_t i = 0; i + 2 < vertexData.size(); i += stride) {
+        glm::vec3 position(vertexData[i], vertexData[i + 1], vertexData[i + 2]);
+        sphere.radius = std::max(sphere.radius, glm::length(position - sphere.center));
+    }
+    return sphere;
+}
+
+BoundingSphere transformBoundingSphere(const BoundingSphere& sphere, const glm::mat4& model) {
+    float scale = std::max({glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))});
+    return {glm::vec3(model * glm::vec4(sphere.center, 1.0f)), sphere.radius * scale};
+}
+
+// Planes are sums and differences of the rows of the matrix, normalized so
+// their distance to a point is in world units
+std::array<glm::vec4, 6> extractFrustumPlanes(const glm::mat4& viewProjection, bool bDepth) {
+    glm::mat4 rows = glm::transpose(viewProjection);
+    std::array<glm::vec4, 6> planes = {rows[3] + rows[0], rows[3] - rows[0],
+                                       rows[3] + rows[1], rows[3] - rows[1],
+                                       rows[3] + rows[2], rows[3] - rows[2]};
+    for (auto& plane: planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    if (!bDepth) {
+        planes[4] = planes[5] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+    return planes;
+}
+
+namespace {
+#ifndef TUTORIAL_HAS_SSE2
+bool isSphereVisible(float x, float y, float z, float radius, const std::vector<glm::vec4>& planes) {
+    for (std::size_t frustum = 0; frustum < planes.size(); frustum += 6) {
+        bool bInside = true;
+        for (std::size_t p = frustum; p < frustum + 6 and bInside; p++) {
+            bInside = planes[p].x * x + planes[p].y * y + planes[p].z * z + planes[p].w >= -radius;
+        }
+        if (bInside) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void cullScalar(const float* x, const float* y, const float* z, const float* radius, const std::vector<glm::vec4>& planes, std::size_t first, std::size_t end, std::vector<GLuint>& visible) {
+    for (std::size_t i = first; i < end; i++) {
+        if (isSphereVisible(x[i], y[i], z[i], radius[i], planes)) {
+            visible.push_back(i);
+        }
+    }
+}
+#else
+// Lanes before first and from end on belong to other ranges and are masked off
+int getRangeMask(std::size_t group, std::size_t width, std::size_t first, std::size_t end) {
+    int mask = 0;
+    for (std::size_t lane = 0; lane < width; lane++) {
+        mask |= (group + lane >= first and group + lane < end) << lane;
+    }
+    return mask;
+}
+
+void appendLanes(int mask, std::size_t group, std::size_t width, std::vector<GLuint>& visible) {
+    for (std::size_t lane = 0; lane < width; lane++) {
+        if (mask & (1 << lane)) {
+            visible.push_back(group + lane);
+        }
+    }
+}
+
+void cullSSE2(const float* x, const float* y, const float* z, const float* radius, const std::vector<glm::vec4>& planes, std::size_t first, std::size_t end, std::vector<GLuint>& visible) {
+    const __m128 zero = _mm_setzero_ps();
+    for (std::size_t group = first / 4 * 4; group < end; group += 4) {
+        __m128 sphereX = _mm_loadu_ps(x + group);
+        __m128 sphereY = _mm_loadu_ps(y + group);
+        __m128 sphereZ = _mm_loadu_ps(z + group);
+        __m128 negativeRadius = _mm_sub_ps(zero, _mm_loadu_ps(radius + group));
+        int rangeMask = getRangeMask(group, 4, first, end);
+        int visibleMask = 0;
+        for (std::size_t frustum = 0; frustum < planes.size() and visibleMask != rangeMask; frustum += 6) {
+            __m128 bInside = _mm_cmpeq_ps(zero, zero);
+            for (std::size_t p = frustum; p < frustum + 6; p++) {
+                __m128 distance = _mm_add_ps(_mm_mul_ps(sphereX, _mm_set1_ps(planes[p].x)), _mm_set1_ps(planes[p].w));
+                distance = _mm_add_ps(distance, _mm_mul_ps(sphereY, _mm_set1_ps(planes[p].y)));
+                distance = _mm_add_ps(distance, _mm_mul_ps(sphereZ, _mm_set1_ps(planes[p].z)));
+                bInside = _mm_and_ps(bInside, _mm_cmpge_ps(distance, negativeRadius));
+            }
+            visibleMask |= _mm_movemask_ps(bInside) & rangeMask;
+        }
+        appendLanes(visibleMask, group, 4, visible);
+    }
+}
+#endif
+
+#ifdef TUTORIAL_HAS_AVX
+TUTORIAL_TARGET_AVX void cullAVX(const float* x, const float* y, const float* z, const float* radius, const std::vector<glm::vec4>& planes, std::size_t first, std::size_t end, std::vector<GLuint>& visible) {
+    const __m256 zero = _mm256_setzero_ps();
+    for (std::size_t group = first / 8 * 8; group < end; group += 8) {
+        __m256 sphereX = _mm256_loadu_ps(x + group);
+        __m256 sphereY = _mm256_loadu_ps(y + group);
+        __m256 sphereZ = _mm256_loadu_ps(z + group);
+        __m256 negativeRadius = _mm256_sub_ps(zero, _mm256_loadu_ps(radius + group));
+        int rangeMask = getRangeMask(group, 8, first, end);
+        int visibleMask = 0;
+        for (std::size_t frustum = 0; frustum < planes.size() and visibleMask != rangeMask; frustum += 6) {
+            __m256 bInside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+            for (std::size_t p = frustum; p < frustum + 6; p++) {
+                __m256 distance = _mm256_add_ps(_mm256_mul_ps(sphereX, _mm256_set1_ps(planes[p].x)), _mm256_set1_ps(planes[p].w));
+                distance = _mm256_add_ps(distance, _mm256_mul_ps(sphereY, _mm256_set1_ps(planes[p].y)));
+                distance = _mm256_add_ps(distance, _mm256_mul_ps(sphereZ, _mm256_set1_ps(planes[p].z)));
+                bInside = _mm256_and_ps(bInside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+            }
+            visibleMask |= _mm256_movemask_ps(bInside) & rangeMask;
+        }
+        appendLanes(visibleMask, group, 8, visible);
+    }
+}
+
+bool isAVXSupported() {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_cpu_supports("avx");
+#else
+    int cpuInfo[4];
+    __cpuid(cpuInfo, 1);
+    bool bOSXSave = (cpuInfo[2] & (1 << 27)) != 0;
+    bool bAVX = (cpuInfo[2] & (1 << 28)) != 0;
+    return bOSXSave and bAVX and (_xgetbv(0) & 0x6) == 0x6;
+#endif
+}
+#endif
+}  // namespace
+
+// Padding spheres sit at the origin with a negative radius, the range mask
+// keeps them out of the results
+void FrustumCuller::setSpheres(const std::vector<BoundingSphere>& spheres) {
+    this->numSpheres = spheres.size();
+    std::size_t paddedSize = (spheres.size() + FrustumCuller::SPHERE_ALIGNMENT - 1) / FrustumCuller::SPHERE_ALIGNMENT * FrustumCuller::SPHERE_ALIGNMENT;
+    this->x.assign(paddedSize, 0.0f);
+    this->y.assign(paddedSize, 0.0f);
+    this->z.assign(paddedSize, 0.0f);
+    this->radius.assign(paddedSize, -1.0f);
+    for (std::size_t i = 0; i < spheres.size(); i++) {
+        this->x[i] = spheres[i].center.x;
+        this->y[i] = spheres[i].center.y;
+        this->z[i] = spheres[i].center.z;
+        this->radius[i] = spheres[i].radius;
+    }
+}
+
+std::size_t FrustumCuller::getNumSpheres() const {
+    return this->numSpheres;
+}
+
+void FrustumCuller::cull(const std::vector<glm::mat4>& viewProjections, bool bDepth, std::size_t first, std::size_t count, std::vector<GLuint>& visible) const {
+    static const CullKernel kernel = FrustumCuller::selectKernel();
+    std::size_t end = std::min(first + count, this->numSpheres);
+    if (first >= end or viewProjections.empty()) {
+        return;
+    }
+    std::vector<glm::vec4> planes;
+    planes.reserve(6 * viewProjections.size());
+    for (const auto& viewProjection: viewProjections) {
+        auto frustumPlanes = extractFrustumPlanes(viewProjection, bDepth);
+        planes.insert(planes.end(), frustumPlanes.begin(), frustumPlanes.end());
+    }
+    kernel(this->x.data(), this->y.data(), this->z.data(), this->radius.data(), planes, first, end, visible);
+}
+
+FrustumCuller::CullKernel FrustumCuller::selectKernel() {
+#ifdef TUTORIAL_HAS_AVX
+    if (isAVXSupported()) {
+        return cullAVX;
+    }
+#endif
+#ifdef TUTORIAL_HAS_SSE2
+    return cullSSE2;
+#else
+    return cullScalar;
+#endif
+}
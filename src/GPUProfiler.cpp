@@ -0,0 +1,138 @@
+#include "GPUProfiler.hpp"
+
+#include <algorithm>
+
+bool GPUProfiler::bEnabled = true;
+std::array<GPUProfiler::FrameQueries, GPUProfiler::FRAME_LATENCY> GPUProfiler::frames;
+std::size_t GPUProfiler::currentFrame = 0;
+unsigned long GPUProfiler::frameNumber = 0;
+int GPUProfiler::sectionDepth = 0;
+bool GPUProfiler::bFrameActive = false;
+std::vector<GPUSectionTime> GPUProfiler::sectionTimes;
+std::ofstream GPUProfiler::log;
+
+void GPUProfiler::beginFrame() {
+    if (!GPUProfiler::bEnabled) {
+        return;
+    }
+    auto& frame = GPUProfiler::frames[GPUProfiler::currentFrame];
+    GPUProfiler::collectFrame(frame);
+    frame.numSections = 0;
+    frame.frameNumber = GPUProfiler::frameNumber;
+    GPUProfiler::sectionDepth = 0;
+    GPUProfiler::bFrameActive = true;
+}
+
+void GPUProfiler::endFrame() {
+    if (!GPUProfiler::bFrameActive) {
+        return;
+    }
+    auto& frame = GPUProfiler::frames[GPUProfiler::currentFrame];
+    frame.bPending = frame.numSections > 0;
+    GPUProfiler::bFrameActive = false;
+    GPUProfiler::currentFrame = (GPUProfiler::currentFrame + 1) % GPUProfiler::FRAME_LATENCY;
+    GPUProfiler::frameNumber++;
+}
+
+void GPUProfiler::beginSection(const char* sectionName) {
+    if (!GPUProfiler::bFrameActive or GPUProfiler::sectionDepth++ > 0) {
+        return;
+    }
+    auto& frame = GPUProfiler::frames[GPUProfiler::currentFrame];
+    if (frame.numSections == frame.queries.size()) {
+        GLuint query;
+        glGenQueries(1, &query);
+        frame.queries.push_back(query);
+        frame.sectionNames.push_back(nullptr);
+    }
+    frame.sectionNames[frame.numSections] = sectionName;
+    glBeginQuery(GL_TIME_ELAPSED, frame.queries[frame.numSections]);
+    frame.numSections++;
+}
+
+void GPUProfiler::endSection() {
+    if (!GPUProfiler::bFrameActive or --GPUProfiler::sectionDepth > 0) {
+        return;
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+}
+
+// Results of a frame that are still not available when its slot comes up for
+// reuse are dropped rather than waited for.
+void GPUProfiler::collectFrame(FrameQueries& frame) {
+    if (!frame.bPending) {
+        return;
+    }
+    frame.bPending = false;
+    GLint bAvailable = GL_FALSE;
+    glGetQueryObjectiv(frame.queries[frame.numSections - 1], GL_QUERY_RESULT_AVAILABLE, &bAvailable);
+    if (!bAvailable) {
+        return;
+    }
+
+    for (auto& sectionTime: GPUProfiler::sectionTimes) {
+        sectionTime.bActive = false;
+    }
+    for (std::size_t i = 0; i < frame.numSections; i++) {
+        GLuint64 elapsedTime;
+        glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &elapsedTime);
+        double sectionTime = elapsedTime / 1.0e6;
+        std::string sectionName = frame.sectionNames[i];
+
+        auto it = std::find_if(GPUProfiler::sectionTimes.begin(), GPUProfiler::sectionTimes.end(), [&sectionName](const GPUSectionTime& s) {
+            return s.name == sectionName;
+        });
+        if (it == GPUProfiler::sectionTimes.end()) {
+            GPUProfiler::sectionTimes.push_back({sectionName, sectionTime, sectionTime, true});
+        } else if (it->bActive) {
+            it->lastTime += sectionTime;
+            it->averageTime += 0.1 * sectionTime;
+        } else {
+            it->lastTime = sectionTime;
+            it->averageTime = 0.9 * it->averageTime + 0.1 * sectionTime;
+            it->bActive = true;
+        }
+
+        if (GPUProfiler::log.is_open()) {
+            GPUProfiler::log << frame.frameNumber << ',' << sectionName << ',' << sectionTime << '\n';
+        }
+    }
+}
+
+const std::vector<GPUSectionTime>& GPUProfiler::getSectionTimes() {
+    return GPUProfiler::sectionTimes;
+}
+
+double GPUProfiler::getFrameTime() {
+    double frameTime = 0.0;
+    for (const auto& sectionTime: GPUProfiler::sectionTimes) {
+        if (sectionTime.bActive) {
+            frameTime += sectionTime.averageTime;
+        }
+    }
+    return frameTime;
+}
+
+bool GPUProfiler::openLog(const std::filesystem::path& logPath) {
+    GPUProfiler::log.open(logPath);
+    if (!GPUProfiler::log) {
+        return false;
+    }
+    GPUProfiler::log << "frame,section,gpu_ms\n";
+    return true;
+}
+
+void GPUProfiler::terminate() {
+    glFinish();
+    for (std::size_t i = 0; i < GPUProfiler::FRAME_LATENCY; i++) {
+        auto& frame = GPUProfiler::frames[(GPUProfiler::currentFrame + i) % GPUProfiler::FRAME_LATENCY];
+        GPUProfiler::collectFrame(frame);
+        glDeleteQueries(frame.queries.size(), frame.queries.data());
+        frame = {};
+    }
+    GPUProfiler::sectionTimes.clear();
+    GPUProfiler::bFrameActive = false;
+    if (GPUProfiler::log.is_open()) {
+        GPUProfiler::log.close();
+    }
+}
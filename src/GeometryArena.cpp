@@ -0,0 +1,259 @@
+#include "GeometryArena.hpp"
+
+#include <algorithm>
+
+GeometryArena::~GeometryArena() {
+    this->free();
+}
+
+MeshRange GeometryArena::addMesh(const std::vector<GLfloat>& vertexData, const std::vector<GLuint>& vertexIndices) {
+    MeshRange mesh;
+    mesh.firstIndex = this->vertexIndices.size();
+    mesh.numIndices = vertexIndices.size();
+    mesh.baseVertex = this->vertexData.size() / GeometryArena::VERTEX_SIZE;
+    mesh.bounds = computeBoundingSphere(vertexData, GeometryArena::VERTEX_SIZE);
+    this->vertexData.insert(this->vertexData.end(), vertexData.begin(), vertexData.end());
+    this->vertexIndices.insert(this->vertexIndices.end(), vertexIndices.begin(), vertexIndices.end());
+    return mesh;
+}
+
+// The CPU copy of the geometry is released once it is on the GPU
+void GeometryArena::upload() {
+    if (!this->VBO) {
+        glGenBuffers(1, &this->VBO);
+        glGenBuffers(1, &this->EBO);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * this->vertexData.size(), this->vertexData.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * this->vertexIndices.size(), this->vertexIndices.data(), GL_STATIC_DRAW);
+    this->vertexData = {};
+    this->vertexIndices = {};
+}
+
+void GeometryArena::free() {
+    if (this->VBO) {
+        glDeleteBuffers(1, &this->VBO);
+        glDeleteBuffers(1, &this->EBO);
+        this->VBO = this->EBO = 0;
+    }
+}
+
+void GeometryArena::setupVertexArray(GLuint VAO) const {
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->EBO);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, GeometryArena::VERTEX_SIZE * sizeof(GLfloat), nullptr);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, GeometryArena::VERTEX_SIZE * sizeof(GLfloat), reinterpret_cast<void*>(3 * sizeof(GLfloat)));
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, GeometryArena::VERTEX_SIZE * sizeof(GLfloat), reinterpret_cast<void*>(6 * sizeof(GLfloat)));
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+}
+
+void GeometryArena::setupPositionVertexArray(GLuint VAO) const {
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->EBO);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, GeometryArena::VERTEX_SIZE * sizeof(GLfloat), nullptr);
+    glEnableVertexAttribArray(0);
+}
+
+GLuint GeometryArena::getVertexBuffer() const {
+    return this->VBO;
+}
+
+GLuint GeometryArena::getElementBuffer() const {
+    return this->EBO;
+}
+
+void GeometryArena::drawMesh(const MeshRange& mesh, GLsizei numInstances) {
+    if (numInstances == 1) {
+        glDrawElementsBaseVertex(GL_TRIANGLES, mesh.numIndices, GL_UNSIGNED_INT, mesh.getIndexOffset(), mesh.baseVertex);
+    } else {
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, mesh.numIndices, GL_UNSIGNED_INT, mesh.getIndexOffset(), numInstances, mesh.baseVertex);
+    }
+}
+
+void InstanceAttributes::setup(GLuint VAO, GLuint instanceVBO) {
+    glBindVertexArray(VAO);
+    InstanceAttributes::bind(instanceVBO, 0);
+    for (int i = 0; i < 8; i++) {
+        glVertexAttribDivisor(3 + i, 1);
+        glEnableVertexAttribArray(3 + i);
+    }
+}
+
+// Without base instance support the attributes themselves are offset to the
+// first instance of a draw
+void InstanceAttributes::bind(GLuint instanceVBO, GLuint baseInstance) {
+    constexpr GLsizei stride = InstanceAttributes::INSTANCE_SIZE * sizeof(GLfloat);
+    std::size_t offset = baseInstance * stride;
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    for (int i = 0; i < 4; i++) {
+        glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void*>(offset + 4 * i * sizeof(GLfloat)));
+    }
+    for (int i = 0; i < 3; i++) {
+        glVertexAttribPointer(7 + i, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void*>(offset + (16 + 3 * i) * sizeof(GLfloat)));
+    }
+    glVertexAttribPointer(10, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void*>(offset + InstanceAttributes::MATERIAL_OFFSET * sizeof(GLfloat)));
+}
+
+DrawCommandBuffer::~DrawCommandBuffer() {
+    this->free();
+}
+
+int DrawCommandBuffer::addDraw(const MeshRange& mesh, GLuint numInstances, GLuint baseInstance) {
+    this->commands.push_back({mesh.numIndices, numInstances, mesh.firstIndex, mesh.baseVertex, baseInstance});
+    return this->commands.size() - 1;
+}
+
+int DrawCommandBuffer::addDraw(const DrawElementsIndirectCommand& command) {
+    this->commands.push_back(command);
+    return this->commands.size() - 1;
+}
+
+const DrawElementsIndirectCommand& DrawCommandBuffer::getCommand(int command) const {
+    return this->commands[command];
+}
+
+void DrawCommandBuffer::clear() {
+    this->commands.clear();
+}
+
+void DrawCommandBuffer::upload(GLuint instanceVBO, GLenum usage) {
+    this->instanceVBO = instanceVBO;
+    if (!DrawCommandBuffer::isMultiDrawIndirectSupported()) {
+        return;
+    }
+    if (!this->commandBuffer) {
+        glGenBuffers(1, &this->commandBuffer);
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, this->commandBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand) * this->commands.size(), this->commands.data(), usage);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void DrawCommandBuffer::draw(int firstCommand, int numCommands) const {
+    if (this->commandBuffer) {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, this->commandBuffer);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<const void*>(sizeof(DrawElementsIndirectCommand) * firstCommand), numCommands, 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        return;
+    }
+    for (int i = firstCommand; i < firstCommand + numCommands; i++) {
+        const auto& command = this->commands[i];
+        if (!command.instanceCount) {
+            continue;
+        }
+        const void* indexOffset = reinterpret_cast<const void*>(sizeof(GLuint) * command.firstIndex);
+        if (GLAD_GL_ARB_base_instance) {
+            glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, command.count, GL_UNSIGNED_INT, indexOffset, command.instanceCount, command.baseVertex, command.baseInstance);
+            continue;
+        }
+        InstanceAttributes::bind(this->instanceVBO, command.baseInstance);
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.count, GL_UNSIGNED_INT, indexOffset, command.instanceCount, command.baseVertex);
+    }
+    if (!GLAD_GL_ARB_base_instance) {
+        InstanceAttributes::bind(this->instanceVBO, 0);
+    }
+}
+
+void DrawCommandBuffer::free() {
+    if (this->commandBuffer) {
+        glDeleteBuffers(1, &this->commandBuffer);
+        this->commandBuffer = 0;
+    }
+}
+
+// The base instance of indirect commands is only honored with GL_ARB_base_instance
+bool DrawCommandBuffer::isMultiDrawIndirectSupported() {
+    return GLAD_GL_ARB_draw_indirect and GLAD_GL_ARB_multi_draw_indirect and GLAD_GL_ARB_base_instance;
+}
+
+VisibleInstanceBuffer::~VisibleInstanceBuffer() {
+    this->free();
+}
+
+void VisibleInstanceBuffer::create(std::vector<GLfloat> instanceData) {
+    this->instanceData = std::move(instanceData);
+    if (!this->instanceVBO) {
+        glGenBuffers(1, &this->instanceVBO);
+    }
+}
+
+void VisibleInstanceBuffer::free() {
+    this->visibleCommands.free();
+    if (this->instanceVBO) {
+        glDeleteBuffers(1, &this->instanceVBO);
+        this->instanceVBO = 0;
+    }
+    this->instanceData = {};
+    this->visibleInstanceData = {};
+}
+
+void VisibleInstanceBuffer::setupVertexArray(GLuint VAO) const {
+    InstanceAttributes::setup(VAO, this->instanceVBO);
+}
+
+// Commands without visible instances are kept with an instance count of zero,
+// so command indices stay the same as in drawCommands
+void VisibleInstanceBuffer::update(const DrawCommandBuffer& drawCommands, int firstCommand, int numCommands, const std::vector<GLuint>& visibleInstances) {
+    this->firstCommand = firstCommand;
+    this->visibleCommands.clear();
+    this->visibleInstanceData.clear();
+    GLuint numVisibleInstances = 0;
+    for (int i = firstCommand; i < firstCommand + numCommands; i++) {
+        DrawElementsIndirectCommand command = drawCommands.getCommand(i);
+        GLuint numCommandInstances = this->appendInstances(command, visibleInstances);
+        command.baseInstance = numVisibleInstances;
+        command.instanceCount = numCommandInstances;
+        numVisibleInstances += numCommandInstances;
+        this->visibleCommands.addDraw(command);
+    }
+    this->upload();
+}
+
+void VisibleInstanceBuffer::updateLayered(const DrawCommandBuffer& drawCommands, int firstCommand, int numCommands, const std::vector<std::vector<GLuint>>& layerInstances) {
+    this->firstCommand = firstCommand;
+    this->visibleCommands.clear();
+    this->visibleInstanceData.clear();
+    GLuint numVisibleInstances = 0;
+    for (int i = firstCommand; i < firstCommand + numCommands; i++) {
+        DrawElementsIndirectCommand command = drawCommands.getCommand(i);
+        GLuint numCommandInstances = 0;
+        for (std::size_t layer = 0; layer < layerInstances.size(); layer++) {
+            std::size_t firstLayerInstance = this->visibleInstanceData.size();
+            GLuint numLayerInstances = this->appendInstances(command, layerInstances[layer]);
+            for (GLuint j = 0; j < numLayerInstances; j++) {
+                this->visibleInstanceData[firstLayerInstance + j * InstanceAttributes::INSTANCE_SIZE + InstanceAttributes::MATERIAL_OFFSET] = layer;
+            }
+            numCommandInstances += numLayerInstances;
+        }
+        command.baseInstance = numVisibleInstances;
+        command.instanceCount = numCommandInstances;
+        numVisibleInstances += numCommandInstances;
+        this->visibleCommands.addDraw(command);
+    }
+    this->upload();
+}
+
+void VisibleInstanceBuffer::draw(int firstCommand, int numCommands) const {
+    this->visibleCommands.draw(firstCommand - this->firstCommand, numCommands);
+}
+
+GLuint VisibleInstanceBuffer::appendInstances(const DrawElementsIndirectCommand& command, const std::vector<GLuint>& visibleInstances) {
+    auto begin = std::lower_bound(visibleInstances.begin(), visibleInstances.end(), command.baseInstance);
+    auto end = std::lower_bound(begin, visibleInstances.end(), command.baseInstance + command.instanceCount);
+    for (auto it = begin; it != end; it++) {
+        auto instance = this->instanceData.begin() + *it * InstanceAttributes::INSTANCE_SIZE;
+        this->visibleInstanceData.insert(this->visibleInstanceData.end(), instance, instance + InstanceAttributes::INSTANCE_SIZE);
+    }
+    return end - begin;
+}
+
+void VisibleInstanceBuffer::upload() {
+    glBindBuffer(GL_ARRAY_BUFFER, this->instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * this->visibleInstanceData.size(), this->visibleInstanceData.data(), GL_STREAM_DRAW);
+    this->visibleCommands.upload(this->instanceVBO, GL_STREAM_DRAW);
+}
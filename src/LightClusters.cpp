@@ -0,0 +1,276 @@
+#include "LightClusters.hpp"
+#include "CPUProfiler.hpp"
+#include "ThreadPool.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#define TUTORIAL_HAS_SSE2
+#endif
+
+namespace {
+std::size_t roundUpToSIMD(std::size_t count) {
+    return (count + 3) / 4 * 4;
+}
+
+// Smallest sphere around the cone of a spot light, which is centered on the
+// cone base for wide cones and passes through the apex for narrow ones
+std::pair<glm::vec3, float> boundSpotLight(const SpotLight& light) {
+    float range = light.getRange();
+    float cosAngle = light.outerAngleCos;
+    glm::vec3 direction = glm::normalize(light.direction);
+    if (cosAngle < glm::sqrt(0.5f)) {
+        return {light.position + direction * range * cosAngle, range * glm::sqrt(1.0f - cosAngle * cosAngle)};
+    }
+    float radius = range / (2.0f * cosAngle);
+    return {light.position + direction * radius, radius};
+}
+}  // namespace
+
+void LightClusters::BoundingSpheres::resize(std::size_t count) {
+    std::size_t paddedCount = roundUpToSIMD(count);
+    this->x.assign(paddedCount, 0.0f);
+    this->y.assign(paddedCount, 0.0f);
+    this->z.assign(paddedCount, 0.0f);
+    // Padding spheres have no volume and lie behind the camera after any transform
+    this->radius.assign(paddedCount, -1.0f);
+}
+
+void LightClusters::BoundingSpheres::set(std::size_t index, const glm::vec3& center, float sphereRadius) {
+    this->x[index] = center.x;
+    this->y[index] = center.y;
+    this->z[index] = center.z;
+    this->radius[index] = sphereRadius;
+}
+
+LightClusters::~LightClusters() {
+    this->free();
+}
+
+void LightClusters::create() {
+    glGenBuffers(2, this->buffers);
+    glGenTextures(2, this->textures);
+    std::array<GLenum, 2> formats = {GL_RG32UI, GL_R32UI};
+    for (int i = 0; i < 2; i++) {
+        glBindTexture(GL_TEXTURE_BUFFER, this->textures[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, formats[i], this->buffers[i]);
+    }
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    GLint maxTextureBufferSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTextureBufferSize);
+    this->maxIndices = maxTextureBufferSize;
+    this->clusters.resize(LightClusters::NUM_CLUSTERS);
+    this->clusterRanges.resize(LightClusters::NUM_CLUSTERS);
+}
+
+void LightClusters::free() {
+    if (this->buffers[0]) {
+        glDeleteTextures(2, this->textures);
+        glDeleteBuffers(2, this->buffers);
+        this->textures[0] = this->textures[1] = 0;
+        this->buffers[0] = this->buffers[1] = 0;
+    }
+    this->clusters.clear();
+    this->clusterRanges.clear();
+    this->indices.clear();
+}
+
+void LightClusters::setLights(const std::vector<PointLight>& pointLights, const std::vector<SpotLight>& spotLights) {
+    this->numPointLights = pointLights.size();
+    this->numSpotLights = spotLights.size();
+    this->worldSpheres.resize(pointLights.size() + spotLights.size());
+    this->viewSpheres.resize(pointLights.size() + spotLights.size());
+    for (std::size_t i = 0; i < pointLights.size(); i++) {
+        this->worldSpheres.set(i, pointLights[i].position, pointLights[i].getRange());
+    }
+    for (std::size_t i = 0; i < spotLights.size(); i++) {
+        this->updateSpotLight(i, spotLights[i]);
+    }
+}
+
+void LightClusters::updateSpotLight(std::size_t index, const SpotLight& light) {
+    auto [center, radius] = boundSpotLight(light);
+    this->worldSpheres.set(this->numPointLights + index, center, radius);
+}
+
+void LightClusters::setFrustum(float verticalFOV, float aspectRatio, float nearPlane, float farPlane) {
+    this->tanHalfFOVY = glm::tan(glm::radians(verticalFOV) / 2.0f);
+    this->tanHalfFOVX = this->tanHalfFOVY * aspectRatio;
+    this->nearPlane = nearPlane;
+    this->farPlane = farPlane;
+}
+
+void LightClusters::assign(const glm::mat4& view, int numSpotLights) {
+    ScopedCPUZone cpuZone("LightClusters::assign");
+    std::size_t numSpheres = this->numPointLights + std::clamp<std::size_t>(numSpotLights, 0, this->numSpotLights);
+    std::size_t numPaddedSpheres = roundUpToSIMD(numSpheres);
+
+    // Centers move to view space, z becomes the positive distance along the view direction
+    const auto& world = this->worldSpheres;
+    auto& viewSpace = this->viewSpheres;
+    std::size_t i = 0;
+#ifdef TUTORIAL_HAS_SSE2
+    for (; i < numPaddedSpheres; i += 4) {
+        __m128 x = _mm_loadu_ps(&world.x[i]);
+        __m128 y = _mm_loadu_ps(&world.y[i]);
+        __m128 z = _mm_loadu_ps(&world.z[i]);
+        __m128 rows[3];
+        for (int row = 0; row < 3; row++) {
+            float sign = row == 2 ? -1.0f : 1.0f;
+            __m128 sum = _mm_set1_ps(sign * view[3][row]);
+            sum = _mm_add_ps(sum, _mm_mul_ps(x, _mm_set1_ps(sign * view[0][row])));
+            sum = _mm_add_ps(sum, _mm_mul_ps(y, _mm_set1_ps(sign * view[1][row])));
+            rows[row] = _mm_add_ps(sum, _mm_mul_ps(z, _mm_set1_ps(sign * view[2][row])));
+        }
+        _mm_storeu_ps(&viewSpace.x[i], rows[0]);
+        _mm_storeu_ps(&viewSpace.y[i], rows[1]);
+        _mm_storeu_ps(&viewSpace.z[i], rows[2]);
+        _mm_storeu_ps(&viewSpace.radius[i], _mm_loadu_ps(&world.radius[i]));
+    }
+#endif
+    for (; i < numPaddedSpheres; i++) {
+        glm::vec3 center = view * glm::vec4(world.x[i], world.y[i], world.z[i], 1.0f);
+        viewSpace.set(i, {center.x, center.y, -center.z}, world.radius[i]);
+    }
+    // Lights past the assigned ones share the last SIMD group and must not be picked up
+    for (i = numSpheres; i < numPaddedSpheres; i++) {
+        viewSpace.radius[i] = -1.0f;
+    }
+
+    ThreadPool::parallelFor(LightClusters::GRID_Z, [&](std::size_t slice) {
+        this->assignSlice(slice, numPaddedSpheres, this->numPointLights);
+    });
+
+    this->indices.clear();
+    for (std::size_t c = 0; c < LightClusters::NUM_CLUSTERS; c++) {
+        const auto& cluster = this->clusters[c];
+        std::size_t count = std::min(cluster.indices.size(), this->maxIndices - this->indices.size());
+        GLuint numClusterPointLights = std::min<GLuint>(cluster.numPointLights, count);
+        GLuint numClusterSpotLights = count - numClusterPointLights;
+        numClusterPointLights = std::min<GLuint>(numClusterPointLights, 0xffff);
+        numClusterSpotLights = std::min<GLuint>(numClusterSpotLights, 0xffff);
+        this->clusterRanges[c] = {this->indices.size(), numClusterPointLights | (numClusterSpotLights << 16)};
+        this->indices.insert(this->indices.end(), cluster.indices.begin(), cluster.indices.begin() + numClusterPointLights);
+        this->indices.insert(this->indices.end(), cluster.indices.begin() + cluster.numPointLights, cluster.indices.begin() + cluster.numPointLights + numClusterSpotLights);
+    }
+}
+
+// Spheres are visited in order, so every cluster lists its point lights
+// before its spot lights
+void LightClusters::assignSlice(int slice, std::size_t numSpheres, GLuint numAssignedPointLights) {
+    float depthRatio = this->farPlane / this->nearPlane;
+    float sliceNear = this->nearPlane * std::pow(depthRatio, static_cast<float>(slice) / LightClusters::GRID_Z);
+    float sliceFar = this->nearPlane * std::pow(depthRatio, static_cast<float>(slice + 1) / LightClusters::GRID_Z);
+    const auto& spheres = this->viewSpheres;
+
+    std::vector<GLuint> candidates;
+    std::size_t i = 0;
+#ifdef TUTORIAL_HAS_SSE2
+    const __m128 nearPlanes = _mm_set1_ps(sliceNear);
+    const __m128 farPlanes = _mm_set1_ps(sliceFar);
+    const __m128 zero = _mm_setzero_ps();
+    for (; i < numSpheres; i += 4) {
+        __m128 z = _mm_loadu_ps(&spheres.z[i]);
+        __m128 radius = _mm_loadu_ps(&spheres.radius[i]);
+        __m128 bInFront = _mm_cmpgt_ps(_mm_add_ps(z, radius), nearPlanes);
+        __m128 bInside = _mm_and_ps(bInFront, _mm_cmplt_ps(_mm_sub_ps(z, radius), farPlanes));
+        int mask = _mm_movemask_ps(_mm_and_ps(bInside, _mm_cmpge_ps(radius, zero)));
+        for (int lane = 0; lane < 4; lane++) {
+            if (mask & (1 << lane)) {
+                candidates.push_back(i + lane);
+            }
+        }
+    }
+#endif
+    for (; i < numSpheres; i++) {
+        float z = spheres.z[i], radius = spheres.radius[i];
+        if (radius >= 0.0f and z + radius > sliceNear and z - radius < sliceFar) {
+            candidates.push_back(i);
+        }
+    }
+
+    // View space boxes of the tile columns and rows over the depth of the slice
+    std::array<float, LightClusters::GRID_X> columnMin, columnMax;
+    std::array<float, LightClusters::GRID_Y> rowMin, rowMax;
+    for (int x = 0; x < LightClusters::GRID_X; x++) {
+        float t0 = (2.0f * x / LightClusters::GRID_X - 1.0f) * this->tanHalfFOVX;
+        float t1 = (2.0f * (x + 1) / LightClusters::GRID_X - 1.0f) * this->tanHalfFOVX;
+        columnMin[x] = std::min(t0 * sliceNear, t0 * sliceFar);
+        columnMax[x] = std::max(t1 * sliceNear, t1 * sliceFar);
+    }
+    for (int y = 0; y < LightClusters::GRID_Y; y++) {
+        float t0 = (2.0f * y / LightClusters::GRID_Y - 1.0f) * this->tanHalfFOVY;
+        float t1 = (2.0f * (y + 1) / LightClusters::GRID_Y - 1.0f) * this->tanHalfFOVY;
+        rowMin[y] = std::min(t0 * sliceNear, t0 * sliceFar);
+        rowMax[y] = std::max(t1 * sliceNear, t1 * sliceFar);
+    }
+
+    auto* sliceClusters = &this->clusters[slice * LightClusters::GRID_X * LightClusters::GRID_Y];
+    for (int c = 0; c < LightClusters::GRID_X * LightClusters::GRID_Y; c++) {
+        sliceClusters[c].indices.clear();
+        sliceClusters[c].numPointLights = 0;
+    }
+    for (GLuint sphere: candidates) {
+        float cx = spheres.x[sphere], cy = spheres.y[sphere], cz = spheres.z[sphere], radius = spheres.radius[sphere];
+        float dz = std::max({sliceNear - cz, 0.0f, cz - sliceFar});
+        float radiusSquared = radius * radius - dz * dz;
+        bool bPointLight = sphere < numAssignedPointLights;
+        GLuint lightIndex = bPointLight ? sphere : sphere - numAssignedPointLights;
+        for (int y = 0; y < LightClusters::GRID_Y; y++) {
+            float dy = std::max({rowMin[y] - cy, 0.0f, cy - rowMax[y]});
+            if (dy * dy > radiusSquared) {
+                continue;
+            }
+            for (int x = 0; x < LightClusters::GRID_X; x++) {
+                float dx = std::max({columnMin[x] - cx, 0.0f, cx - columnMax[x]});
+                if (dx * dx + dy * dy > radiusSquared) {
+                    continue;
+                }
+                auto& cluster = sliceClusters[y * LightClusters::GRID_X + x];
+                cluster.indices.push_back(lightIndex);
+                cluster.numPointLights += bPointLight;
+            }
+        }
+    }
+}
+
+// Both buffers are orphaned, as the previous frame may still read them
+void LightClusters::upload() {
+    glBindBuffer(GL_TEXTURE_BUFFER, this->buffers[0]);
+    glBufferData(GL_TEXTURE_BUFFER, this->clusterRanges.size() * sizeof(glm::uvec2), this->clusterRanges.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, this->buffers[1]);
+    glBufferData(GL_TEXTURE_BUFFER, std::max<std::size_t>(this->indices.size(), 1) * sizeof(GLuint), this->indices.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightClusters::bind() const {
+    glActiveTexture(GL_TEXTURE0 + LightClusters::CLUSTER_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, this->textures[0]);
+    glActiveTexture(GL_TEXTURE0 + LightClusters::INDEX_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, this->textures[1]);
+}
+
+void LightClusters::setupProgram(GLuint program) const {
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "lightClusters"), LightClusters::CLUSTER_TEXTURE_UNIT);
+    glUniform1i(glGetUniformLocation(program, "lightIndices"), LightClusters::INDEX_TEXTURE_UNIT);
+}
+
+glm::vec4 LightClusters::getClusterScale(int viewportW, int viewportH) const {
+    float depthScale = LightClusters::GRID_Z / std::log(this->farPlane / this->nearPlane);
+    return {static_cast<float>(LightClusters::GRID_X) / viewportW,
+            static_cast<float>(LightClusters::GRID_Y) / viewportH,
+            depthScale,
+            -depthScale * std::log(this->nearPlane)};
+}
+
+ShaderDefines LightClusters::getShaderDefines() const {
+    return {{"CLUSTER_GRID_X", std::to_string(LightClusters::GRID_X)},
+            {"CLUSTER_GRID_Y", std::to_string(LightClusters::GRID_Y)},
+            {"CLUSTER_GRID_Z", std::to_string(LightClusters::GRID_Z)}};
+}
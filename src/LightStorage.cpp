@@ -0,0 +1,159 @@
+#include "LightStorage.hpp"
+
+#include <cstring>
+
+static_assert(sizeof(PackedPointLight) == 4 * sizeof(glm::vec4));
+static_assert(sizeof(PackedSpotLight) == 6 * sizeof(glm::vec4));
+static_assert(sizeof(PackedDirectionalLight) == 4 * sizeof(glm::vec4));
+
+namespace {
+PackedLightColor packLightColor(const LightCommon& light) {
+    return {glm::vec4(light.ambient, 0.0f), glm::vec4(light.diffuse, 0.0f), glm::vec4(light.specular, 0.0f)};
+}
+}  // namespace
+
+PackedPointLight packLight(const PointLight& light) {
+    PackedPointLight packed = {packLightColor(light), glm::vec4(light.position, light.radius)};
+    packed.color.ambient.w = light.getRange();
+    return packed;
+}
+
+PackedSpotLight packLight(const SpotLight& light) {
+    PackedSpotLight packed = {packLightColor(light),
+                              glm::vec4(light.position, light.radius),
+                              glm::vec4(light.direction, light.innerAngleCos),
+                              glm::vec4(light.outerAngleCos, 0.0f, 0.0f, 0.0f)};
+    packed.color.ambient.w = light.getRange();
+    return packed;
+}
+
+PackedDirectionalLight packLight(const DirectionalLight& light) {
+    return {packLightColor(light), glm::vec4(light.direction, 0.0f)};
+}
+
+LightStorage::~LightStorage() {
+    this->free();
+}
+
+void LightStorage::create(bool bPreferShaderStorage) {
+    this->bShaderStorage = bPreferShaderStorage and LightStorage::isShaderStorageSupported();
+    glGenBuffers(1, &this->buffer);
+    if (this->bShaderStorage) {
+        GLint maxBlockSize = 0;
+        glGetIntegerv(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &maxBlockSize);
+        this->maxTexels = static_cast<GLuint>(maxBlockSize) / sizeof(glm::vec4);
+    } else {
+        GLint maxTextureBufferSize = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTextureBufferSize);
+        this->maxTexels = maxTextureBufferSize;
+        glGenTextures(1, &this->texture);
+        glBindBuffer(GL_TEXTURE_BUFFER, this->buffer);
+        glBindTexture(GL_TEXTURE_BUFFER, this->texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, this->buffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+}
+
+void LightStorage::free() {
+    if (this->texture) {
+        glDeleteTextures(1, &this->texture);
+        this->texture = 0;
+    }
+    if (this->buffer) {
+        glDeleteBuffers(1, &this->buffer);
+        this->buffer = 0;
+    }
+    this->texels.clear();
+    this->bDirty = false;
+}
+
+template<typename Light>
+void LightStorage::store(std::size_t texel, const Light& light) {
+    auto packed = packLight(light);
+    std::memcpy(static_cast<void*>(&this->texels[texel]), &packed, sizeof(packed));
+    this->bDirty = true;
+}
+
+bool LightStorage::setLights(const std::vector<PointLight>& pointLights, const std::vector<SpotLight>& spotLights, const std::vector<DirectionalLight>& directionalLights) {
+    std::size_t spotStart = LightStorage::POINT_LIGHT_TEXELS * pointLights.size();
+    std::size_t directionalStart = spotStart + LightStorage::SPOT_LIGHT_TEXELS * spotLights.size();
+    std::size_t numTexels = directionalStart + LightStorage::DIRECTIONAL_LIGHT_TEXELS * directionalLights.size();
+    if (numTexels > this->maxTexels) {
+        return false;
+    }
+    this->spotLightsStart = spotStart;
+    this->directionalLightsStart = directionalStart;
+    this->texels.resize(numTexels);
+    for (std::size_t i = 0; i < pointLights.size(); i++) {
+        this->store(LightStorage::POINT_LIGHT_TEXELS * i, pointLights[i]);
+    }
+    for (std::size_t i = 0; i < spotLights.size(); i++) {
+        this->store(this->spotLightsStart + LightStorage::SPOT_LIGHT_TEXELS * i, spotLights[i]);
+    }
+    for (std::size_t i = 0; i < directionalLights.size(); i++) {
+        this->store(this->directionalLightsStart + LightStorage::DIRECTIONAL_LIGHT_TEXELS * i, directionalLights[i]);
+    }
+    return true;
+}
+
+void LightStorage::updateSpotLight(std::size_t index, const SpotLight& light) {
+    this->store(this->spotLightsStart + LightStorage::SPOT_LIGHT_TEXELS * index, light);
+}
+
+// Frames in flight may still read the buffer, so it is orphaned and filled
+// with all texels rather than updated in place
+void LightStorage::upload() {
+    if (!this->bDirty) {
+        return;
+    }
+    GLenum target = this->bShaderStorage ? GL_SHADER_STORAGE_BUFFER : GL_TEXTURE_BUFFER;
+    glBindBuffer(target, this->buffer);
+    glBufferData(target, this->texels.size() * sizeof(glm::vec4), this->texels.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(target, 0);
+    this->bDirty = false;
+}
+
+void LightStorage::bind() const {
+    if (this->bShaderStorage) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LightStorage::STORAGE_BLOCK_BINDING, this->buffer);
+    } else {
+        glActiveTexture(GL_TEXTURE0 + LightStorage::TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, this->texture);
+    }
+}
+
+void LightStorage::setupProgram(GLuint program) const {
+    if (this->bShaderStorage) {
+        GLuint blockIndex = glGetProgramResourceIndex(program, GL_SHADER_STORAGE_BLOCK, "LightStorageBlock");
+        if (blockIndex != GL_INVALID_INDEX) {
+            glShaderStorageBlockBinding(program, blockIndex, LightStorage::STORAGE_BLOCK_BINDING);
+        }
+    } else {
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "lightStorage"), LightStorage::TEXTURE_UNIT);
+    }
+}
+
+GLint LightStorage::getSpotLightsStart() const {
+    return this->spotLightsStart;
+}
+
+GLint LightStorage::getDirectionalLightsStart() const {
+    return this->directionalLightsStart;
+}
+
+std::size_t LightStorage::getMaxTexels() const {
+    return this->maxTexels;
+}
+
+bool LightStorage::isShaderStorage() const {
+    return this->bShaderStorage;
+}
+
+ShaderDefines LightStorage::getShaderDefines() const {
+    return {{"LIGHT_STORAGE_SSBO", this->bShaderStorage ? "1" : "0"}};
+}
+
+bool LightStorage::isShaderStorageSupported() {
+    return GLAD_GL_ARB_shader_storage_buffer_object and GLAD_GL_ARB_program_interface_query;
+}
@@ -66,6 +66,15 @@ void PointLight::genRadius() {
     this->radius = sampleRadius();
 }
 
+// Where the brightest channel of the inverse square falloff drops below
+// the cutoff, lighting.glsl fades the light out towards this distance
+float PointLight::getRange() const {
+    constexpr float CUTOFF_INTENSITY = 0.05f;
+    glm::vec3 intensity = glm::max(this->diffuse, this->specular);
+    float maxIntensity = glm::max(intensity.x, glm::max(intensity.y, intensity.z));
+    return this->radius * glm::sqrt(glm::max(maxIntensity, CUTOFF_INTENSITY) / CUTOFF_INTENSITY);
+}
+
 void SpotLight::genCos() {
     std::tie(this->innerAngleCos, this->outerAngleCos) = sampleCos();
 }
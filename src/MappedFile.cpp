@@ -0,0 +1,87 @@
+#include "MappedFile.hpp"
+
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define TUTORIAL_HAS_MMAP
+#endif
+
+MappedFile::MappedFile(const std::filesystem::path& filePath) {
+#ifdef TUTORIAL_HAS_MMAP
+    int fd = open(filePath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) == 0 and fileStat.st_size > 0) {
+        void* mapping = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            this->fileData = static_cast<const std::byte*>(mapping);
+            this->fileSize = fileStat.st_size;
+            this->bMapped = true;
+        }
+    }
+    ::close(fd);
+#else
+    std::ifstream is(filePath, std::ios::binary);
+    if (!is) {
+        return;
+    }
+    this->fileContents.resize(std::filesystem::file_size(filePath));
+    is.read(reinterpret_cast<char*>(this->fileContents.data()), this->fileContents.size());
+    if (is and !this->fileContents.empty()) {
+        this->fileData = this->fileContents.data();
+        this->fileSize = this->fileContents.size();
+    }
+#endif
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        this->close();
+        this->fileData = other.fileData;
+        this->fileSize = other.fileSize;
+        this->bMapped = other.bMapped;
+        this->fileContents = std::move(other.fileContents);
+        other.fileData = nullptr;
+        other.fileSize = 0;
+        other.bMapped = false;
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile() {
+    this->close();
+}
+
+bool MappedFile::isOpen() const {
+    return this->fileData != nullptr;
+}
+
+const std::byte* MappedFile::data() const {
+    return this->fileData;
+}
+
+std::size_t MappedFile::size() const {
+    return this->fileSize;
+}
+
+void MappedFile::close() {
+#ifdef TUTORIAL_HAS_MMAP
+    if (this->bMapped) {
+        munmap(const_cast<std::byte*>(this->fileData), this->fileSize);
+    }
+#endif
+    this->fileData = nullptr;
+    this->fileSize = 0;
+    this->bMapped = false;
+    this->fileContents.clear();
+}
@@ -0,0 +1,176 @@
+#include "MeshCache.hpp"
+#include "CacheUtil.hpp"
+#include "MappedFile.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+bool MeshCache::bEnabled = true;
+std::filesystem::path MeshCache::cacheRoot = "assets/cache/meshes/";
+
+namespace {
+constexpr char CACHE_MAGIC[8] = {'T', 'U', 'T', 'M', 'E', 'S', 'H', '\0'};
+
+struct FileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t numMeshes;
+    std::int64_t sourceTime;
+    std::uint64_t sourceSize;
+    std::uint64_t sourceHash;
+    std::uint64_t sourcePathLength;
+};
+
+struct MeshHeader {
+    std::uint64_t vertexDataOffset;
+    std::uint64_t numFloats;
+    std::uint64_t vertexIndicesOffset;
+    std::uint64_t numIndices;
+    std::uint64_t diffuseMapOffset;
+    std::uint64_t diffuseMapLength;
+    std::uint64_t specularMapOffset;
+    std::uint64_t specularMapLength;
+    float shininess;
+    std::uint32_t padding;
+};
+
+static_assert(sizeof(FileHeader) == 48);
+static_assert(sizeof(MeshHeader) == 72);
+}  // namespace
+
+void MeshCache::setCacheRoot(const std::filesystem::path& newCacheRoot) {
+    MeshCache::cacheRoot = newCacheRoot;
+}
+
+std::filesystem::path MeshCache::getCachePath(const std::filesystem::path& sourcePath) {
+    std::string sourceName = sourcePath.lexically_normal().generic_string();
+    std::uint64_t pathHash = CacheUtil::fnv1a(reinterpret_cast<const std::byte*>(sourceName.data()), sourceName.size());
+    char fileName[32];
+    std::snprintf(fileName, sizeof(fileName), "-%016llx.mesh", static_cast<unsigned long long>(pathHash));
+    return MeshCache::cacheRoot / (sourcePath.stem().string() + fileName);
+}
+
+std::uint64_t MeshCache::hashFile(const std::filesystem::path& filePath) {
+    MappedFile file(filePath);
+    return CacheUtil::fnv1a(file.data(), file.size());
+}
+
+bool MeshCache::load(const std::filesystem::path& sourcePath, std::vector<MeshData>& meshes) {
+    if (!MeshCache::bEnabled) {
+        return false;
+    }
+    std::error_code error;
+    std::int64_t sourceTime = std::filesystem::last_write_time(sourcePath, error).time_since_epoch().count();
+    std::uint64_t sourceSize = std::filesystem::file_size(sourcePath, error);
+    if (error) {
+        return false;
+    }
+    MappedFile cacheFile(MeshCache::getCachePath(sourcePath));
+    if (!cacheFile.isOpen() or cacheFile.size() < sizeof(FileHeader)) {
+        return false;
+    }
+
+    FileHeader fileHeader;
+    std::memcpy(&fileHeader, cacheFile.data(), sizeof(fileHeader));
+    std::string sourceName = sourcePath.lexically_normal().generic_string();
+    if (std::memcmp(fileHeader.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 or fileHeader.version != MeshCache::VERSION) {
+        return false;
+    }
+    if (fileHeader.sourcePathLength != sourceName.size() or !CacheUtil::isInside(cacheFile, sizeof(FileHeader), sourceName.size()) or
+        std::memcmp(cacheFile.data() + sizeof(FileHeader), sourceName.data(), sourceName.size()) != 0) {
+        return false;
+    }
+    bool bStale = fileHeader.sourceTime != sourceTime or fileHeader.sourceSize != sourceSize;
+    if (bStale and fileHeader.sourceHash != MeshCache::hashFile(sourcePath)) {
+        return false;
+    }
+
+    std::uint64_t meshTableOffset = sizeof(FileHeader) + fileHeader.sourcePathLength;
+    if (!CacheUtil::isInside(cacheFile, meshTableOffset, static_cast<std::uint64_t>(fileHeader.numMeshes) * sizeof(MeshHeader))) {
+        return false;
+    }
+    std::vector<MeshData> loadedMeshes(fileHeader.numMeshes);
+    for (std::uint32_t i = 0; i < fileHeader.numMeshes; i++) {
+        MeshHeader meshHeader;
+        std::memcpy(&meshHeader, cacheFile.data() + meshTableOffset + i * sizeof(MeshHeader), sizeof(meshHeader));
+        if (!CacheUtil::isInside(cacheFile, meshHeader.vertexDataOffset, meshHeader.numFloats * sizeof(GLfloat)) or
+            !CacheUtil::isInside(cacheFile, meshHeader.vertexIndicesOffset, meshHeader.numIndices * sizeof(GLuint)) or
+            !CacheUtil::isInside(cacheFile, meshHeader.diffuseMapOffset, meshHeader.diffuseMapLength) or
+            !CacheUtil::isInside(cacheFile, meshHeader.specularMapOffset, meshHeader.specularMapLength)) {
+            return false;
+        }
+        auto& mesh = loadedMeshes[i];
+        mesh.vertexData.resize(meshHeader.numFloats);
+        std::memcpy(mesh.vertexData.data(), cacheFile.data() + meshHeader.vertexDataOffset, meshHeader.numFloats * sizeof(GLfloat));
+        mesh.vertexIndices.resize(meshHeader.numIndices);
+        std::memcpy(mesh.vertexIndices.data(), cacheFile.data() + meshHeader.vertexIndicesOffset, meshHeader.numIndices * sizeof(GLuint));
+        mesh.meshMaterial.diffuseMap.assign(reinterpret_cast<const char*>(cacheFile.data() + meshHeader.diffuseMapOffset), meshHeader.diffuseMapLength);
+        mesh.meshMaterial.specularMap.assign(reinterpret_cast<const char*>(cacheFile.data() + meshHeader.specularMapOffset), meshHeader.specularMapLength);
+        mesh.meshMaterial.shininess = meshHeader.shininess;
+    }
+    meshes = std::move(loadedMeshes);
+
+    if (bStale) {
+        // Content is unchanged, record the new time and size so the source is not hashed again
+        MeshCache::store(sourcePath, meshes, fileHeader.sourceHash);
+    }
+    return true;
+}
+
+bool MeshCache::store(const std::filesystem::path& sourcePath, const std::vector<MeshData>& meshes, std::optional<std::uint64_t> sourceHash) {
+    if (!MeshCache::bEnabled) {
+        return false;
+    }
+    std::error_code error;
+    std::string sourceName = sourcePath.lexically_normal().generic_string();
+
+    FileHeader fileHeader;
+    std::memcpy(fileHeader.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    fileHeader.version = MeshCache::VERSION;
+    fileHeader.numMeshes = meshes.size();
+    fileHeader.sourceTime = std::filesystem::last_write_time(sourcePath, error).time_since_epoch().count();
+    fileHeader.sourceSize = std::filesystem::file_size(sourcePath, error);
+    if (error) {
+        return false;
+    }
+    fileHeader.sourceHash = sourceHash ? *sourceHash : MeshCache::hashFile(sourcePath);
+    fileHeader.sourcePathLength = sourceName.size();
+
+    std::vector<MeshHeader> meshHeaders(meshes.size());
+    std::uint64_t offset = sizeof(FileHeader) + sourceName.size() + meshHeaders.size() * sizeof(MeshHeader);
+    auto allocate = [&offset](std::uint64_t size) {
+        offset = (offset + 3) & ~std::uint64_t(3);
+        std::uint64_t allocation = offset;
+        offset += size;
+        return allocation;
+    };
+    for (std::size_t i = 0; i < meshes.size(); i++) {
+        const auto& mesh = meshes[i];
+        auto& meshHeader = meshHeaders[i];
+        meshHeader.numFloats = mesh.vertexData.size();
+        meshHeader.vertexDataOffset = allocate(mesh.vertexData.size() * sizeof(GLfloat));
+        meshHeader.numIndices = mesh.vertexIndices.size();
+        meshHeader.vertexIndicesOffset = allocate(mesh.vertexIndices.size() * sizeof(GLuint));
+        meshHeader.diffuseMapLength = mesh.meshMaterial.diffuseMap.size();
+        meshHeader.diffuseMapOffset = allocate(mesh.meshMaterial.diffuseMap.size());
+        meshHeader.specularMapLength = mesh.meshMaterial.specularMap.size();
+        meshHeader.specularMapOffset = allocate(mesh.meshMaterial.specularMap.size());
+        meshHeader.shininess = mesh.meshMaterial.shininess;
+        meshHeader.padding = 0;
+    }
+
+    std::vector<std::byte> fileContents(offset);
+    std::memcpy(fileContents.data(), &fileHeader, sizeof(fileHeader));
+    std::memcpy(fileContents.data() + sizeof(FileHeader), sourceName.data(), sourceName.size());
+    std::memcpy(fileContents.data() + sizeof(FileHeader) + sourceName.size(), meshHeaders.data(), meshHeaders.size() * sizeof(MeshHeader));
+    for (std::size_t i = 0; i < meshes.size(); i++) {
+        const auto& mesh = meshes[i];
+        const auto& meshHeader = meshHeaders[i];
+        std::memcpy(fileContents.data() + meshHeader.vertexDataOffset, mesh.vertexData.data(), mesh.vertexData.size() * sizeof(GLfloat));
+        std::memcpy(fileContents.data() + meshHeader.vertexIndicesOffset, mesh.vertexIndices.data(), mesh.vertexIndices.size() * sizeof(GLuint));
+        std::memcpy(fileContents.data() + meshHeader.diffuseMapOffset, mesh.meshMaterial.diffuseMap.data(), mesh.meshMaterial.diffuseMap.size());
+        std::memcpy(fileContents.data() + meshHeader.specularMapOffset, mesh.meshMaterial.specularMap.data(), mesh.meshMaterial.specularMap.size());
+    }
+
+    return CacheUtil::writeFile(MeshCache::getCachePath(sourcePath), fileContents);
+}
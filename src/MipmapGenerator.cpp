@@ -0,0 +1,228 @@
+#include "MipmapGenerator.hpp"
+#include "CPUProfiler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#define TUTORIAL_HAS_SSE2
+#if defined(__GNUC__) || defined(__clang__)
+#define TUTORIAL_TARGET_AVX2 __attribute__((target("avx2")))
+#define TUTORIAL_HAS_AVX2
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#define TUTORIAL_TARGET_AVX2
+#define TUTORIAL_HAS_AVX2
+#endif
+#endif
+
+namespace {
+constexpr int ENCODE_TABLE_SIZE = 4096;
+
+struct SRGBTables {
+    std::array<float, 256> decode;
+    std::array<std::uint8_t, ENCODE_TABLE_SIZE> encode;
+
+    SRGBTables() {
+        for (int i = 0; i < 256; i++) {
+            float value = i / 255.0f;
+            this->decode[i] = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+        }
+        for (int i = 0; i < ENCODE_TABLE_SIZE; i++) {
+            float value = i / static_cast<float>(ENCODE_TABLE_SIZE - 1);
+            float encoded = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+            this->encode[i] = static_cast<std::uint8_t>(std::lround(std::clamp(encoded, 0.0f, 1.0f) * 255.0f));
+        }
+    }
+};
+
+const SRGBTables& getSRGBTables() {
+    static const SRGBTables tables;
+    return tables;
+}
+
+std::uint8_t encodeUnorm(float value) {
+    return static_cast<std::uint8_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+}
+
+std::uint8_t encodeColor(float value, bool bSRGB) {
+    if (!bSRGB) {
+        return encodeUnorm(value);
+    }
+    int index = static_cast<int>(std::clamp(value, 0.0f, 1.0f) * (ENCODE_TABLE_SIZE - 1) + 0.5f);
+    return getSRGBTables().encode[index];
+}
+
+std::vector<float> decodeImage(const std::vector<std::byte>& image, bool bSRGB) {
+    const auto& srgbTables = getSRGBTables();
+    auto texels = reinterpret_cast<const std::uint8_t*>(image.data());
+    std::vector<float> decodedImage(image.size());
+    for (std::size_t i = 0; i < decodedImage.size(); i += 4) {
+        for (int c = 0; c < 3; c++) {
+            decodedImage[i + c] = bSRGB ? srgbTables.decode[texels[i + c]] : texels[i + c] / 255.0f;
+        }
+        decodedImage[i + 3] = texels[i + 3] / 255.0f;
+    }
+    return decodedImage;
+}
+
+// Rows hold RGBA texels as 4 floats. Only rows that are a single texel wide
+// read a clamped column, the vector kernels leave those and their tails here.
+void downsampleRowScalar(const float* row0, const float* row1, int width, int nextWidth, float* nextRow, int firstTexel) {
+    for (int x = firstTexel; x < nextWidth; x++) {
+        int x0 = std::min(2 * x, width - 1);
+        int x1 = std::min(2 * x + 1, width - 1);
+        for (int c = 0; c < 4; c++) {
+            nextRow[x * 4 + c] = 0.25f * (row0[x0 * 4 + c] + row0[x1 * 4 + c] + row1[x0 * 4 + c] + row1[x1 * 4 + c]);
+        }
+    }
+}
+
+#ifndef TUTORIAL_HAS_SSE2
+void downsampleScalar(const float* row0, const float* row1, int width, int nextWidth, float* nextRow) {
+    downsampleRowScalar(row0, row1, width, nextWidth, nextRow, 0);
+}
+#endif
+
+#ifdef TUTORIAL_HAS_SSE2
+// One texel fits a register, each output texel is the sum of four loads
+void downsampleSSE2(const float* row0, const float* row1, int width, int nextWidth, float* nextRow) {
+    const __m128 quarter = _mm_set1_ps(0.25f);
+    int numFullTexels = std::min(nextWidth, width / 2);
+    for (int x = 0; x < numFullTexels; x++) {
+        __m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(row0 + 8 * x), _mm_loadu_ps(row0 + 8 * x + 4)),
+                                _mm_add_ps(_mm_loadu_ps(row1 + 8 * x), _mm_loadu_ps(row1 + 8 * x + 4)));
+        _mm_storeu_ps(nextRow + 4 * x, _mm_mul_ps(sum, quarter));
+    }
+    downsampleRowScalar(row0, row1, width, nextWidth, nextRow, numFullTexels);
+}
+#endif
+
+#ifdef TUTORIAL_HAS_AVX2
+// Two output texels per iteration. After adding both rows a register holds
+// the sums of texels (2x, 2x + 1) and the next one of (2x + 2, 2x + 3), the
+// lane permutes regroup them so one add yields both output texels.
+TUTORIAL_TARGET_AVX2 void downsampleAVX2(const float* row0, const float* row1, int width, int nextWidth, float* nextRow) {
+    const __m256 quarter = _mm256_set1_ps(0.25f);
+    int numFullTexels = std::min(nextWidth, width / 2);
+    int x = 0;
+    for (; x + 2 <= numFullTexels; x += 2) {
+        __m256 texels01 = _mm256_add_ps(_mm256_loadu_ps(row0 + 8 * x), _mm256_loadu_ps(row1 + 8 * x));
+        __m256 texels23 = _mm256_add_ps(_mm256_loadu_ps(row0 + 8 * x + 8), _mm256_loadu_ps(row1 + 8 * x + 8));
+        __m256 evenTexels = _mm256_permute2f128_ps(texels01, texels23, 0x20);
+        __m256 oddTexels = _mm256_permute2f128_ps(texels01, texels23, 0x31);
+        _mm256_storeu_ps(nextRow + 4 * x, _mm256_mul_ps(_mm256_add_ps(evenTexels, oddTexels), quarter));
+    }
+    downsampleRowScalar(row0, row1, width, nextWidth, nextRow, x);
+}
+
+bool isAVX2Supported() {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_cpu_supports("avx2");
+#else
+    int cpuInfo[4];
+    __cpuid(cpuInfo, 1);
+    bool bOSXSave = (cpuInfo[2] & (1 << 27)) != 0;
+    bool bAVX = (cpuInfo[2] & (1 << 28)) != 0;
+    if (!bOSXSave or !bAVX or (_xgetbv(0) & 0x6) != 0x6) {
+        return false;
+    }
+    __cpuidex(cpuInfo, 7, 0);
+    return (cpuInfo[1] & (1 << 5)) != 0;
+#endif
+}
+#endif
+}  // namespace
+
+int MipmapGenerator::getNumLevels(int width, int height) {
+    int numLevels = 1;
+    for (int size = std::max(width, height); size > 1; size /= 2) {
+        numLevels++;
+    }
+    return numLevels;
+}
+
+MipmapGenerator::DownsampleKernel MipmapGenerator::selectKernel() {
+#ifdef TUTORIAL_HAS_AVX2
+    if (isAVX2Supported()) {
+        return downsampleAVX2;
+    }
+#endif
+#ifdef TUTORIAL_HAS_SSE2
+    return downsampleSSE2;
+#else
+    return downsampleScalar;
+#endif
+}
+
+float MipmapGenerator::getCoverage(const std::vector<float>& level, float alphaScale) {
+    std::size_t numTexels = level.size() / 4, numCovered = 0;
+    for (std::size_t i = 0; i < numTexels; i++) {
+        numCovered += level[i * 4 + 3] * alphaScale > MipmapGenerator::ALPHA_REFERENCE;
+    }
+    return static_cast<float>(numCovered) / numTexels;
+}
+
+// Coverage grows with the scale, so the scale is found by bisection
+float MipmapGenerator::findAlphaScale(const std::vector<float>& level, float targetCoverage) {
+    float minScale = 0.0f, maxScale = 4.0f, alphaScale = 1.0f;
+    for (int i = 0; i < 10; i++) {
+        float coverage = MipmapGenerator::getCoverage(level, alphaScale);
+        if (coverage < targetCoverage) {
+            minScale = alphaScale;
+        } else if (coverage > targetCoverage) {
+            maxScale = alphaScale;
+        } else {
+            break;
+        }
+        alphaScale = 0.5f * (minScale + maxScale);
+    }
+    return alphaScale;
+}
+
+std::vector<std::vector<std::byte>> MipmapGenerator::generate(const std::vector<std::byte>& image, int width, int height, bool bSRGB) {
+    ScopedCPUZone cpuZone("MipmapGenerator::generate");
+    static const DownsampleKernel downsampleKernel = MipmapGenerator::selectKernel();
+    int numLevels = MipmapGenerator::getNumLevels(width, height);
+    std::vector<std::vector<std::byte>> levels;
+    levels.reserve(numLevels);
+    levels.push_back(image);
+
+    std::vector<float> level = decodeImage(image, bSRGB);
+    bool bOpaque = true;
+    for (std::size_t i = 3; i < level.size(); i += 4) {
+        bOpaque = bOpaque and level[i] == 1.0f;
+    }
+    float targetCoverage = bOpaque ? 1.0f : MipmapGenerator::getCoverage(level, 1.0f);
+
+    std::vector<float> nextLevel;
+    int levelWidth = width, levelHeight = height;
+    for (int i = 1; i < numLevels; i++) {
+        int nextWidth = std::max(levelWidth / 2, 1), nextHeight = std::max(levelHeight / 2, 1);
+        nextLevel.resize(static_cast<std::size_t>(nextWidth) * nextHeight * 4);
+        for (int y = 0; y < nextHeight; y++) {
+            const float* row0 = level.data() + static_cast<std::size_t>(std::min(2 * y, levelHeight - 1)) * levelWidth * 4;
+            const float* row1 = level.data() + static_cast<std::size_t>(std::min(2 * y + 1, levelHeight - 1)) * levelWidth * 4;
+            downsampleKernel(row0, row1, levelWidth, nextWidth, nextLevel.data() + static_cast<std::size_t>(y) * nextWidth * 4);
+        }
+        level.swap(nextLevel);
+        levelWidth = nextWidth;
+        levelHeight = nextHeight;
+
+        // The scale only applies to the stored level, the next one is filtered from unscaled alpha
+        float alphaScale = bOpaque ? 1.0f : MipmapGenerator::findAlphaScale(level, targetCoverage);
+        std::vector<std::byte> encodedLevel(level.size());
+        auto encodedTexels = reinterpret_cast<std::uint8_t*>(encodedLevel.data());
+        for (std::size_t j = 0; j < level.size(); j += 4) {
+            for (int c = 0; c < 3; c++) {
+                encodedTexels[j + c] = encodeColor(level[j + c], bSRGB);
+            }
+            encodedTexels[j + 3] = encodeUnorm(level[j + 3] * alphaScale);
+        }
+        levels.push_back(std::move(encodedLevel));
+    }
+    return levels;
+}
@@ -0,0 +1,89 @@
+#include "ModelLoader.hpp"
+#include "CPUProfiler.hpp"
+#include "MeshCache.hpp"
+#include "ThreadPool.hpp"
+
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#include <assimp/Importer.hpp>
+
+#include <algorithm>
+
+std::vector<MeshData> ModelLoader::loadModelData(const std::filesystem::path& modelPath) {
+    ScopedCPUZone cpuZone("loadModelData");
+    if (!std::filesystem::exists(modelPath)) {
+        return {};
+    }
+    std::vector<MeshData> meshes;
+    if (MeshCache::load(modelPath, meshes)) {
+        return meshes;
+    }
+    meshes = ModelLoader::importModelData(modelPath);
+    if (!meshes.empty()) {
+        MeshCache::store(modelPath, meshes);
+    }
+    return meshes;
+}
+
+std::vector<std::vector<MeshData>> ModelLoader::loadModels(const std::vector<std::filesystem::path>& modelPaths) {
+    std::vector<std::vector<MeshData>> models(modelPaths.size());
+    ThreadPool::parallelFor(modelPaths.size(), [&](std::size_t i) {
+        models[i] = ModelLoader::loadModelData(modelPaths[i]);
+    });
+    return models;
+}
+
+std::vector<MeshData> ModelLoader::importModelData(const std::filesystem::path& modelPath) {
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(modelPath.string().c_str(), aiProcess_JoinIdenticalVertices | aiProcess_Triangulate);
+    if (!scene) {
+        return {};
+    }
+    std::vector<MeshData> meshes(scene->mNumMeshes);
+    ThreadPool::parallelFor(scene->mNumMeshes, [&](std::size_t i) {
+        ModelLoader::convertMesh(scene, scene->mMeshes[i], meshes[i]);
+    });
+    return meshes;
+}
+
+// Buffers are sized up front and filled through raw pointers, the vertex
+// layout is position, normal and texture coordinates with 8 floats each
+void ModelLoader::convertMesh(const aiScene* scene, const aiMesh* mesh, MeshData& meshData) {
+    ScopedCPUZone cpuZone("convertMesh");
+    constexpr std::size_t VERTEX_SIZE = 8;
+    meshData.vertexData.resize(mesh->mNumVertices * VERTEX_SIZE);
+    GLfloat* vertex = meshData.vertexData.data();
+    bool bHasNormals = mesh->HasNormals();
+    bool bHasTextureCoords = mesh->HasTextureCoords(0);
+    for (std::size_t j = 0; j < mesh->mNumVertices; j++, vertex += VERTEX_SIZE) {
+        vertex[0] = mesh->mVertices[j].x;
+        vertex[1] = mesh->mVertices[j].y;
+        vertex[2] = mesh->mVertices[j].z;
+        vertex[3] = bHasNormals ? mesh->mNormals[j].x : 0.0f;
+        vertex[4] = bHasNormals ? mesh->mNormals[j].y : 0.0f;
+        vertex[5] = bHasNormals ? mesh->mNormals[j].z : 0.0f;
+        vertex[6] = bHasTextureCoords ? mesh->mTextureCoords[0][j].x : 0.0f;
+        vertex[7] = bHasTextureCoords ? mesh->mTextureCoords[0][j].y : 0.0f;
+    }
+
+    // Triangulation leaves points and lines alone, so faces are not all the same size
+    std::size_t numIndices = 0;
+    for (std::size_t j = 0; j < mesh->mNumFaces; j++) {
+        numIndices += mesh->mFaces[j].mNumIndices;
+    }
+    meshData.vertexIndices.resize(numIndices);
+    GLuint* index = meshData.vertexIndices.data();
+    for (std::size_t j = 0; j < mesh->mNumFaces; j++) {
+        const auto& face = mesh->mFaces[j];
+        index = std::copy(face.mIndices, face.mIndices + face.mNumIndices, index);
+    }
+
+    auto meshMaterial = scene->mMaterials[mesh->mMaterialIndex];
+    aiString diffuseTexture;
+    aiString specularTexture;
+    meshMaterial->GetTexture(aiTextureType_DIFFUSE, 0, &diffuseTexture);
+    meshMaterial->GetTexture(aiTextureType_SPECULAR, 0, &specularTexture);
+    meshData.meshMaterial.diffuseMap = diffuseTexture.C_Str();
+    meshData.meshMaterial.specularMap = specularTexture.C_Str();
+    meshData.meshMaterial.shininess = 128.0f;
+}
@@ -0,0 +1,287 @@
+#include "ProgramCache.hpp"
+#include "CacheUtil.hpp"
+#include "CPUProfiler.hpp"
+#include "MappedFile.hpp"
+#include "ShaderPreprocessor.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+bool ProgramCache::bEnabled = true;
+bool ProgramCache::bParallelCompile = true;
+std::filesystem::path ProgramCache::cacheRoot = "assets/cache/programs/";
+std::string ProgramCache::driverName;
+std::unordered_map<std::uint64_t, GLuint> ProgramCache::compiledShaders;
+std::vector<ProgramCache::PendingProgram> ProgramCache::pendingPrograms;
+
+namespace {
+constexpr char CACHE_MAGIC[8] = {'T', 'U', 'T', 'P', 'R', 'O', 'G', '\0'};
+
+struct FileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t binaryFormat;
+    std::uint64_t programKey;
+    std::uint64_t binarySize;
+};
+
+static_assert(sizeof(FileHeader) == 32);
+
+std::uint64_t hashString(const std::string& string, std::uint64_t hash) {
+    // The terminator keeps consecutive strings from running into each other
+    return CacheUtil::fnv1a(reinterpret_cast<const std::byte*>(string.c_str()), string.size() + 1, hash);
+}
+
+std::uint64_t hashShader(const ShaderSource& shader, std::uint64_t hash) {
+    hash = CacheUtil::fnv1a(reinterpret_cast<const std::byte*>(&shader.type), sizeof(shader.type), hash);
+    if (shader.sourceHash) {
+        return CacheUtil::fnv1a(reinterpret_cast<const std::byte*>(&shader.sourceHash), sizeof(shader.sourceHash), hash);
+    }
+    return hashString(shader.source, hash);
+}
+
+// Compiler messages start with the source string number, "0:12(3)" or
+// "0(12)" depending on the driver, which is replaced with the file name
+void printCompileLog(const std::string& infoLog) {
+    std::size_t lineStart = 0;
+    while (lineStart < infoLog.size()) {
+        auto lineEnd = std::min(infoLog.find('\n', lineStart), infoLog.size());
+        auto line = infoLog.substr(lineStart, lineEnd - lineStart);
+        std::size_t numberLength = 0;
+        while (numberLength < line.size() and std::isdigit(static_cast<unsigned char>(line[numberLength]))) {
+            numberLength++;
+        }
+        auto fileName = numberLength > 0 ? ShaderPreprocessor::getFileName(std::stoi(line.substr(0, numberLength))) : "";
+        if (!fileName.empty() and numberLength < line.size() and (line[numberLength] == ':' or line[numberLength] == '(')) {
+            line.replace(0, numberLength, fileName);
+        }
+        std::fprintf(stderr, "%s\n", line.c_str());
+        lineStart = lineEnd + 1;
+    }
+}
+
+void printShaderLog(GLuint shaderId) {
+    GLint bCompiled = GL_FALSE;
+    glGetShaderiv(shaderId, GL_COMPILE_STATUS, &bCompiled);
+    if (bCompiled) {
+        return;
+    }
+    GLint logLength = 0;
+    glGetShaderiv(shaderId, GL_INFO_LOG_LENGTH, &logLength);
+    std::string infoLog(std::max(logLength, 1), '\0');
+    glGetShaderInfoLog(shaderId, logLength, nullptr, infoLog.data());
+    infoLog.resize(std::strlen(infoLog.c_str()));
+    printCompileLog(infoLog);
+}
+}  // namespace
+
+// Some drivers expose the extension without supporting a single binary format
+bool ProgramCache::isSupported() {
+    if (!ProgramCache::bEnabled or !GLAD_GL_ARB_get_program_binary) {
+        return false;
+    }
+    GLint numFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+    return numFormats > 0;
+}
+
+bool ProgramCache::isParallelSupported() {
+    return ProgramCache::bParallelCompile and GLAD_GL_KHR_parallel_shader_compile;
+}
+
+void ProgramCache::setCacheRoot(const std::filesystem::path& newCacheRoot) {
+    ProgramCache::cacheRoot = newCacheRoot;
+}
+
+std::uint64_t ProgramCache::getProgramKey(const std::vector<ShaderSource>& shaders) {
+    if (ProgramCache::driverName.empty()) {
+        for (GLenum name: {GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION}) {
+            auto value = reinterpret_cast<const char*>(glGetString(name));
+            ProgramCache::driverName += value ? value : "";
+            ProgramCache::driverName += '\n';
+        }
+    }
+    std::uint64_t programKey = hashString(ProgramCache::driverName, CacheUtil::FNV_OFFSET_BASIS);
+    for (const auto& shader: shaders) {
+        programKey = hashShader(shader, programKey);
+    }
+    return programKey;
+}
+
+std::filesystem::path ProgramCache::getCachePath(std::uint64_t programKey) {
+    char fileName[32];
+    std::snprintf(fileName, sizeof(fileName), "%016llx.bin", static_cast<unsigned long long>(programKey));
+    return ProgramCache::cacheRoot / fileName;
+}
+
+GLuint ProgramCache::createProgram(const std::vector<ShaderSource>& shaders) {
+    ScopedCPUZone cpuZone("ProgramCache::createProgram");
+    GLuint program = glCreateProgram();
+    bool bSupported = ProgramCache::isSupported();
+    std::uint64_t programKey = bSupported ? ProgramCache::getProgramKey(shaders) : 0;
+    if (bSupported and ProgramCache::loadProgram(program, programKey)) {
+        return program;
+    }
+
+    if (ProgramCache::isParallelSupported() and ProgramCache::pendingPrograms.empty()) {
+        // Let the driver pick the number of compiler threads
+        glMaxShaderCompilerThreadsKHR(0xffffffff);
+    }
+    PendingProgram pendingProgram = {program, programKey, {}};
+    for (const auto& shader: shaders) {
+        pendingProgram.shaderIds.push_back(ProgramCache::getShader(shader));
+    }
+    ScopedCPUZone linkZone("Link program");
+    for (auto shaderId: pendingProgram.shaderIds) {
+        glAttachShader(program, shaderId);
+    }
+    if (bSupported) {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glLinkProgram(program);
+    if (ProgramCache::isParallelSupported()) {
+        ProgramCache::pendingPrograms.push_back(std::move(pendingProgram));
+    } else {
+        ProgramCache::finishProgram(pendingProgram);
+    }
+    return program;
+}
+
+void ProgramCache::update() {
+    if (ProgramCache::pendingPrograms.empty()) {
+        return;
+    }
+    ScopedCPUZone cpuZone("ProgramCache::update");
+    auto it = std::remove_if(ProgramCache::pendingPrograms.begin(), ProgramCache::pendingPrograms.end(), [](const PendingProgram& pendingProgram) {
+        GLint bComplete = GL_FALSE;
+        glGetProgramiv(pendingProgram.program, GL_COMPLETION_STATUS_KHR, &bComplete);
+        if (bComplete) {
+            ProgramCache::finishProgram(pendingProgram);
+        }
+        return bComplete;
+    });
+    ProgramCache::pendingPrograms.erase(it, ProgramCache::pendingPrograms.end());
+}
+
+void ProgramCache::finishPrograms() {
+    ScopedCPUZone cpuZone("ProgramCache::finishPrograms");
+    for (const auto& pendingProgram: ProgramCache::pendingPrograms) {
+        ProgramCache::finishProgram(pendingProgram);
+    }
+    ProgramCache::pendingPrograms.clear();
+}
+
+void ProgramCache::finishProgram(GLuint program) {
+    auto it = std::find_if(ProgramCache::pendingPrograms.begin(), ProgramCache::pendingPrograms.end(), [program](const PendingProgram& p) {
+        return p.program == program;
+    });
+    if (it != ProgramCache::pendingPrograms.end()) {
+        ProgramCache::finishProgram(*it);
+        ProgramCache::pendingPrograms.erase(it);
+    }
+}
+
+bool ProgramCache::isPending(GLuint program) {
+    return std::any_of(ProgramCache::pendingPrograms.begin(), ProgramCache::pendingPrograms.end(), [program](const PendingProgram& p) {
+        return p.program == program;
+    });
+}
+
+// Querying the link status waits for the driver if it is still busy
+void ProgramCache::finishProgram(const PendingProgram& pendingProgram) {
+    GLint bLinked = GL_FALSE;
+    glGetProgramiv(pendingProgram.program, GL_LINK_STATUS, &bLinked);
+    for (auto shaderId: pendingProgram.shaderIds) {
+        glDetachShader(pendingProgram.program, shaderId);
+    }
+    if (!bLinked) {
+        for (auto shaderId: pendingProgram.shaderIds) {
+            printShaderLog(shaderId);
+        }
+        GLint logLength = 0;
+        glGetProgramiv(pendingProgram.program, GL_INFO_LOG_LENGTH, &logLength);
+        std::string infoLog(std::max(logLength, 1), '\0');
+        glGetProgramInfoLog(pendingProgram.program, logLength, nullptr, infoLog.data());
+        std::fprintf(stderr, "Failed to link program: %s\n", infoLog.c_str());
+        return;
+    }
+    if (pendingProgram.programKey) {
+        ProgramCache::storeProgram(pendingProgram.program, pendingProgram.programKey);
+    }
+}
+
+GLuint ProgramCache::getShader(const ShaderSource& shader) {
+    std::uint64_t shaderKey = hashShader(shader, CacheUtil::FNV_OFFSET_BASIS);
+    auto it = ProgramCache::compiledShaders.find(shaderKey);
+    if (it != ProgramCache::compiledShaders.end()) {
+        return it->second;
+    }
+    ScopedCPUZone cpuZone("Compile shader");
+    const char* shaderSourceCStr = shader.source.c_str();
+    GLuint shaderId = glCreateShader(shader.type);
+    glShaderSource(shaderId, 1, &shaderSourceCStr, nullptr);
+    glCompileShader(shaderId);
+    ProgramCache::compiledShaders.emplace(shaderKey, shaderId);
+    return shaderId;
+}
+
+void ProgramCache::releaseShaders() {
+    auto it = ProgramCache::compiledShaders.begin();
+    while (it != ProgramCache::compiledShaders.end()) {
+        GLuint shaderId = it->second;
+        bool bAttached = std::any_of(ProgramCache::pendingPrograms.begin(), ProgramCache::pendingPrograms.end(), [shaderId](const PendingProgram& p) {
+            return std::find(p.shaderIds.begin(), p.shaderIds.end(), shaderId) != p.shaderIds.end();
+        });
+        if (bAttached) {
+            ++it;
+        } else {
+            glDeleteShader(shaderId);
+            it = ProgramCache::compiledShaders.erase(it);
+        }
+    }
+}
+
+bool ProgramCache::loadProgram(GLuint program, std::uint64_t programKey) {
+    MappedFile cacheFile(ProgramCache::getCachePath(programKey));
+    if (!cacheFile.isOpen() or cacheFile.size() < sizeof(FileHeader)) {
+        return false;
+    }
+    FileHeader fileHeader;
+    std::memcpy(&fileHeader, cacheFile.data(), sizeof(fileHeader));
+    if (std::memcmp(fileHeader.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 or fileHeader.version != ProgramCache::VERSION or
+        fileHeader.programKey != programKey or fileHeader.binarySize != cacheFile.size() - sizeof(FileHeader)) {
+        return false;
+    }
+    glProgramBinary(program, fileHeader.binaryFormat, cacheFile.data() + sizeof(FileHeader), fileHeader.binarySize);
+    GLint bLinked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &bLinked);
+    return bLinked;
+}
+
+bool ProgramCache::storeProgram(GLuint program, std::uint64_t programKey) {
+    GLint bLinked = GL_FALSE, binarySize = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &bLinked);
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binarySize);
+    if (!bLinked or binarySize <= 0) {
+        return false;
+    }
+    std::vector<std::byte> fileContents(sizeof(FileHeader) + binarySize);
+    GLenum binaryFormat = 0;
+    GLsizei writtenSize = 0;
+    glGetProgramBinary(program, binarySize, &writtenSize, &binaryFormat, fileContents.data() + sizeof(FileHeader));
+    if (writtenSize != binarySize) {
+        return false;
+    }
+
+    FileHeader fileHeader;
+    std::memcpy(fileHeader.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    fileHeader.version = ProgramCache::VERSION;
+    fileHeader.binaryFormat = binaryFormat;
+    fileHeader.programKey = programKey;
+    fileHeader.binarySize = binarySize;
+    std::memcpy(fileContents.data(), &fileHeader, sizeof(fileHeader));
+
+    return CacheUtil::writeFile(ProgramCache::getCachePath(programKey), fileContents);
+}
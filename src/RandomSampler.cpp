@@ -17,6 +17,10 @@ float RandomSampler::randomFloat(float a, float b) {
 
 void RandomSampler::seed() {
     std::random_device rd;
-    RandomSampler::randomEngine.seed(rd());
+    RandomSampler::seed(rd());
+}
+
+void RandomSampler::seed(std::mt19937::result_type seedValue) {
+    RandomSampler::randomEngine.seed(seedValue);
     bSeeded = true;
 }
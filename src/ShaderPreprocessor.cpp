@@ -0,0 +1,221 @@
+#include "ShaderPreprocessor.hpp"
+#include "CacheUtil.hpp"
+#include "CPUProfiler.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iterator>
+
+std::unordered_map<std::string, ShaderPreprocessor::SourceFile> ShaderPreprocessor::fileCache;
+std::vector<std::string> ShaderPreprocessor::fileNames;
+
+namespace {
+bool isBlank(char c) {
+    return c == ' ' or c == '\t';
+}
+
+std::string_view trim(std::string_view text) {
+    while (!text.empty() and isBlank(text.front())) {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() and isBlank(text.back())) {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+// Splits off the next line without its line break, carriage returns included
+std::string_view nextLine(std::string_view& text) {
+    auto end = text.find('\n');
+    auto line = text.substr(0, end);
+    text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+    if (!line.empty() and line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+    return line;
+}
+
+// Returns the directive name, or nothing if the line is no directive
+std::string_view parseDirective(std::string_view line, std::string_view& argument) {
+    line = trim(line);
+    if (line.empty() or line.front() != '#') {
+        return {};
+    }
+    line = trim(line.substr(1));
+    std::size_t nameLength = 0;
+    while (nameLength < line.size() and (std::isalnum(static_cast<unsigned char>(line[nameLength])) or line[nameLength] == '_')) {
+        nameLength++;
+    }
+    argument = trim(line.substr(nameLength));
+    return line.substr(0, nameLength);
+}
+
+// Returns whether a block comment is still open at the end of the line
+bool isInComment(std::string_view line, bool bInComment) {
+    for (std::size_t i = 0; i + 1 < line.size(); i++) {
+        if (bInComment and line[i] == '*' and line[i + 1] == '/') {
+            bInComment = false;
+            i++;
+        } else if (!bInComment and line[i] == '/' and line[i + 1] == '/') {
+            break;
+        } else if (!bInComment and line[i] == '/' and line[i + 1] == '*') {
+            bInComment = true;
+            i++;
+        }
+    }
+    return bInComment;
+}
+
+bool isCommentOrBlank(std::string_view line) {
+    line = trim(line);
+    return line.empty() or line.substr(0, 2) == "//";
+}
+}  // namespace
+
+PreprocessedShader ShaderPreprocessor::load(const std::filesystem::path& filePath, const ShaderDefines& defines) {
+    ScopedCPUZone cpuZone("ShaderPreprocessor::load");
+    PreprocessedShader shader;
+    shader.bValid = ShaderPreprocessor::expandFile(filePath.lexically_normal().generic_string(), defines, 0, shader.files, shader.source);
+    shader.sourceHash = CacheUtil::fnv1a(reinterpret_cast<const std::byte*>(shader.source.data()), shader.source.size());
+    return shader;
+}
+
+std::string ShaderPreprocessor::getFileName(int sourceStringNumber) {
+    if (sourceStringNumber < 0 or sourceStringNumber >= static_cast<int>(ShaderPreprocessor::fileNames.size())) {
+        return "";
+    }
+    return ShaderPreprocessor::fileNames[sourceStringNumber];
+}
+
+// Source string numbers outlive the cache, a reloaded file keeps its number
+void ShaderPreprocessor::clearCache() {
+    ShaderPreprocessor::fileCache.clear();
+}
+
+void ShaderPreprocessor::invalidateFile(const std::string& fileName) {
+    ShaderPreprocessor::fileCache.erase(fileName);
+}
+
+const ShaderPreprocessor::SourceFile* ShaderPreprocessor::getFile(const std::string& fileName) {
+    auto it = ShaderPreprocessor::fileCache.find(fileName);
+    if (it != ShaderPreprocessor::fileCache.end()) {
+        return &it->second;
+    }
+    std::ifstream is(fileName, std::ios::binary);
+    if (!is) {
+        return nullptr;
+    }
+    SourceFile file;
+    file.contents.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+    auto nameIt = std::find(ShaderPreprocessor::fileNames.begin(), ShaderPreprocessor::fileNames.end(), fileName);
+    file.sourceStringNumber = nameIt - ShaderPreprocessor::fileNames.begin();
+    if (nameIt == ShaderPreprocessor::fileNames.end()) {
+        ShaderPreprocessor::fileNames.push_back(fileName);
+    }
+    file.bGuarded = ShaderPreprocessor::isGuarded(file.contents);
+    return &ShaderPreprocessor::fileCache.emplace(fileName, std::move(file)).first->second;
+}
+
+// Guarded means #pragma once, or an #ifndef and #define of the same macro as
+// the first lines and their matching #endif as the last one, comments aside
+bool ShaderPreprocessor::isGuarded(std::string_view contents) {
+    std::string guardName;
+    int depth = 0;
+    bool bInComment = false, bGuardClosed = false;
+    int lineIndex = 0;
+    while (!contents.empty()) {
+        auto line = nextLine(contents);
+        bool bWasInComment = bInComment;
+        bInComment = isInComment(line, bInComment);
+        if (bWasInComment or isCommentOrBlank(line)) {
+            continue;
+        }
+        std::string_view argument;
+        auto directive = parseDirective(line, argument);
+        if (directive == "pragma" and argument == "once") {
+            return true;
+        }
+        if (bGuardClosed) {
+            return false;
+        }
+        if (lineIndex == 0) {
+            if (directive != "ifndef") {
+                return false;
+            }
+            guardName = argument;
+        } else if (lineIndex == 1 and (directive != "define" or argument != guardName)) {
+            return false;
+        }
+        if (directive == "if" or directive == "ifdef" or directive == "ifndef") {
+            depth++;
+        } else if (directive == "endif") {
+            bGuardClosed = --depth == 0;
+        }
+        lineIndex++;
+    }
+    return bGuardClosed;
+}
+
+bool ShaderPreprocessor::expandFile(const std::string& fileName, const ShaderDefines& defines, int depth, std::vector<std::string>& expandedFiles, std::string& output) {
+    const SourceFile* file = ShaderPreprocessor::getFile(fileName);
+    if (!file or depth > ShaderPreprocessor::MAX_INCLUDE_DEPTH) {
+        // Still listed, so creating a missing file can fix the shader
+        expandedFiles.push_back(fileName);
+        return false;
+    }
+    if (file->bGuarded and std::find(expandedFiles.begin(), expandedFiles.end(), fileName) != expandedFiles.end()) {
+        return true;
+    }
+    expandedFiles.push_back(fileName);
+
+    auto appendLineDirective = [&output, file](int lineNumber) {
+        output += "#line " + std::to_string(lineNumber) + ' ' + std::to_string(file->sourceStringNumber) + '\n';
+    };
+    auto appendDefines = [&output, &defines]() {
+        for (const auto& [name, value]: defines) {
+            output += "#define " + name + ' ' + value + '\n';
+        }
+    };
+    bool bRoot = depth == 0;
+    if (!bRoot or file->contents.find("#version") == std::string::npos) {
+        appendDefines();
+        appendLineDirective(1);
+    }
+
+    std::string_view contents = file->contents;
+    int lineNumber = 0;
+    bool bInComment = false;
+    while (!contents.empty()) {
+        auto line = nextLine(contents);
+        lineNumber++;
+        std::string_view argument, directive;
+        if (!bInComment) {
+            directive = parseDirective(line, argument);
+        }
+        bInComment = isInComment(line, bInComment);
+
+        if (directive == "include") {
+            if (argument.size() < 2 or argument.front() != '"' or argument.find('"', 1) == std::string_view::npos) {
+                return false;
+            }
+            auto includeName = std::string(argument.substr(1, argument.find('"', 1) - 1));
+            auto includePath = std::filesystem::path(fileName).parent_path() / includeName;
+            if (!ShaderPreprocessor::expandFile(includePath.lexically_normal().generic_string(), {}, depth + 1, expandedFiles, output)) {
+                return false;
+            }
+            appendLineDirective(lineNumber + 1);
+        } else if (directive == "pragma" and argument == "once") {
+            output += '\n';
+        } else if (directive == "version" and bRoot) {
+            output.append(line);
+            output += '\n';
+            appendDefines();
+            appendLineDirective(lineNumber + 1);
+        } else {
+            output.append(line);
+            output += '\n';
+        }
+    }
+    return true;
+}
@@ -0,0 +1,168 @@
+#include "ShaderReloader.hpp"
+#include "CPUProfiler.hpp"
+#include "ProgramCache.hpp"
+#include "UniformCache.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#define TUTORIAL_HAS_INOTIFY
+#endif
+
+bool ShaderReloader::bEnabled = true;
+std::vector<ShaderReloader::WatchedProgram> ShaderReloader::programs;
+int ShaderReloader::inotifyFd = -1;
+std::unordered_map<int, std::filesystem::path> ShaderReloader::watchedDirectories;
+
+bool ShaderReloader::initialize() {
+#ifdef TUTORIAL_HAS_INOTIFY
+    if (ShaderReloader::bEnabled and ShaderReloader::inotifyFd < 0) {
+        ShaderReloader::inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    }
+    return ShaderReloader::inotifyFd >= 0;
+#else
+    return false;
+#endif
+}
+
+void ShaderReloader::terminate() {
+#ifdef TUTORIAL_HAS_INOTIFY
+    if (ShaderReloader::inotifyFd >= 0) {
+        ::close(ShaderReloader::inotifyFd);
+    }
+#endif
+    ShaderReloader::inotifyFd = -1;
+    ShaderReloader::watchedDirectories.clear();
+    ShaderReloader::programs.clear();
+}
+
+void ShaderReloader::createProgram(GLuint& program, const std::vector<ShaderStage>& stages) {
+    WatchedProgram watchedProgram = {&program, stages, {}, nullptr};
+    program = ShaderReloader::buildProgram(watchedProgram);
+    for (const auto& fileName: watchedProgram.files) {
+        ShaderReloader::watchDirectory(std::filesystem::path(fileName).parent_path());
+    }
+    ShaderReloader::programs.push_back(std::move(watchedProgram));
+}
+
+void ShaderReloader::setSetupFunction(const GLuint& program, SetupFunction setupFunction) {
+    auto it = std::find_if(ShaderReloader::programs.begin(), ShaderReloader::programs.end(), [&program](const WatchedProgram& p) {
+        return p.program == &program;
+    });
+    if (it == ShaderReloader::programs.end()) {
+        return;
+    }
+    it->setupFunction = std::move(setupFunction);
+    it->setupFunction(program);
+}
+
+// Files are listed again on every build since edits may add or drop includes
+GLuint ShaderReloader::buildProgram(WatchedProgram& watchedProgram) {
+    std::vector<ShaderSource> shaders;
+    watchedProgram.files.clear();
+    bool bValid = true;
+    for (const auto& stage: watchedProgram.stages) {
+        auto shader = ShaderPreprocessor::load(stage.filePath, stage.defines);
+        if (!shader.bValid) {
+            std::fprintf(stderr, "Failed to load shader %s\n", stage.filePath.string().c_str());
+            bValid = false;
+        }
+        watchedProgram.files.insert(watchedProgram.files.end(), shader.files.begin(), shader.files.end());
+        shaders.push_back({stage.type, std::move(shader.source), shader.sourceHash});
+    }
+    if (!bValid) {
+        return 0;
+    }
+    return ProgramCache::createProgram(shaders);
+}
+
+void ShaderReloader::watchDirectory(const std::filesystem::path& directory) {
+#ifdef TUTORIAL_HAS_INOTIFY
+    if (ShaderReloader::inotifyFd < 0) {
+        return;
+    }
+    // Editors that save through a temporary file trigger IN_MOVED_TO instead of IN_CLOSE_WRITE
+    int wd = inotify_add_watch(ShaderReloader::inotifyFd, directory.empty() ? "." : directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (wd >= 0) {
+        ShaderReloader::watchedDirectories[wd] = directory;
+    }
+#else
+    (void)directory;
+#endif
+}
+
+std::vector<std::string> ShaderReloader::readChangedFiles() {
+    std::vector<std::string> changedFiles;
+#ifdef TUTORIAL_HAS_INOTIFY
+    alignas(inotify_event) char buffer[4096];
+    ssize_t length;
+    while ((length = ::read(ShaderReloader::inotifyFd, buffer, sizeof(buffer))) > 0) {
+        for (char* eventPointer = buffer; eventPointer < buffer + length;) {
+            const auto* event = reinterpret_cast<const inotify_event*>(eventPointer);
+            auto it = ShaderReloader::watchedDirectories.find(event->wd);
+            if (event->len > 0 and it != ShaderReloader::watchedDirectories.end()) {
+                auto fileName = (it->second / event->name).lexically_normal().generic_string();
+                if (std::find(changedFiles.begin(), changedFiles.end(), fileName) == changedFiles.end()) {
+                    changedFiles.push_back(fileName);
+                }
+            }
+            eventPointer += sizeof(inotify_event) + event->len;
+        }
+    }
+#endif
+    return changedFiles;
+}
+
+void ShaderReloader::update() {
+    if (ShaderReloader::inotifyFd < 0) {
+        return;
+    }
+    auto changedFiles = ShaderReloader::readChangedFiles();
+    if (changedFiles.empty()) {
+        return;
+    }
+    ScopedCPUZone cpuZone("ShaderReloader::update");
+    for (const auto& fileName: changedFiles) {
+        ShaderPreprocessor::invalidateFile(fileName);
+    }
+
+    std::vector<std::pair<WatchedProgram*, GLuint>> rebuiltPrograms;
+    for (auto& watchedProgram: ShaderReloader::programs) {
+        bool bAffected = std::any_of(watchedProgram.files.begin(), watchedProgram.files.end(), [&changedFiles](const std::string& fileName) {
+            return std::find(changedFiles.begin(), changedFiles.end(), fileName) != changedFiles.end();
+        });
+        if (bAffected) {
+            rebuiltPrograms.emplace_back(&watchedProgram, ShaderReloader::buildProgram(watchedProgram));
+        }
+    }
+    // Waits for the rebuilt programs only, so they are all swapped in the
+    // same frame while other programs keep compiling
+    for (const auto& rebuiltProgram: rebuiltPrograms) {
+        ProgramCache::finishProgram(rebuiltProgram.second);
+    }
+    ProgramCache::releaseShaders();
+
+    for (auto [watchedProgram, program]: rebuiltPrograms) {
+        for (const auto& fileName: watchedProgram->files) {
+            ShaderReloader::watchDirectory(std::filesystem::path(fileName).parent_path());
+        }
+        GLint bLinked = GL_FALSE;
+        if (program) {
+            glGetProgramiv(program, GL_LINK_STATUS, &bLinked);
+        }
+        if (!bLinked) {
+            std::fprintf(stderr, "Keeping the previous program of %s\n", watchedProgram->stages.front().filePath.string().c_str());
+            glDeleteProgram(program);
+            continue;
+        }
+        UniformCache::forgetProgram(*watchedProgram->program);
+        glDeleteProgram(*watchedProgram->program);
+        *watchedProgram->program = program;
+        if (watchedProgram->setupFunction) {
+            watchedProgram->setupFunction(program);
+        }
+    }
+}
@@ -0,0 +1,170 @@
+#include "TextureCache.hpp"
+#include "CacheUtil.hpp"
+#include "CPUProfiler.hpp"
+#include "MipmapGenerator.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+bool TextureCache::bEnabled = true;
+std::filesystem::path TextureCache::cacheRoot = "assets/cache/textures/";
+
+namespace {
+constexpr char CACHE_MAGIC[8] = {'T', 'U', 'T', 'T', 'E', 'X', '\0', '\0'};
+
+struct FileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t format;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t numLevels;
+    std::uint32_t bSRGBA;
+    std::int64_t sourceTime;
+    std::uint64_t sourceSize;
+    std::uint64_t sourcePathLength;
+};
+
+struct LevelHeader {
+    std::uint64_t offset;
+    std::uint64_t size;
+};
+
+static_assert(sizeof(FileHeader) == 56);
+static_assert(sizeof(LevelHeader) == 16);
+}  // namespace
+
+std::size_t CompressedTexture::getSize() const {
+    std::size_t size = 0;
+    for (auto levelSize: this->levelSizes) {
+        size += levelSize;
+    }
+    return size;
+}
+
+GLenum CompressedTexture::getInternalFormat(bool bSRGBA) const {
+    if (this->format == CompressedFormat::BC1) {
+        return bSRGBA ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    }
+    return bSRGBA ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+}
+
+// Only reads the extension flags, so worker threads may call it once GL is loaded
+bool TextureCache::isSupported(bool bSRGBA) {
+    return TextureCache::bEnabled and GLAD_GL_EXT_texture_compression_s3tc and (!bSRGBA or GLAD_GL_EXT_texture_sRGB);
+}
+
+void TextureCache::setCacheRoot(const std::filesystem::path& newCacheRoot) {
+    TextureCache::cacheRoot = newCacheRoot;
+}
+
+std::filesystem::path TextureCache::getCachePath(const std::filesystem::path& sourcePath, bool bSRGBA) {
+    std::string sourceName = sourcePath.lexically_normal().generic_string();
+    std::uint64_t pathHash = CacheUtil::fnv1a(reinterpret_cast<const std::byte*>(sourceName.data()), sourceName.size());
+    char fileName[40];
+    std::snprintf(fileName, sizeof(fileName), "-%016llx%s.tex", static_cast<unsigned long long>(pathHash), bSRGBA ? "-srgb" : "");
+    return TextureCache::cacheRoot / (sourcePath.stem().string() + fileName);
+}
+
+bool TextureCache::load(const std::filesystem::path& sourcePath, bool bSRGBA, CompressedTexture& texture) {
+    if (!TextureCache::isSupported(bSRGBA)) {
+        return false;
+    }
+    std::error_code error;
+    std::int64_t sourceTime = std::filesystem::last_write_time(sourcePath, error).time_since_epoch().count();
+    std::uint64_t sourceSize = std::filesystem::file_size(sourcePath, error);
+    if (error) {
+        return false;
+    }
+    MappedFile cacheFile(TextureCache::getCachePath(sourcePath, bSRGBA));
+    if (!cacheFile.isOpen() or cacheFile.size() < sizeof(FileHeader)) {
+        return false;
+    }
+
+    FileHeader fileHeader;
+    std::memcpy(&fileHeader, cacheFile.data(), sizeof(fileHeader));
+    std::string sourceName = sourcePath.lexically_normal().generic_string();
+    if (std::memcmp(fileHeader.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 or fileHeader.version != TextureCache::VERSION or
+        fileHeader.bSRGBA != bSRGBA or fileHeader.sourceTime != sourceTime or fileHeader.sourceSize != sourceSize) {
+        return false;
+    }
+    if (fileHeader.format != static_cast<std::uint32_t>(CompressedFormat::BC1) and fileHeader.format != static_cast<std::uint32_t>(CompressedFormat::BC3)) {
+        return false;
+    }
+    if (fileHeader.sourcePathLength != sourceName.size() or !CacheUtil::isInside(cacheFile, sizeof(FileHeader), sourceName.size()) or
+        std::memcmp(cacheFile.data() + sizeof(FileHeader), sourceName.data(), sourceName.size()) != 0) {
+        return false;
+    }
+    int width = fileHeader.width, height = fileHeader.height;
+    if (width <= 0 or height <= 0 or fileHeader.numLevels != static_cast<std::uint32_t>(MipmapGenerator::getNumLevels(width, height))) {
+        return false;
+    }
+
+    std::uint64_t levelTableOffset = sizeof(FileHeader) + fileHeader.sourcePathLength;
+    if (!CacheUtil::isInside(cacheFile, levelTableOffset, static_cast<std::uint64_t>(fileHeader.numLevels) * sizeof(LevelHeader))) {
+        return false;
+    }
+    CompressedTexture loadedTexture;
+    loadedTexture.format = static_cast<CompressedFormat>(fileHeader.format);
+    loadedTexture.width = width;
+    loadedTexture.height = height;
+    for (std::uint32_t i = 0; i < fileHeader.numLevels; i++) {
+        LevelHeader levelHeader;
+        std::memcpy(&levelHeader, cacheFile.data() + levelTableOffset + i * sizeof(LevelHeader), sizeof(levelHeader));
+        int levelWidth = std::max(width >> i, 1), levelHeight = std::max(height >> i, 1);
+        if (levelHeader.size != TextureCompressor::getCompressedSize(loadedTexture.format, levelWidth, levelHeight) or
+            !CacheUtil::isInside(cacheFile, levelHeader.offset, levelHeader.size)) {
+            return false;
+        }
+        loadedTexture.levelData.push_back(cacheFile.data() + levelHeader.offset);
+        loadedTexture.levelSizes.push_back(levelHeader.size);
+    }
+    loadedTexture.file = std::move(cacheFile);
+    texture = std::move(loadedTexture);
+    return true;
+}
+
+bool TextureCache::store(const std::filesystem::path& sourcePath, bool bSRGBA, const std::vector<std::vector<std::byte>>& levels, int width, int height) {
+    if (!TextureCache::isSupported(bSRGBA) or levels.size() != static_cast<std::size_t>(MipmapGenerator::getNumLevels(width, height))) {
+        return false;
+    }
+    ScopedCPUZone cpuZone("TextureCache::store");
+    std::error_code error;
+    std::string sourceName = sourcePath.lexically_normal().generic_string();
+
+    FileHeader fileHeader;
+    std::memcpy(fileHeader.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    fileHeader.version = TextureCache::VERSION;
+    auto format = TextureCompressor::hasAlpha(levels[0].data(), width, height) ? CompressedFormat::BC3 : CompressedFormat::BC1;
+    fileHeader.format = static_cast<std::uint32_t>(format);
+    fileHeader.width = width;
+    fileHeader.height = height;
+    fileHeader.numLevels = MipmapGenerator::getNumLevels(width, height);
+    fileHeader.bSRGBA = bSRGBA;
+    fileHeader.sourceTime = std::filesystem::last_write_time(sourcePath, error).time_since_epoch().count();
+    fileHeader.sourceSize = std::filesystem::file_size(sourcePath, error);
+    if (error) {
+        return false;
+    }
+    fileHeader.sourcePathLength = sourceName.size();
+
+    std::vector<LevelHeader> levelHeaders(fileHeader.numLevels);
+    std::uint64_t offset = sizeof(FileHeader) + sourceName.size() + levelHeaders.size() * sizeof(LevelHeader);
+    for (std::uint32_t i = 0; i < fileHeader.numLevels; i++) {
+        offset = (offset + 15) & ~std::uint64_t(15);
+        levelHeaders[i].offset = offset;
+        levelHeaders[i].size = TextureCompressor::getCompressedSize(format, std::max(width >> i, 1), std::max(height >> i, 1));
+        offset += levelHeaders[i].size;
+    }
+
+    std::vector<std::byte> fileContents(offset);
+    std::memcpy(fileContents.data(), &fileHeader, sizeof(fileHeader));
+    std::memcpy(fileContents.data() + sizeof(FileHeader), sourceName.data(), sourceName.size());
+    std::memcpy(fileContents.data() + sizeof(FileHeader) + sourceName.size(), levelHeaders.data(), levelHeaders.size() * sizeof(LevelHeader));
+    for (std::uint32_t i = 0; i < fileHeader.numLevels; i++) {
+        TextureCompressor::compress(format, levels[i].data(), std::max(width >> i, 1), std::max(height >> i, 1), fileContents.data() + levelHeaders[i].offset);
+    }
+
+    return CacheUtil::writeFile(TextureCache::getCachePath(sourcePath, bSRGBA), fileContents);
+}
@@ -0,0 +1,159 @@
+#include "TextureCompressor.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+std::uint16_t packColor565(const float color[3]) {
+    auto quantize = [](float value, int maxValue) {
+        return static_cast<std::uint16_t>(std::clamp(std::lround(value * maxValue / 255.0f), 0l, static_cast<long>(maxValue)));
+    };
+    return (quantize(color[0], 31) << 11) | (quantize(color[1], 63) << 5) | quantize(color[2], 31);
+}
+
+void unpackColor565(std::uint16_t packedColor, int color[3]) {
+    int r = (packedColor >> 11) & 31, g = (packedColor >> 5) & 63, b = packedColor & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+void writeLittleEndian(std::byte* output, std::uint64_t value, int numBytes) {
+    for (int i = 0; i < numBytes; i++) {
+        output[i] = static_cast<std::byte>(value >> (8 * i));
+    }
+}
+}  // namespace
+
+bool TextureCompressor::hasAlpha(const std::byte* image, int width, int height) {
+    std::size_t numTexels = static_cast<std::size_t>(width) * height;
+    for (std::size_t i = 0; i < numTexels; i++) {
+        if (static_cast<std::uint8_t>(image[i * 4 + 3]) != 255) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::size_t TextureCompressor::getCompressedSize(CompressedFormat format, int width, int height) {
+    std::size_t numBlocks = static_cast<std::size_t>((width + 3) / 4) * ((height + 3) / 4);
+    return numBlocks * (format == CompressedFormat::BC1 ? 8 : 16);
+}
+
+void TextureCompressor::compress(CompressedFormat format, const std::byte* image, int width, int height, std::byte* compressedImage) {
+    auto texels = reinterpret_cast<const std::uint8_t*>(image);
+    std::uint8_t block[16][4];
+    for (int blockY = 0; blockY < height; blockY += 4) {
+        for (int blockX = 0; blockX < width; blockX += 4) {
+            for (int i = 0; i < 16; i++) {
+                int x = std::min(blockX + i % 4, width - 1);
+                int y = std::min(blockY + i / 4, height - 1);
+                std::memcpy(block[i], texels + (static_cast<std::size_t>(y) * width + x) * 4, 4);
+            }
+            if (format == CompressedFormat::BC3) {
+                TextureCompressor::encodeAlphaBlock(block, compressedImage);
+                compressedImage += 8;
+            }
+            TextureCompressor::encodeColorBlock(block, compressedImage);
+            compressedImage += 8;
+        }
+    }
+}
+
+// The endpoints are the extremes of the colors projected onto their
+// principal axis, found with a few power iterations on the covariance matrix
+void TextureCompressor::encodeColorBlock(const std::uint8_t block[16][4], std::byte* output) {
+    float mean[3] = {0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 3; c++) {
+            mean[c] += block[i][c] / 16.0f;
+        }
+    }
+    float covariance[3][3] = {};
+    for (int i = 0; i < 16; i++) {
+        float d[3] = {block[i][0] - mean[0], block[i][1] - mean[1], block[i][2] - mean[2]};
+        for (int r = 0; r < 3; r++) {
+            for (int c = 0; c < 3; c++) {
+                covariance[r][c] += d[r] * d[c];
+            }
+        }
+    }
+    float axis[3] = {1.0f, 1.0f, 1.0f};
+    for (int iteration = 0; iteration < 4; iteration++) {
+        float nextAxis[3];
+        for (int r = 0; r < 3; r++) {
+            nextAxis[r] = covariance[r][0] * axis[0] + covariance[r][1] * axis[1] + covariance[r][2] * axis[2];
+        }
+        float length = std::max({std::abs(nextAxis[0]), std::abs(nextAxis[1]), std::abs(nextAxis[2])});
+        if (length == 0.0f) {
+            break;
+        }
+        for (int c = 0; c < 3; c++) {
+            axis[c] = nextAxis[c] / length;
+        }
+    }
+    float minProjection = 0.0f, maxProjection = 0.0f;
+    for (int i = 0; i < 16; i++) {
+        float projection = (block[i][0] - mean[0]) * axis[0] + (block[i][1] - mean[1]) * axis[1] + (block[i][2] - mean[2]) * axis[2];
+        minProjection = std::min(minProjection, projection);
+        maxProjection = std::max(maxProjection, projection);
+    }
+    float axisLength2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+    float endpoint0[3], endpoint1[3];
+    for (int c = 0; c < 3; c++) {
+        endpoint0[c] = mean[c] + axis[c] * maxProjection / axisLength2;
+        endpoint1[c] = mean[c] + axis[c] * minProjection / axisLength2;
+    }
+
+    // Four color mode needs color0 > color1, equal colors select color0 only
+    std::uint16_t color0 = packColor565(endpoint0), color1 = packColor565(endpoint1);
+    if (color0 < color1) {
+        std::swap(color0, color1);
+    }
+    std::uint32_t indices = 0;
+    if (color0 != color1) {
+        int palette[4][3];
+        unpackColor565(color0, palette[0]);
+        unpackColor565(color1, palette[1]);
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        for (int i = 0; i < 16; i++) {
+            int bestIndex = 0, bestDistance = 1 << 30;
+            for (int p = 0; p < 4; p++) {
+                int dr = block[i][0] - palette[p][0], dg = block[i][1] - palette[p][1], db = block[i][2] - palette[p][2];
+                int distance = dr * dr + dg * dg + db * db;
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    bestIndex = p;
+                }
+            }
+            indices |= static_cast<std::uint32_t>(bestIndex) << (2 * i);
+        }
+    }
+    writeLittleEndian(output, color0, 2);
+    writeLittleEndian(output + 2, color1, 2);
+    writeLittleEndian(output + 4, indices, 4);
+}
+
+// Uses the eight value mode between the block's alpha extremes
+void TextureCompressor::encodeAlphaBlock(const std::uint8_t block[16][4], std::byte* output) {
+    int alpha0 = 0, alpha1 = 255;
+    for (int i = 0; i < 16; i++) {
+        alpha0 = std::max<int>(alpha0, block[i][3]);
+        alpha1 = std::min<int>(alpha1, block[i][3]);
+    }
+    std::uint64_t indices = 0;
+    if (alpha0 != alpha1) {
+        for (int i = 0; i < 16; i++) {
+            int level = ((block[i][3] - alpha1) * 14 + (alpha0 - alpha1)) / (2 * (alpha0 - alpha1));
+            int index = level == 7 ? 0 : level == 0 ? 1 : 8 - level;
+            indices |= static_cast<std::uint64_t>(index) << (3 * i);
+        }
+    }
+    output[0] = static_cast<std::byte>(alpha0);
+    output[1] = static_cast<std::byte>(alpha1);
+    writeLittleEndian(output + 2, indices, 6);
+}
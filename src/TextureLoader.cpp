@@ -1,51 +1,555 @@
 #include "TextureLoader.hpp"
+#include "CPUProfiler.hpp"
+#include "MipmapGenerator.hpp"
+#include "TextureCompressor.hpp"
+#include "ThreadPool.hpp"
 
 #include <png.h>
 
 #include <algorithm>
+#include <cstring>
+#include <limits>
 
 std::filesystem::path TextureLoader::textureRoot = "assets/textures/";
-std::unordered_map<std::string, GLuint, boost::hash<std::string>> TextureLoader::texture2DMap;
-std::unordered_map<std::vector<std::string>, GLuint, boost::hash<std::vector<std::string>>> TextureLoader::textureCubeMapMap;
+TextureLoader::Texture2DMap TextureLoader::texture2DMap;
+TextureLoader::TextureCubeMapMap TextureLoader::textureCubeMapMap;
+TextureLoader::Texture2DMap TextureLoader::textureLayerMap;
+std::vector<TextureLoader::TextureArray> TextureLoader::textureArrays;
+std::atomic<std::size_t> TextureLoader::numPending = 0;
+unsigned long TextureLoader::frameNumber = 0;
+std::size_t TextureLoader::budgetBytes = 0;
+unsigned long TextureLoader::evictionFrames = 120;
+std::atomic<std::size_t> TextureLoader::residentBytes = 0;
+std::atomic<std::size_t> TextureLoader::numResident = 0;
+std::atomic<std::uint64_t> TextureLoader::numHits = 0;
+std::atomic<std::uint64_t> TextureLoader::numMisses = 0;
+std::uint64_t TextureLoader::numEvictions = 0;
+std::uint64_t TextureLoader::numLoads = 0;
+double TextureLoader::totalLoadTime = 0.0;
+double TextureLoader::maxLoadTime = 0.0;
+bool TextureLoader::bStreaming = true;
+std::vector<std::shared_ptr<TextureLoader::StreamJob>> TextureLoader::uploadingJobs;
+GLuint TextureLoader::placeholder2D = 0;
+GLuint TextureLoader::placeholderCubeMap = 0;
+std::mutex TextureLoader::decodedMutex;
+std::condition_variable TextureLoader::decodedCondition;
+std::deque<std::shared_ptr<TextureLoader::StreamJob>> TextureLoader::decodedJobs;
+std::size_t TextureLoader::numDecoding = 0;
+std::vector<std::pair<TextureLoader::Callback, GLuint>> TextureLoader::readyCallbacks;
 
 GLuint TextureLoader::getTextureId2D(const std::string& textureName, bool bSRGBA) {
-    if (!TextureLoader::texture2DMap.count(textureName)) {
-        TextureLoader::loadTexture2D(textureName, bSRGBA);
-    }
-    return TextureLoader::texture2DMap[textureName];
+    return TextureLoader::getTextureId(TextureLoader::texture2DMap, textureName, GL_TEXTURE_2D, {textureName}, bSRGBA);
 }
 
 GLuint TextureLoader::getTextureIdCubeMap(const std::vector<std::string>& textureNames, bool bSRGBA) {
-    if (!TextureLoader::textureCubeMapMap.count(textureNames)) {
-        TextureLoader::loadTextureCubeMap(textureNames, bSRGBA);
+    return TextureLoader::getTextureId(TextureLoader::textureCubeMapMap, textureNames, GL_TEXTURE_CUBE_MAP, textureNames, bSRGBA);
+}
+
+// Without streaming the texture is still decoded and uploaded by the same
+// jobs, the render thread just waits for them
+template<typename Map, typename Key>
+GLuint TextureLoader::getTextureId(Map& map, const Key& key, GLenum target, const std::vector<std::string>& textureNames, bool bSRGBA) {
+    GLuint textureId = 0;
+    bool bResident = false;
+    auto markUsed = [&textureId, &bResident](TextureEntry& entry) {
+        if (entry.bResident) {
+            entry.lastUsedFrame = TextureLoader::frameNumber;
+            textureId = entry.textureId;
+            bResident = true;
+        }
+    };
+    if (map.updateIfPresent(key, markUsed) and bResident) {
+        TextureLoader::numHits++;
+        return textureId;
+    }
+    TextureLoader::numMisses++;
+    TextureLoader::requestTexture(map, key, target, textureNames, bSRGBA, nullptr);
+    if (!TextureLoader::bStreaming) {
+        TextureLoader::waitForTextures();
+        if (map.updateIfPresent(key, markUsed) and bResident) {
+            return textureId;
+        }
+    }
+    return TextureLoader::getPlaceholder(target);
+}
+
+void TextureLoader::requestTexture2D(const std::string& textureName, bool bSRGBA, Callback callback) {
+    TextureLoader::requestTexture(TextureLoader::texture2DMap, textureName, GL_TEXTURE_2D, {textureName}, bSRGBA, std::move(callback));
+}
+
+void TextureLoader::requestTextureCubeMap(const std::vector<std::string>& textureNames, bool bSRGBA, Callback callback) {
+    TextureLoader::requestTexture(TextureLoader::textureCubeMapMap, textureNames, GL_TEXTURE_CUBE_MAP, textureNames, bSRGBA, std::move(callback));
+}
+
+// The entry is created under its shard lock, so concurrent requests for the
+// same texture share one job. The job counts as decoding before the lock is
+// released, waitForTextures never sees it pending but not yet decoding.
+template<typename Map, typename Key>
+void TextureLoader::requestTexture(Map& map, const Key& key, GLenum target, const std::vector<std::string>& textureNames, bool bSRGBA, Callback callback) {
+    std::shared_ptr<StreamJob> newJob;
+    bool bResident = false;
+    GLuint textureId = 0;
+    map.update(key, [&](TextureEntry& entry) {
+        if (callback) {
+            entry.callbacks.push_back(callback);
+        }
+        if (entry.bResident) {
+            bResident = true;
+            textureId = entry.textureId;
+            return;
+        }
+        if (!entry.job) {
+            newJob = TextureLoader::createJob(target, textureNames, bSRGBA);
+            entry.job = newJob;
+            TextureLoader::numPending++;
+        }
+    });
+
+    if (newJob) {
+        ThreadPool::enqueue([newJob]() {
+            TextureLoader::decodeJob(newJob);
+        });
+    } else if (bResident and callback) {
+        std::lock_guard lock(TextureLoader::decodedMutex);
+        TextureLoader::readyCallbacks.emplace_back(std::move(callback), textureId);
+    }
+}
+
+// The job counts as decoding from here on, it has to be enqueued
+std::shared_ptr<TextureLoader::StreamJob> TextureLoader::createJob(GLenum target, const std::vector<std::string>& textureNames, bool bSRGBA) {
+    auto job = std::make_shared<StreamJob>();
+    job->target = target;
+    job->textureNames = textureNames;
+    job->bSRGBA = bSRGBA;
+    job->requestTime = std::chrono::steady_clock::now();
+    for (const auto& textureName: textureNames) {
+        job->imagePaths.push_back(TextureLoader::textureRoot / textureName);
+    }
+    std::lock_guard lock(TextureLoader::decodedMutex);
+    TextureLoader::numDecoding++;
+    return job;
+}
+
+// Only reads the header, so it is cheap enough for the render thread
+bool getImageSize(const std::string& src, int& width, int& height) {
+    png_image image;
+    std::memset(&image, 0, sizeof(image));
+    image.version = PNG_IMAGE_VERSION;
+    if (!png_image_begin_read_from_file(&image, src.c_str())) {
+        return false;
     }
-    return TextureLoader::textureCubeMapMap[textureNames];
+    width = image.width;
+    height = image.height;
+    png_image_free(&image);
+    return width > 0 and height > 0;
 }
 
+TextureLayer TextureLoader::getTextureLayer(const std::string& textureName, bool bSRGBA) {
+    TextureLayer textureLayer;
+    bool bResident = false;
+    auto markUsed = [&textureLayer, &bResident](TextureEntry& entry) {
+        entry.lastUsedFrame = TextureLoader::frameNumber;
+        textureLayer = {entry.textureArray, entry.layer};
+        bResident = entry.bResident;
+    };
+    if (TextureLoader::textureLayerMap.updateIfPresent(textureName, markUsed)) {
+        if (bResident) {
+            TextureLoader::numHits++;
+        } else {
+            TextureLoader::numMisses++;
+        }
+        return textureLayer;
+    }
+    TextureLoader::numMisses++;
+    // Images that cannot be read get a placeholder layer of their own size
+    int width, height;
+    if (!getImageSize((TextureLoader::textureRoot / textureName).string(), width, height)) {
+        width = 1;
+        height = 1;
+    }
+    textureLayer.textureArray = TextureLoader::findTextureArray(width, height, bSRGBA);
+    textureLayer.layer = TextureLoader::allocateLayer(textureLayer.textureArray);
+    auto job = TextureLoader::createLayerJob(textureName, bSRGBA, textureLayer.textureArray, textureLayer.layer);
+    TextureLoader::textureLayerMap.update(textureName, [&](TextureEntry& entry) {
+        entry.textureArray = textureLayer.textureArray;
+        entry.layer = textureLayer.layer;
+        entry.lastUsedFrame = TextureLoader::frameNumber;
+        entry.job = job;
+    });
+    TextureLoader::numPending++;
+    ThreadPool::enqueue([job]() {
+        TextureLoader::decodeJob(job);
+    });
+    if (!TextureLoader::bStreaming) {
+        TextureLoader::waitForTextures();
+    }
+    return textureLayer;
+}
+
+// The layer format is copied into the job, decoding must not read the arrays
+std::shared_ptr<TextureLoader::StreamJob> TextureLoader::createLayerJob(const std::string& textureName, bool bSRGBA, GLint textureArray, GLint layer) {
+    auto job = TextureLoader::createJob(GL_TEXTURE_2D_ARRAY, {textureName}, bSRGBA);
+    const auto& array = TextureLoader::textureArrays[textureArray];
+    job->textureArray = textureArray;
+    job->layer = layer;
+    job->layerWidth = array.width;
+    job->layerHeight = array.height;
+    job->bCompressedLayer = array.bCompressed;
+    return job;
+}
+
+GLuint TextureLoader::getTextureArrayId(GLint textureArray) {
+    if (textureArray < 0 or static_cast<std::size_t>(textureArray) >= TextureLoader::textureArrays.size()) {
+        return 0;
+    }
+    return TextureLoader::textureArrays[textureArray].textureId;
+}
+
+// Arrays are created empty, they get their texture with the first layer
+GLint TextureLoader::findTextureArray(int width, int height, bool bSRGBA) {
+    for (std::size_t i = 0; i < TextureLoader::textureArrays.size(); i++) {
+        const auto& textureArray = TextureLoader::textureArrays[i];
+        if (textureArray.width == width and textureArray.height == height and textureArray.bSRGBA == bSRGBA) {
+            return i;
+        }
+    }
+    TextureArray textureArray;
+    textureArray.width = width;
+    textureArray.height = height;
+    textureArray.bSRGBA = bSRGBA;
+    textureArray.bCompressed = TextureCache::isSupported(bSRGBA);
+    TextureLoader::textureArrays.push_back(std::move(textureArray));
+    return TextureLoader::textureArrays.size() - 1;
+}
+
+// Freed layers are reused lowest first, so arrays stay densely packed
+GLint TextureLoader::allocateLayer(GLint textureArray) {
+    auto& array = TextureLoader::textureArrays[textureArray];
+    GLint layer;
+    if (!array.freeLayers.empty()) {
+        auto it = std::min_element(array.freeLayers.begin(), array.freeLayers.end());
+        layer = *it;
+        array.freeLayers.erase(it);
+    } else {
+        if (array.numUsedLayers == array.numLayers) {
+            TextureLoader::growTextureArray(textureArray);
+        }
+        layer = array.numUsedLayers++;
+    }
+    TextureLoader::clearLayers(array, array.textureId, layer, 1);
+    return layer;
+}
+
+// Layers keep their index in the larger array. With GL_ARB_copy_image their
+// contents are copied on the GPU, otherwise they are streamed in again.
+void TextureLoader::growTextureArray(GLint textureArray) {
+    ScopedCPUZone cpuZone("TextureLoader::growTextureArray");
+    auto& array = TextureLoader::textureArrays[textureArray];
+    GLsizei numLayers = std::max(2 * array.numLayers, TextureLoader::INITIAL_ARRAY_LAYERS);
+    int numLevels = MipmapGenerator::getNumLevels(array.width, array.height);
+    GLenum compressedFormat = array.bSRGBA ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+
+    GLint currentBoundTexture = 0;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &currentBoundTexture);
+    GLuint textureId;
+    glGenTextures(1, &textureId);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textureId);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, numLevels - 1);
+    for (int level = 0; level < numLevels; level++) {
+        GLsizei levelWidth = std::max(array.width >> level, 1), levelHeight = std::max(array.height >> level, 1);
+        if (array.bCompressed) {
+            glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, compressedFormat, levelWidth, levelHeight, numLayers, 0,
+                                   TextureLoader::getLayerLevelSize(array, level) * numLayers, nullptr);
+        } else {
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, level, array.bSRGBA ? GL_SRGB8_ALPHA8 : GL_RGBA8, levelWidth, levelHeight, numLayers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        }
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, currentBoundTexture);
+
+    GLuint oldTextureId = array.textureId;
+    if (oldTextureId) {
+        if (GLAD_GL_ARB_copy_image) {
+            for (int level = 0; level < numLevels; level++) {
+                GLsizei levelWidth = std::max(array.width >> level, 1), levelHeight = std::max(array.height >> level, 1);
+                glCopyImageSubData(oldTextureId, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, textureId, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+                                   levelWidth, levelHeight, array.numUsedLayers);
+            }
+        } else {
+            TextureLoader::clearLayers(array, textureId, 0, array.numUsedLayers);
+        }
+        glDeleteTextures(1, &oldTextureId);
+        TextureLoader::residentBytes -= TextureLoader::getTextureArraySize(array, array.numLayers);
+    }
+    array.textureId = textureId;
+    array.numLayers = numLayers;
+    TextureLoader::residentBytes += TextureLoader::getTextureArraySize(array, numLayers);
+    if (oldTextureId and !GLAD_GL_ARB_copy_image) {
+        TextureLoader::restreamLayers(textureArray);
+    }
+}
+
+// Fills every level of the layers with the placeholder color. Compressed
+// arrays repeat one encoded block, every block of a flat image is the same.
+void TextureLoader::clearLayers(const TextureArray& textureArray, GLuint textureId, GLint firstLayer, GLsizei numLayers) {
+    if (numLayers == 0) {
+        return;
+    }
+    std::uint8_t texels[16][4];
+    for (auto& texel: texels) {
+        texel[0] = texel[1] = texel[2] = 128;
+        texel[3] = 255;
+    }
+    std::vector<std::byte> pattern(4);
+    if (textureArray.bCompressed) {
+        pattern.resize(TextureCompressor::getCompressedSize(CompressedFormat::BC3, 4, 4));
+        TextureCompressor::compress(CompressedFormat::BC3, reinterpret_cast<const std::byte*>(texels), 4, 4, pattern.data());
+    } else {
+        std::memcpy(pattern.data(), texels[0], pattern.size());
+    }
+    std::vector<std::byte> levelData(TextureLoader::getLayerLevelSize(textureArray, 0));
+    for (std::size_t i = 0; i < levelData.size(); i += pattern.size()) {
+        std::memcpy(levelData.data() + i, pattern.data(), pattern.size());
+    }
+    GLenum compressedFormat = textureArray.bSRGBA ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    GLint currentBoundTexture = 0;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &currentBoundTexture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textureId);
+    int numLevels = MipmapGenerator::getNumLevels(textureArray.width, textureArray.height);
+    for (GLint layer = firstLayer; layer < firstLayer + numLayers; layer++) {
+        for (int level = 0; level < numLevels; level++) {
+            GLsizei levelWidth = std::max(textureArray.width >> level, 1), levelHeight = std::max(textureArray.height >> level, 1);
+            if (textureArray.bCompressed) {
+                glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, levelWidth, levelHeight, 1, compressedFormat,
+                                          TextureLoader::getLayerLevelSize(textureArray, level), levelData.data());
+            } else {
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, levelWidth, levelHeight, 1, GL_RGBA, GL_UNSIGNED_BYTE, levelData.data());
+            }
+        }
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, currentBoundTexture);
+}
+
+// Jobs of the layers that were still in flight become stale and are dropped
+void TextureLoader::restreamLayers(GLint textureArray) {
+    std::vector<std::string> textureNames;
+    TextureLoader::textureLayerMap.forEach([&textureNames, textureArray](const std::string& textureName, const TextureEntry& entry) {
+        if (entry.textureArray == textureArray) {
+            textureNames.push_back(textureName);
+        }
+    });
+    bool bSRGBA = TextureLoader::textureArrays[textureArray].bSRGBA;
+    for (const auto& textureName: textureNames) {
+        std::shared_ptr<StreamJob> job;
+        TextureLoader::textureLayerMap.updateIfPresent(textureName, [&](TextureEntry& entry) {
+            if (entry.bResident) {
+                entry.bResident = false;
+                TextureLoader::numResident--;
+            }
+            if (!entry.job) {
+                TextureLoader::numPending++;
+            }
+            job = TextureLoader::createLayerJob(textureName, bSRGBA, textureArray, entry.layer);
+            entry.job = job;
+        });
+        if (job) {
+            ThreadPool::enqueue([job]() {
+                TextureLoader::decodeJob(job);
+            });
+        }
+    }
+}
+
+std::size_t TextureLoader::getLayerLevelSize(const TextureArray& textureArray, int level) {
+    int levelWidth = std::max(textureArray.width >> level, 1), levelHeight = std::max(textureArray.height >> level, 1);
+    if (textureArray.bCompressed) {
+        return TextureCompressor::getCompressedSize(CompressedFormat::BC3, levelWidth, levelHeight);
+    }
+    return static_cast<std::size_t>(levelWidth) * levelHeight * 4;
+}
+
+std::size_t TextureLoader::getTextureArraySize(const TextureArray& textureArray, GLsizei numLayers) {
+    std::size_t layerSize = 0;
+    int numLevels = MipmapGenerator::getNumLevels(textureArray.width, textureArray.height);
+    for (int level = 0; level < numLevels; level++) {
+        layerSize += TextureLoader::getLayerLevelSize(textureArray, level);
+    }
+    return layerSize * numLayers;
+}
+
+void TextureLoader::update() {
+    ScopedCPUZone cpuZone("TextureLoader::update");
+    TextureLoader::frameNumber++;
+    TextureLoader::finishUploads(false);
+    TextureLoader::startUploads(TextureLoader::UPLOAD_BUDGET);
+    TextureLoader::runReadyCallbacks();
+    TextureLoader::evictTextures();
+}
+
+// Callbacks may request further textures, so this loops until nothing is left
+void TextureLoader::waitForTextures() {
+    ScopedCPUZone cpuZone("TextureLoader::waitForTextures");
+    while (TextureLoader::getNumPendingTextures() > 0) {
+        {
+            std::unique_lock lock(TextureLoader::decodedMutex);
+            TextureLoader::decodedCondition.wait(lock, []() {
+                return TextureLoader::numDecoding == 0;
+            });
+        }
+        TextureLoader::startUploads(std::numeric_limits<std::size_t>::max());
+        TextureLoader::finishUploads(true);
+    }
+    TextureLoader::runReadyCallbacks();
+}
+
+std::size_t TextureLoader::getNumPendingTextures() {
+    return TextureLoader::numPending.load();
+}
+
+void TextureLoader::setBudget(std::size_t budgetBytes, unsigned long evictionFrames) {
+    TextureLoader::budgetBytes = budgetBytes;
+    TextureLoader::evictionFrames = evictionFrames;
+}
+
+TextureStats TextureLoader::getStats() {
+    TextureStats stats;
+    stats.residentBytes = TextureLoader::residentBytes.load();
+    stats.budgetBytes = TextureLoader::budgetBytes;
+    stats.numResident = TextureLoader::numResident.load();
+    stats.numPending = TextureLoader::numPending.load();
+    stats.numHits = TextureLoader::numHits.load();
+    stats.numMisses = TextureLoader::numMisses.load();
+    stats.numEvictions = TextureLoader::numEvictions;
+    stats.averageLoadTime = TextureLoader::numLoads ? TextureLoader::totalLoadTime / TextureLoader::numLoads : 0.0;
+    stats.maxLoadTime = TextureLoader::maxLoadTime;
+    return stats;
+}
+
+// Only textures that were not bound for evictionFrames are candidates, a
+// scene that needs more than the budget every frame is left alone
+void TextureLoader::evictTextures() {
+    if (!TextureLoader::budgetBytes or TextureLoader::residentBytes <= TextureLoader::budgetBytes) {
+        return;
+    }
+    ScopedCPUZone cpuZone("TextureLoader::evictTextures");
+    struct Candidate {
+        unsigned long lastUsedFrame;
+        GLenum target;
+        std::vector<std::string> textureNames;
+    };
+    std::vector<Candidate> candidates;
+    auto isCandidate = [](const TextureEntry& entry) {
+        return entry.bResident and entry.numBytes > 0 and entry.lastUsedFrame + TextureLoader::evictionFrames <= TextureLoader::frameNumber;
+    };
+    TextureLoader::texture2DMap.forEach([&](const std::string& textureName, const TextureEntry& entry) {
+        if (isCandidate(entry)) {
+            candidates.push_back({entry.lastUsedFrame, GL_TEXTURE_2D, {textureName}});
+        }
+    });
+    TextureLoader::textureCubeMapMap.forEach([&](const std::vector<std::string>& textureNames, const TextureEntry& entry) {
+        if (isCandidate(entry)) {
+            candidates.push_back({entry.lastUsedFrame, GL_TEXTURE_CUBE_MAP, textureNames});
+        }
+    });
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& c1, const Candidate& c2) {
+        return c1.lastUsedFrame < c2.lastUsedFrame;
+    });
+
+    for (const auto& candidate: candidates) {
+        if (TextureLoader::residentBytes <= TextureLoader::budgetBytes) {
+            break;
+        }
+        GLuint textureId = 0;
+        std::size_t numBytes = 0;
+        auto evict = [&](TextureEntry& entry) {
+            if (isCandidate(entry)) {
+                textureId = entry.textureId;
+                numBytes = entry.numBytes;
+                entry.textureId = 0;
+                entry.numBytes = 0;
+                entry.bResident = false;
+            }
+        };
+        if (candidate.target == GL_TEXTURE_2D) {
+            TextureLoader::texture2DMap.updateIfPresent(candidate.textureNames[0], evict);
+        } else {
+            TextureLoader::textureCubeMapMap.updateIfPresent(candidate.textureNames, evict);
+        }
+        if (textureId) {
+            glDeleteTextures(1, &textureId);
+            TextureLoader::residentBytes -= numBytes;
+            TextureLoader::numResident--;
+            TextureLoader::numEvictions++;
+        }
+    }
+}
+
+// Jobs of freed textures that are still in flight are dropped by update
 void TextureLoader::freeTexture2D(const std::string& textureName) {
-    if (TextureLoader::texture2DMap.count(textureName)) {
-        glDeleteTextures(1, &TextureLoader::texture2DMap[textureName]);
-        TextureLoader::texture2DMap.erase(textureName);
+    TextureEntry entry;
+    if (TextureLoader::texture2DMap.extract(textureName, entry)) {
+        TextureLoader::forgetEntry(entry);
     }
 }
 
 void TextureLoader::freeTextureCubeMap(const std::vector<std::string>& textureNames) {
-    if (TextureLoader::textureCubeMapMap.count(textureNames)) {
-        glDeleteTextures(1, &TextureLoader::textureCubeMapMap[textureNames]);
-        TextureLoader::textureCubeMapMap.erase(textureNames);
+    TextureEntry entry;
+    if (TextureLoader::textureCubeMapMap.extract(textureNames, entry)) {
+        TextureLoader::forgetEntry(entry);
+    }
+}
+
+void TextureLoader::freeTextureLayer(const std::string& textureName) {
+    TextureEntry entry;
+    if (TextureLoader::textureLayerMap.extract(textureName, entry)) {
+        TextureLoader::forgetEntry(entry);
+    }
+}
+
+void TextureLoader::forgetEntry(const TextureEntry& entry) {
+    if (entry.job) {
+        TextureLoader::numPending--;
     }
+    if (entry.bResident) {
+        TextureLoader::residentBytes -= entry.numBytes;
+        TextureLoader::numResident--;
+    }
+    if (entry.layer >= 0) {
+        TextureLoader::textureArrays[entry.textureArray].freeLayers.push_back(entry.layer);
+    }
+    glDeleteTextures(1, &entry.textureId);
 }
 
 void TextureLoader::freeTextures() {
     std::vector<GLuint> textureIds;
-    auto transform_func = [](auto p) {
-        return p.second;
+    auto collectTextureId = [&textureIds](const auto&, const TextureEntry& entry) {
+        textureIds.push_back(entry.textureId);
     };
-    std::transform(texture2DMap.begin(), texture2DMap.end(), std::back_inserter(textureIds), transform_func);
-    std::transform(textureCubeMapMap.begin(), textureCubeMapMap.end(), std::back_inserter(textureIds), transform_func);
+    TextureLoader::texture2DMap.forEach(collectTextureId);
+    TextureLoader::textureCubeMapMap.forEach(collectTextureId);
+    for (auto& job: TextureLoader::uploadingJobs) {
+        TextureLoader::deleteStagingData(*job);
+        textureIds.push_back(job->textureId);
+    }
+    textureIds.push_back(TextureLoader::placeholder2D);
+    textureIds.push_back(TextureLoader::placeholderCubeMap);
+    for (const auto& textureArray: TextureLoader::textureArrays) {
+        textureIds.push_back(textureArray.textureId);
+    }
+    TextureLoader::textureArrays.clear();
     glDeleteTextures(textureIds.size(), textureIds.data());
-    texture2DMap.clear();
-    textureCubeMapMap.clear();
+    TextureLoader::texture2DMap.clear();
+    TextureLoader::textureCubeMapMap.clear();
+    TextureLoader::textureLayerMap.clear();
+    TextureLoader::numPending = 0;
+    TextureLoader::residentBytes = 0;
+    TextureLoader::numResident = 0;
+    TextureLoader::uploadingJobs.clear();
+    TextureLoader::placeholder2D = 0;
+    TextureLoader::placeholderCubeMap = 0;
 }
 
 void TextureLoader::setTextureRoot(const std::filesystem::path& newTextureRoot) {
@@ -56,77 +560,401 @@ void TextureLoader::setTextureRoot(const std::filesystem::path& newTextureRoot)
     TextureLoader::textureRoot = newTextureRoot;
 }
 
+// Leaves width and height at 0 if the image cannot be decoded
 std::vector<std::byte> getImageData(const std::string& src, int& width, int& height) {
+    width = 0;
+    height = 0;
     png_image loadedImage;
     std::memset(&loadedImage, 0, sizeof(loadedImage));
     loadedImage.version = PNG_IMAGE_VERSION;
-    png_image_begin_read_from_file(&loadedImage, src.c_str());
+    if (!png_image_begin_read_from_file(&loadedImage, src.c_str())) {
+        return {};
+    }
     loadedImage.format = PNG_FORMAT_RGBA;
     std::vector<std::byte> imageData(PNG_IMAGE_SIZE(loadedImage));
-    png_image_finish_read(&loadedImage, nullptr, imageData.data(), -PNG_IMAGE_ROW_STRIDE(loadedImage), nullptr);
+    if (!png_image_finish_read(&loadedImage, nullptr, imageData.data(), -PNG_IMAGE_ROW_STRIDE(loadedImage), nullptr)) {
+        png_image_free(&loadedImage);
+        return {};
+    }
     width = loadedImage.width;
     height = loadedImage.height;
     return imageData;
 }
 
-void TextureLoader::loadTexture2D(const std::string& textureKey, bool bSRGBA) {
-    auto currentPath = std::filesystem::current_path();
-    std::filesystem::current_path(TextureLoader::textureRoot);
-    if (std::filesystem::exists(textureKey)) {
-        GLint currentBoundTexture = 0;
-        glGetIntegerv(GL_TEXTURE_BINDING_2D, &currentBoundTexture);
-        GLuint textureId;
-        glGenTextures(1, &textureId);
-        glBindTexture(GL_TEXTURE_2D, textureId);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        int width, height;
-        auto imageData = getImageData(textureKey, width, height);
-        GLint imageFormat = bSRGBA ? GL_SRGB_ALPHA : GL_RGBA;
-        glTexImage2D(GL_TEXTURE_2D, 0, imageFormat, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, imageData.data());
-        glGenerateMipmap(GL_TEXTURE_2D);
-        TextureLoader::texture2DMap[textureKey] = textureId;
-        glBindTexture(GL_TEXTURE_2D, currentBoundTexture);
-    } else {
-        TextureLoader::texture2DMap[textureKey] = 0;
+void TextureLoader::decodeJob(const std::shared_ptr<StreamJob>& job) {
+    ScopedCPUZone cpuZone("TextureLoader::decodeJob");
+    job->bValid = job->target == GL_TEXTURE_CUBE_MAP ? job->imagePaths.size() == 6 : job->imagePaths.size() == 1;
+    bool bLayer = job->target == GL_TEXTURE_2D_ARRAY;
+    bool bCached = job->bValid and (!bLayer or job->bCompressedLayer) and TextureLoader::loadCompressedImages(*job);
+    if (job->bValid and !bCached) {
+        for (const auto& imagePath: job->imagePaths) {
+            if (!job->bValid) {
+                break;
+            }
+            DecodedImage image;
+            auto imageData = getImageData(imagePath.string(), image.width, image.height);
+            job->bValid = image.width > 0 and image.height > 0;
+            if (job->bValid) {
+                image.levels = MipmapGenerator::generate(imageData, image.width, image.height, job->bSRGBA);
+            }
+            job->images.push_back(std::move(image));
+        }
+        if (!job->bValid) {
+            job->images.clear();
+        }
+    }
+    if (job->bValid and !job->images.empty() and TextureCache::isSupported(job->bSRGBA)) {
+        for (std::size_t i = 0; i < job->images.size(); i++) {
+            const auto& image = job->images[i];
+            ThreadPool::enqueue([imagePath = job->imagePaths[i], bSRGBA = job->bSRGBA, levels = image.levels, width = image.width, height = image.height]() {
+                TextureCache::store(imagePath, bSRGBA, levels, width, height);
+            });
+        }
     }
-    std::filesystem::current_path(currentPath);
+    if (job->bValid and bLayer) {
+        TextureLoader::convertLayer(*job);
+    }
+    {
+        std::lock_guard lock(TextureLoader::decodedMutex);
+        TextureLoader::decodedJobs.push_back(job);
+        TextureLoader::numDecoding--;
+    }
+    TextureLoader::decodedCondition.notify_all();
 }
 
-void TextureLoader::loadTextureCubeMap(const std::vector<std::string>& textureKey, bool bSRGBA) {
-    auto currentPath = std::filesystem::current_path();
-    std::filesystem::current_path(TextureLoader::textureRoot);
-    bool bValid = textureKey.size() == 6;
-    for (const auto& texK: textureKey) {
-        if (!bValid) {
+// Either every image of the job comes from the cache or none does, the faces
+// of a cube map have to share their format and size
+bool TextureLoader::loadCompressedImages(StreamJob& job) {
+    if (!TextureCache::isSupported(job.bSRGBA)) {
+        return false;
+    }
+    for (const auto& imagePath: job.imagePaths) {
+        CompressedTexture texture;
+        if (!TextureCache::load(imagePath, job.bSRGBA, texture)) {
             break;
         }
-        bValid = std::filesystem::exists(texK);
+        const auto& firstTexture = job.compressedImages.empty() ? texture : job.compressedImages.front();
+        if (texture.format != firstTexture.format or texture.width != firstTexture.width or texture.height != firstTexture.height) {
+            break;
+        }
+        job.compressedImages.push_back(std::move(texture));
+    }
+    if (job.compressedImages.size() != job.imagePaths.size()) {
+        job.compressedImages.clear();
+        return false;
+    }
+    return true;
+}
+
+// Images whose size no longer matches their array stay placeholders. The
+// encoder only writes four color blocks, which decode the same as the color
+// half of BC3, so cached BC1 images are widened with an opaque alpha block.
+void TextureLoader::convertLayer(StreamJob& job) {
+    ScopedCPUZone cpuZone("TextureLoader::convertLayer");
+    bool bCompressed = !job.compressedImages.empty();
+    int width = bCompressed ? job.compressedImages.front().width : job.images.front().width;
+    int height = bCompressed ? job.compressedImages.front().height : job.images.front().height;
+    job.bValid = width == job.layerWidth and height == job.layerHeight;
+    if (job.bValid and bCompressed) {
+        const auto& texture = job.compressedImages.front();
+        const std::byte opaqueAlphaBlock[8] = {std::byte{255}, std::byte{255}};
+        for (std::size_t level = 0; level < texture.levelData.size(); level++) {
+            const std::byte* levelData = texture.levelData[level];
+            if (texture.format == CompressedFormat::BC3) {
+                job.layerLevels.emplace_back(levelData, levelData + texture.levelSizes[level]);
+                continue;
+            }
+            std::vector<std::byte> layerLevel(2 * texture.levelSizes[level]);
+            for (std::size_t block = 0; block < texture.levelSizes[level] / 8; block++) {
+                std::memcpy(layerLevel.data() + 16 * block, opaqueAlphaBlock, 8);
+                std::memcpy(layerLevel.data() + 16 * block + 8, levelData + 8 * block, 8);
+            }
+            job.layerLevels.push_back(std::move(layerLevel));
+        }
+    } else if (job.bValid and job.bCompressedLayer) {
+        const auto& image = job.images.front();
+        for (std::size_t level = 0; level < image.levels.size(); level++) {
+            int levelWidth = std::max(width >> level, 1), levelHeight = std::max(height >> level, 1);
+            std::vector<std::byte> layerLevel(TextureCompressor::getCompressedSize(CompressedFormat::BC3, levelWidth, levelHeight));
+            TextureCompressor::compress(CompressedFormat::BC3, image.levels[level].data(), levelWidth, levelHeight, layerLevel.data());
+            job.layerLevels.push_back(std::move(layerLevel));
+        }
+    } else if (job.bValid) {
+        job.layerLevels = std::move(job.images.front().levels);
+    }
+    job.images.clear();
+    job.compressedImages.clear();
+}
+
+// Runs the function on the entry of the job's texture under its shard lock
+template<typename Function>
+bool TextureLoader::updateJobEntry(const StreamJob& job, Function function) {
+    if (job.target == GL_TEXTURE_2D) {
+        return TextureLoader::texture2DMap.updateIfPresent(job.textureNames[0], function);
+    } else if (job.target == GL_TEXTURE_2D_ARRAY) {
+        return TextureLoader::textureLayerMap.updateIfPresent(job.textureNames[0], function);
+    }
+    return TextureLoader::textureCubeMapMap.updateIfPresent(job.textureNames, function);
+}
+
+bool TextureLoader::isJobPending(const std::shared_ptr<StreamJob>& job) {
+    bool bPending = false;
+    TextureLoader::updateJobEntry(*job, [&job, &bPending](TextureEntry& entry) {
+        bPending = entry.job == job;
+    });
+    return bPending;
+}
+
+void TextureLoader::startUploads(std::size_t uploadBudget) {
+    std::size_t uploadedBytes = 0;
+    while (true) {
+        std::shared_ptr<StreamJob> job;
+        {
+            std::lock_guard lock(TextureLoader::decodedMutex);
+            if (TextureLoader::decodedJobs.empty()) {
+                break;
+            }
+            job = TextureLoader::decodedJobs.front();
+            std::size_t jobBytes = 0;
+            for (const auto& image: job->images) {
+                for (const auto& level: image.levels) {
+                    jobBytes += level.size();
+                }
+            }
+            for (const auto& compressedImage: job->compressedImages) {
+                jobBytes += compressedImage.getSize();
+            }
+            for (const auto& level: job->layerLevels) {
+                jobBytes += level.size();
+            }
+            if (uploadedBytes > 0 and jobBytes > uploadBudget - uploadedBytes) {
+                break;
+            }
+            uploadedBytes += jobBytes;
+            TextureLoader::decodedJobs.pop_front();
+        }
+        if (!TextureLoader::isJobPending(job)) {
+            continue;
+        }
+        if (job->bValid) {
+            TextureLoader::uploadJob(*job);
+            TextureLoader::uploadingJobs.push_back(job);
+        } else {
+            TextureLoader::finishJob(job);
+        }
+    }
+}
+
+void TextureLoader::finishUploads(bool bWait) {
+    std::vector<std::shared_ptr<StreamJob>> finishedJobs;
+    auto it = TextureLoader::uploadingJobs.begin();
+    while (it != TextureLoader::uploadingJobs.end()) {
+        auto& job = *it;
+        GLenum waitResult = glClientWaitSync(job->fence, 0, 0);
+        while (bWait and waitResult == GL_TIMEOUT_EXPIRED) {
+            waitResult = glClientWaitSync(job->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        }
+        if (waitResult == GL_ALREADY_SIGNALED or waitResult == GL_CONDITION_SATISFIED or waitResult == GL_WAIT_FAILED) {
+            finishedJobs.push_back(job);
+            it = TextureLoader::uploadingJobs.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (auto& job: finishedJobs) {
+        if (!TextureLoader::finishJob(job)) {
+            glDeleteTextures(1, &job->textureId);
+        }
+    }
+}
+
+// The images are copied into a pixel buffer object, so glTexImage2D returns
+// without copying and the driver transfers them asynchronously. Every mip
+// level is specified explicitly, nothing is left to glGenerateMipmap.
+void TextureLoader::uploadJob(StreamJob& job) {
+    ScopedCPUZone cpuZone("TextureLoader::uploadJob");
+    std::vector<std::pair<const std::byte*, std::size_t>> stagedData;
+    for (const auto& image: job.images) {
+        for (const auto& level: image.levels) {
+            stagedData.emplace_back(level.data(), level.size());
+        }
+    }
+    for (const auto& compressedImage: job.compressedImages) {
+        for (std::size_t level = 0; level < compressedImage.levelData.size(); level++) {
+            stagedData.emplace_back(compressedImage.levelData[level], compressedImage.levelSizes[level]);
+        }
     }
-    if (bValid) {
+    for (const auto& level: job.layerLevels) {
+        stagedData.emplace_back(level.data(), level.size());
+    }
+    std::vector<std::size_t> stagedOffsets;
+    std::size_t totalSize = 0;
+    for (const auto& [data, size]: stagedData) {
+        stagedOffsets.push_back(totalSize);
+        totalSize += size;
+    }
+    // Layers are accounted for with their array
+    job.numBytes = job.target == GL_TEXTURE_2D_ARRAY ? 0 : totalSize;
+    glGenBuffers(1, &job.pixelBuffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, job.pixelBuffer);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, totalSize, nullptr, GL_STREAM_DRAW);
+    auto mappedBuffer = static_cast<std::byte*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, totalSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    for (std::size_t i = 0; i < stagedData.size(); i++) {
+        if (mappedBuffer) {
+            std::memcpy(mappedBuffer + stagedOffsets[i], stagedData[i].first, stagedData[i].second);
+        } else {
+            glBufferSubData(GL_PIXEL_UNPACK_BUFFER, stagedOffsets[i], stagedData[i].second, stagedData[i].first);
+        }
+    }
+    if (mappedBuffer) {
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+
+    if (job.target == GL_TEXTURE_2D_ARRAY) {
         GLint currentBoundTexture = 0;
-        glGetIntegerv(GL_TEXTURE_BINDING_CUBE_MAP, &currentBoundTexture);
-        GLuint textureId;
-        glGenTextures(1, &textureId);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, textureId);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        GLint imageFormat = bSRGBA ? GL_SRGB_ALPHA : GL_RGBA;
-        for (int i = 0; i < 6; i++) {
-            int width, height;
-            auto imageData = getImageData(textureKey[i], width, height);
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, imageFormat, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, imageData.data());
+        glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &currentBoundTexture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, TextureLoader::textureArrays[job.textureArray].textureId);
+        GLenum compressedFormat = job.bSRGBA ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        for (std::size_t level = 0; level < job.layerLevels.size(); level++) {
+            GLsizei levelWidth = std::max(job.layerWidth >> level, 1), levelHeight = std::max(job.layerHeight >> level, 1);
+            if (job.bCompressedLayer) {
+                glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, job.layer, levelWidth, levelHeight, 1, compressedFormat,
+                                          stagedData[level].second, reinterpret_cast<void*>(stagedOffsets[level]));
+            } else {
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, job.layer, levelWidth, levelHeight, 1,
+                                GL_RGBA, GL_UNSIGNED_BYTE, reinterpret_cast<void*>(stagedOffsets[level]));
+            }
         }
-        glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
-        TextureLoader::textureCubeMapMap[textureKey] = textureId;
-        glBindTexture(GL_TEXTURE_CUBE_MAP, currentBoundTexture);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, currentBoundTexture);
+        job.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        job.layerLevels.clear();
+        job.layerLevels.shrink_to_fit();
+        return;
+    }
+
+    GLint currentBoundTexture = 0;
+    glGetIntegerv(job.target == GL_TEXTURE_2D ? GL_TEXTURE_BINDING_2D : GL_TEXTURE_BINDING_CUBE_MAP, &currentBoundTexture);
+    glGenTextures(1, &job.textureId);
+    glBindTexture(job.target, job.textureId);
+    glTexParameteri(job.target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(job.target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    if (job.target == GL_TEXTURE_CUBE_MAP) {
+        glTexParameteri(job.target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    }
+    glTexParameteri(job.target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(job.target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    auto getImageTarget = [&job](std::size_t face) {
+        return job.target == GL_TEXTURE_2D ? GL_TEXTURE_2D : static_cast<GLenum>(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face);
+    };
+    std::size_t stagedIndex = 0;
+    if (!job.compressedImages.empty()) {
+        for (std::size_t face = 0; face < job.compressedImages.size(); face++) {
+            const auto& compressedImage = job.compressedImages[face];
+            GLenum internalFormat = compressedImage.getInternalFormat(job.bSRGBA);
+            for (std::size_t level = 0; level < compressedImage.levelData.size(); level++, stagedIndex++) {
+                glCompressedTexImage2D(getImageTarget(face), level, internalFormat,
+                                       std::max(compressedImage.width >> level, 1), std::max(compressedImage.height >> level, 1), 0,
+                                       stagedData[stagedIndex].second, reinterpret_cast<void*>(stagedOffsets[stagedIndex]));
+            }
+        }
+        glTexParameteri(job.target, GL_TEXTURE_MAX_LEVEL, job.compressedImages.front().levelData.size() - 1);
     } else {
-        TextureLoader::textureCubeMapMap[textureKey] = 0;
+        GLint imageFormat = job.bSRGBA ? GL_SRGB_ALPHA : GL_RGBA;
+        for (std::size_t face = 0; face < job.images.size(); face++) {
+            const auto& image = job.images[face];
+            for (std::size_t level = 0; level < image.levels.size(); level++, stagedIndex++) {
+                glTexImage2D(getImageTarget(face), level, imageFormat, std::max(image.width >> level, 1), std::max(image.height >> level, 1), 0,
+                             GL_RGBA, GL_UNSIGNED_BYTE, reinterpret_cast<void*>(stagedOffsets[stagedIndex]));
+            }
+        }
+        glTexParameteri(job.target, GL_TEXTURE_MAX_LEVEL, job.images.front().levels.size() - 1);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glBindTexture(job.target, currentBoundTexture);
+    job.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    job.images.clear();
+    job.images.shrink_to_fit();
+    job.compressedImages.clear();
+}
+
+// Returns false if the texture was freed while its job was in flight
+bool TextureLoader::finishJob(const std::shared_ptr<StreamJob>& job) {
+    TextureLoader::deleteStagingData(*job);
+    std::vector<Callback> callbacks;
+    bool bCurrent = false;
+    auto makeResident = [&job, &callbacks, &bCurrent](TextureEntry& entry) {
+        if (entry.job != job) {
+            return;
+        }
+        entry.textureId = job->textureId;
+        entry.bResident = true;
+        entry.numBytes = job->numBytes;
+        entry.lastUsedFrame = TextureLoader::frameNumber;
+        entry.job.reset();
+        callbacks = entry.callbacks;
+        bCurrent = true;
+    };
+    TextureLoader::updateJobEntry(*job, makeResident);
+    if (!bCurrent) {
+        return false;
+    }
+    TextureLoader::numPending--;
+    TextureLoader::residentBytes += job->numBytes;
+    TextureLoader::numResident++;
+    double loadTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - job->requestTime).count();
+    TextureLoader::numLoads++;
+    TextureLoader::totalLoadTime += loadTime;
+    TextureLoader::maxLoadTime = std::max(TextureLoader::maxLoadTime, loadTime);
+    for (auto& callback: callbacks) {
+        callback(job->textureId);
+    }
+    return true;
+}
+
+void TextureLoader::deleteStagingData(StreamJob& job) {
+    if (job.fence) {
+        glDeleteSync(job.fence);
+        job.fence = nullptr;
+    }
+    if (job.pixelBuffer) {
+        glDeleteBuffers(1, &job.pixelBuffer);
+        job.pixelBuffer = 0;
+    }
+}
+
+// Callbacks of requests for textures that were already resident
+void TextureLoader::runReadyCallbacks() {
+    std::vector<std::pair<Callback, GLuint>> callbacks;
+    {
+        std::lock_guard lock(TextureLoader::decodedMutex);
+        callbacks.swap(TextureLoader::readyCallbacks);
+    }
+    for (auto& [callback, textureId]: callbacks) {
+        callback(textureId);
+    }
+}
+
+// Placeholders are a single mid grey texel, bound until the real texture is resident
+GLuint TextureLoader::getPlaceholder(GLenum target) {
+    GLuint& placeholder = target == GL_TEXTURE_2D ? TextureLoader::placeholder2D : TextureLoader::placeholderCubeMap;
+    if (placeholder) {
+        return placeholder;
+    }
+    const GLubyte texel[4] = {128, 128, 128, 255};
+    GLint currentBoundTexture = 0;
+    glGetIntegerv(target == GL_TEXTURE_2D ? GL_TEXTURE_BINDING_2D : GL_TEXTURE_BINDING_CUBE_MAP, &currentBoundTexture);
+    glGenTextures(1, &placeholder);
+    glBindTexture(target, placeholder);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    if (target == GL_TEXTURE_2D) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+    } else {
+        for (int i = 0; i < 6; i++) {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+        }
     }
-    std::filesystem::current_path(currentPath);
+    glBindTexture(target, currentBoundTexture);
+    return placeholder;
 }
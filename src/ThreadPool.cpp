@@ -0,0 +1,106 @@
+#include "ThreadPool.hpp"
+#include "CPUProfiler.hpp"
+
+#include <algorithm>
+#include <string>
+
+std::mutex ThreadPool::queueMutex;
+std::condition_variable ThreadPool::queueCondition;
+std::queue<std::function<void()>> ThreadPool::tasks;
+std::vector<std::thread> ThreadPool::workers;
+bool ThreadPool::bStopping = false;
+
+// One thread is left for the main thread, which also takes part in parallelFor
+void ThreadPool::initialize(unsigned numThreads) {
+    std::lock_guard lock(ThreadPool::queueMutex);
+    if (!ThreadPool::workers.empty()) {
+        return;
+    }
+    if (!numThreads) {
+        numThreads = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    }
+    ThreadPool::bStopping = false;
+    for (unsigned i = 0; i < numThreads; i++) {
+        ThreadPool::workers.emplace_back(ThreadPool::workerLoop, i);
+    }
+}
+
+unsigned ThreadPool::getNumThreads() {
+    std::lock_guard lock(ThreadPool::queueMutex);
+    return ThreadPool::workers.size();
+}
+
+void ThreadPool::enqueue(std::function<void()> task) {
+    ThreadPool::initialize();
+    {
+        std::lock_guard lock(ThreadPool::queueMutex);
+        ThreadPool::tasks.push(std::move(task));
+    }
+    ThreadPool::queueCondition.notify_one();
+}
+
+void ThreadPool::workerLoop(unsigned workerIndex) {
+    CPUProfiler::setThreadName("worker " + std::to_string(workerIndex));
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(ThreadPool::queueMutex);
+            ThreadPool::queueCondition.wait(lock, []() {
+                return ThreadPool::bStopping or !ThreadPool::tasks.empty();
+            });
+            if (ThreadPool::tasks.empty()) {
+                return;
+            }
+            task = std::move(ThreadPool::tasks.front());
+            ThreadPool::tasks.pop();
+        }
+        task();
+    }
+}
+
+void ThreadPool::runRange(ParallelRange& range) {
+    std::size_t index;
+    while ((index = range.nextIndex.fetch_add(1)) < range.count) {
+        (*range.function)(index);
+        if (range.numFinished.fetch_add(1) + 1 == range.count) {
+            std::lock_guard lock(range.mutex);
+            range.finished.notify_all();
+        }
+    }
+}
+
+// Indices are claimed one at a time from a shared counter. Helpers that only
+// get to run after the range was used up return immediately, so the caller
+// only ever waits for calls that are already executing on other threads.
+void ThreadPool::parallelFor(std::size_t count, const std::function<void(std::size_t)>& function) {
+    if (count == 0) {
+        return;
+    }
+    auto range = std::make_shared<ParallelRange>();
+    range->count = count;
+    range->function = &function;
+    ThreadPool::initialize();
+    std::size_t numHelpers = std::min<std::size_t>(count - 1, ThreadPool::getNumThreads());
+    for (std::size_t i = 0; i < numHelpers; i++) {
+        ThreadPool::enqueue([range]() {
+            ThreadPool::runRange(*range);
+        });
+    }
+    ThreadPool::runRange(*range);
+    std::unique_lock lock(range->mutex);
+    range->finished.wait(lock, [&range]() {
+        return range->numFinished.load() == range->count;
+    });
+}
+
+void ThreadPool::terminate() {
+    {
+        std::lock_guard lock(ThreadPool::queueMutex);
+        ThreadPool::bStopping = true;
+    }
+    ThreadPool::queueCondition.notify_all();
+    for (auto& worker: ThreadPool::workers) {
+        worker.join();
+    }
+    ThreadPool::workers.clear();
+}
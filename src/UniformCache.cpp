@@ -0,0 +1,123 @@
+#include "UniformCache.hpp"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <vector>
+
+std::unordered_map<GLuint, std::unordered_map<std::string, GLint>> UniformCache::programUniforms;
+
+void UniformCache::reflectProgram(GLuint program) {
+    auto& uniforms = UniformCache::programUniforms[program];
+    uniforms.clear();
+    GLint numUniforms = 0, maxNameLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &numUniforms);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+    std::vector<GLchar> nameBuffer(maxNameLength + 1);
+    for (GLint i = 0; i < numUniforms; i++) {
+        GLsizei nameLength = 0;
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(program, i, nameBuffer.size(), &nameLength, &size, &type, nameBuffer.data());
+        std::string uniformName(nameBuffer.data(), nameLength);
+        GLint location = glGetUniformLocation(program, uniformName.c_str());
+        if (location < 0) {
+            // Members of uniform blocks have no location
+            continue;
+        }
+        uniforms[uniformName] = location;
+        // Arrays are reported as "name[0]" but are usually referred to by name alone
+        if (uniformName.size() > 3 and uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0) {
+            uniforms[uniformName.substr(0, uniformName.size() - 3)] = location;
+        }
+    }
+}
+
+void UniformCache::forgetProgram(GLuint program) {
+    UniformCache::programUniforms.erase(program);
+}
+
+// Elements of arrays other than the first are not reflected, those are
+// queried once and remembered.
+GLint UniformCache::getLocation(GLuint program, const std::string& uniformName) {
+    if (UniformCache::programUniforms.find(program) == UniformCache::programUniforms.end()) {
+        UniformCache::reflectProgram(program);
+    }
+    auto& uniforms = UniformCache::programUniforms[program];
+    auto it = uniforms.find(uniformName);
+    if (it != uniforms.end()) {
+        return it->second;
+    }
+    GLint location = glGetUniformLocation(program, uniformName.c_str());
+    uniforms[uniformName] = location;
+    return location;
+}
+
+template <>
+void Uniform<GLint>::set(const GLint& value) const {
+    glUniform1i(this->location, value);
+}
+
+template <>
+void Uniform<GLint>::set(const GLint* values, GLsizei count) const {
+    glUniform1iv(this->location, count, values);
+}
+
+template <>
+void Uniform<GLfloat>::set(const GLfloat& value) const {
+    glUniform1f(this->location, value);
+}
+
+template <>
+void Uniform<GLfloat>::set(const GLfloat* values, GLsizei count) const {
+    glUniform1fv(this->location, count, values);
+}
+
+template <>
+void Uniform<glm::vec2>::set(const glm::vec2& value) const {
+    glUniform2fv(this->location, 1, glm::value_ptr(value));
+}
+
+template <>
+void Uniform<glm::vec2>::set(const glm::vec2* values, GLsizei count) const {
+    glUniform2fv(this->location, count, reinterpret_cast<const GLfloat*>(values));
+}
+
+template <>
+void Uniform<glm::vec3>::set(const glm::vec3& value) const {
+    glUniform3fv(this->location, 1, glm::value_ptr(value));
+}
+
+template <>
+void Uniform<glm::vec3>::set(const glm::vec3* values, GLsizei count) const {
+    glUniform3fv(this->location, count, reinterpret_cast<const GLfloat*>(values));
+}
+
+template <>
+void Uniform<glm::vec4>::set(const glm::vec4& value) const {
+    glUniform4fv(this->location, 1, glm::value_ptr(value));
+}
+
+template <>
+void Uniform<glm::vec4>::set(const glm::vec4* values, GLsizei count) const {
+    glUniform4fv(this->location, count, reinterpret_cast<const GLfloat*>(values));
+}
+
+template <>
+void Uniform<glm::mat3>::set(const glm::mat3& value) const {
+    glUniformMatrix3fv(this->location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+template <>
+void Uniform<glm::mat3>::set(const glm::mat3* values, GLsizei count) const {
+    glUniformMatrix3fv(this->location, count, GL_FALSE, reinterpret_cast<const GLfloat*>(values));
+}
+
+template <>
+void Uniform<glm::mat4>::set(const glm::mat4& value) const {
+    glUniformMatrix4fv(this->location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+template <>
+void Uniform<glm::mat4>::set(const glm::mat4* values, GLsizei count) const {
+    glUniformMatrix4fv(this->location, count, GL_FALSE, reinterpret_cast<const GLfloat*>(values));
+}
@@ -1,83 +1,134 @@
 ﻿#include "glad.h"
 
+#include "Benchmark.hpp"
 #include "Camera.hpp"
 #include "CameraManager.hpp"
+#include "CPUProfiler.hpp"
+#include "FrameRingBuffer.hpp"
+#include "FrustumCuller.hpp"
+#include "GPUProfiler.hpp"
+#include "GeometryArena.hpp"
+#include "LightClusters.hpp"
+#include "LightStorage.hpp"
 #include "Lights.hpp"
+#include "MeshCache.hpp"
+#include "ModelLoader.hpp"
+#include "ProgramCache.hpp"
+#include "ProgramPermutations.hpp"
 #include "RandomSampler.hpp"
+#include "ShaderReloader.hpp"
+#include "TextureCache.hpp"
 #include "TextureLoader.hpp"
+#include "ThreadPool.hpp"
+#include "UniformCache.hpp"
 
 #include <GLFW/glfw3.h>
-#include <assimp/postprocess.h>
-#include <assimp/scene.h>
-#include <assimp/Importer.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/string_cast.hpp>
 
-#include <fstream>
+#include <climits>
+#include <cstdlib>
 #include <iostream>
-#include <regex>
 
-struct Material {
-    std::string diffuseMap;
-    std::string specularMap;
-    float shininess;
+// Uniforms used while drawing, resolved once per program after linking
+
+struct LitUniforms {
+    Uniform<GLfloat> time;
+    Uniform<glm::vec3> cameraPos;
+    Uniform<GLfloat> pointLightMinSampleSizes;
+    Uniform<GLfloat> pointLightMaxSampleSizes;
+    Uniform<GLfloat> spotLightMinSampleSizes;
+    Uniform<GLfloat> spotLightMaxSampleSizes;
+    Uniform<GLfloat> dirLightSampleSizes;
+    Uniform<glm::vec4> dirLightCascadeNearDepths;
+    Uniform<glm::vec4> dirLightCascadeFarDepths;
+    Uniform<GLint> dirLightNumCascades;
+    Uniform<glm::vec4> clusterScale;
+    Uniform<glm::vec2> clusterDepthRange;
+
+    explicit LitUniforms(GLuint program)
+        : time(program, "time"),
+          cameraPos(program, "cameraPos"),
+          pointLightMinSampleSizes(program, "pointLightMinSampleSizes"),
+          pointLightMaxSampleSizes(program, "pointLightMaxSampleSizes"),
+          spotLightMinSampleSizes(program, "spotLightMinSampleSizes"),
+          spotLightMaxSampleSizes(program, "spotLightMaxSampleSizes"),
+          dirLightSampleSizes(program, "dirLightSampleSizes"),
+          dirLightCascadeNearDepths(program, "dirLightCascadeNearDepths"),
+          dirLightCascadeFarDepths(program, "dirLightCascadeFarDepths"),
+          dirLightNumCascades(program, "dirLightNumCascades"),
+          clusterScale(program, "clusterScale"),
+          clusterDepthRange(program, "clusterDepthRange") {}
 };
 
-bool operator==(const Material& m1, const Material& m2) {
-    return m1.diffuseMap == m2.diffuseMap and m1.specularMap == m2.specularMap and m1.shininess == m2.shininess;
-}
+// Light counts compiled into the lit programs, compared every frame and only
+// turned into defines when their variant is first built
+struct LightingPermutation {
+    int numPointLights;
+    int numSpotLights;
+    int numDirLights;
+    int numDirLightCascades;
+    bool bShadows;
+
+    bool operator==(const LightingPermutation& other) const {
+        return this->numPointLights == other.numPointLights and this->numSpotLights == other.numSpotLights and
+               this->numDirLights == other.numDirLights and this->numDirLightCascades == other.numDirLightCascades and
+               this->bShadows == other.bShadows;
+    }
 
-bool operator!=(const Material& m1, const Material& m2) {
-    return m1.diffuseMap != m2.diffuseMap or m1.specularMap != m2.specularMap or m1.shininess != m2.shininess;
-}
+    ShaderDefines getShaderDefines() const {
+        return {
+            {"NUM_POINT_LIGHTS", std::to_string(this->numPointLights)},
+            {"NUM_SPOT_LIGHTS", std::to_string(this->numSpotLights)},
+            {"NUM_DIR_LIGHTS", std::to_string(this->numDirLights)},
+            {"NUM_DIR_LIGHT_CASCADES", std::to_string(this->numDirLightCascades)},
+            {"SHADOWS", this->bShadows ? "1" : "0"},
+        };
+    }
+};
 
-struct MeshData {
-    std::vector<GLfloat> vertexData;
-    std::vector<GLuint> vertexIndices;
-    Material meshMaterial;
+struct LampUniforms {
+    Uniform<glm::mat4> model;
+    Uniform<glm::vec3> lightColor;
+
+    explicit LampUniforms(GLuint program) : model(program, "model"), lightColor(program, "lightColor") {}
 };
 
-void debugFunction(GLenum, GLenum, GLuint, GLenum severity, GLsizei, const GLchar* message, const void*) {
-    if (severity != GL_DEBUG_SEVERITY_NOTIFICATION) {
-        std::printf("%s\n", message);
-    }
-}
+struct ShadowUniforms {
+    Uniform<GLint> numLayers;
+    Uniform<glm::mat4> lightTransforms;
 
-std::string loadShaderSource(std::filesystem::path filePath) {
-    std::ifstream is(filePath, std::ios::binary);
-    if (!is) {
-        return "";
-    }
-    auto fileSize = std::filesystem::file_size(filePath);
-    std::string fileContents(fileSize, ' ');
-    is.read(fileContents.data(), fileSize);
-    std::regex includeRegex(R"(#include *"(.+)\")");
-    std::smatch regex_matches;
-    while (std::regex_search(fileContents, regex_matches, includeRegex)) {
-        fileContents.replace(regex_matches[0].first, regex_matches[0].second, loadShaderSource("assets/shaders/" + regex_matches[1].str()));
-    }
-    return fileContents;
-}
+    explicit ShadowUniforms(GLuint program) : numLayers(program, "numLayers"), lightTransforms(program, "lightTransforms") {}
+};
 
-GLuint createShader(GLenum shaderType, const std::string& shaderSource) {
-    const char* shaderSourceCStr = shaderSource.c_str();
-    GLuint shader = glCreateShader(shaderType);
-    glShaderSource(shader, 1, &shaderSourceCStr, nullptr);
-    glCompileShader(shader);
-    return shader;
-}
+struct SkyboxUniforms {
+    Uniform<glm::mat4> view;
+    Uniform<glm::mat4> projection;
 
-GLuint createProgram(const std::vector<GLuint>& shaders) {
-    GLuint program = glCreateProgram();
-    for (auto& shader: shaders) {
-        glAttachShader(program, shader);
-    }
-    glLinkProgram(program);
-    for (auto& shader: shaders) {
-        glDetachShader(program, shader);
+    explicit SkyboxUniforms(GLuint program) : view(program, "view"), projection(program, "projection") {}
+};
+
+struct BlurUniforms {
+    Uniform<GLint> inputFrame;
+    Uniform<GLint> filterWidth;
+    Uniform<GLint> bHorizontal;
+    Uniform<GLfloat> stride;
+
+    explicit BlurUniforms(GLuint program) : inputFrame(program, "inputFrame"), filterWidth(program, "filterWidth"), bHorizontal(program, "bHorizontal"), stride(program, "stride") {}
+};
+
+struct ProfilerUniforms {
+    Uniform<glm::vec4> rect;
+    Uniform<glm::vec4> barColor;
+
+    explicit ProfilerUniforms(GLuint program) : rect(program, "rect"), barColor(program, "barColor") {}
+};
+
+void debugFunction(GLenum, GLenum, GLuint, GLenum severity, GLsizei, const GLchar* message, const void*) {
+    if (severity != GL_DEBUG_SEVERITY_NOTIFICATION) {
+        std::printf("%s\n", message);
     }
-    return program;
 }
 
 template <typename S1, typename S2>
@@ -90,24 +141,16 @@ void storeData(const S1& vertexData, const S2& vertexIndices, GLuint VBO, GLuint
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * vertexIndices.size(), vertexIndices.data(), GL_STATIC_DRAW);
 }
 
-void setupModel(GLuint VAO, GLuint VBO, GLuint EBO) {
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), nullptr);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), reinterpret_cast<void*>(3 * sizeof(GLfloat)));
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), reinterpret_cast<void*>(6 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(1);
-    glEnableVertexAttribArray(2);
-}
-
-void setupLamp(GLuint VAO, GLuint VBO, GLuint EBO) {
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), nullptr);
-    glEnableVertexAttribArray(0);
+std::vector<GLfloat> packInstanceData(const std::vector<std::pair<glm::mat4, glm::mat3>>& matrices, const std::vector<glm::vec3>& materials) {
+    std::vector<GLfloat> instanceData;
+    instanceData.reserve(matrices.size() * InstanceAttributes::INSTANCE_SIZE);
+    for (std::size_t i = 0; i < matrices.size(); i++) {
+        const auto& [model, normal] = matrices[i];
+        instanceData.insert(instanceData.end(), glm::value_ptr(model), glm::value_ptr(model) + 16);
+        instanceData.insert(instanceData.end(), glm::value_ptr(normal), glm::value_ptr(normal) + 9);
+        instanceData.insert(instanceData.end(), glm::value_ptr(materials[i]), glm::value_ptr(materials[i]) + 3);
+    }
+    return instanceData;
 }
 
 void setupRenderRect(GLuint VAO, GLuint VBO, GLuint EBO) {
@@ -120,98 +163,49 @@ void setupRenderRect(GLuint VAO, GLuint VBO, GLuint EBO) {
     glEnableVertexAttribArray(1);
 }
 
-void setShaderMatrial(GLuint shaderProgram, const Material& material) {
+// The attributes select the layers and go into the instance data, the
+// arrays holding the layers are bound for the draw
+struct MaterialLayers {
+    glm::vec3 attributes;
+    GLint diffuseArray;
+    GLint specularArray;
+};
+
+// Material textures are layers of one texture array per image size and color
+// space. Draws of materials sharing the arrays bind them once and select
+// their own layers.
+void bindMaterialTextures(const MaterialLayers& materialLayers) {
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, TextureLoader::getTextureId2D(material.diffuseMap));
+    glBindTexture(GL_TEXTURE_2D_ARRAY, TextureLoader::getTextureArrayId(materialLayers.diffuseArray));
     glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, TextureLoader::getTextureId2D(material.specularMap, false));
-    glUniform1f(glGetUniformLocation(shaderProgram, "material.shininess"), material.shininess);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, TextureLoader::getTextureArrayId(materialLayers.specularArray));
 }
 
-void setModelUniforms(GLuint shaderProgram, const glm::mat4& model, const glm::mat3& normal) {
-    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix3fv(glGetUniformLocation(shaderProgram, "normal"), 1, GL_FALSE, glm::value_ptr(normal));
+bool hasSameArrays(const MaterialLayers& m1, const MaterialLayers& m2) {
+    return m1.diffuseArray == m2.diffuseArray and m1.specularArray == m2.specularArray;
 }
 
-void setLampUniforms(GLuint shaderProgram, const glm::mat4& model, const glm::vec3& lightColor) {
-    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    glUniform3fv(glGetUniformLocation(shaderProgram, "lightColor"), 1, glm::value_ptr(lightColor));
+MaterialLayers getMaterialLayers(const Material& material) {
+    auto diffuseLayer = TextureLoader::getTextureLayer(material.diffuseMap);
+    auto specularLayer = TextureLoader::getTextureLayer(material.specularMap, false);
+    return {{diffuseLayer.layer, specularLayer.layer, material.shininess}, diffuseLayer.textureArray, specularLayer.textureArray};
 }
 
-std::vector<MeshData> loadModelData(const std::string& modelPath) {
-    if (!std::filesystem::exists(modelPath)) {
-        return {};
+// Objects drawn without an instance buffer get their matrices and material
+// from the current values of the instance attributes
+void setModelAttributes(const glm::mat4& model, const glm::mat3& normal, const glm::vec3& material) {
+    for (int i = 0; i < 4; i++) {
+        glVertexAttrib4fv(3 + i, glm::value_ptr(model[i]));
     }
-    Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(modelPath.c_str(), aiProcess_JoinIdenticalVertices | aiProcess_Triangulate);
-    if (!scene) {
-        return {};
+    for (int i = 0; i < 3; i++) {
+        glVertexAttrib3fv(7 + i, glm::value_ptr(normal[i]));
     }
-    std::vector<MeshData> meshes;
-    for (std::size_t i = 0; i < scene->mNumMeshes; i++) {
-        MeshData newMeshData;
-        auto mesh = scene->mMeshes[i];
-        auto meshMaterial = scene->mMaterials[mesh->mMaterialIndex];
-        for (std::size_t j = 0; j < mesh->mNumVertices; j++) {
-            newMeshData.vertexData.push_back(mesh->mVertices[j].x);
-            newMeshData.vertexData.push_back(mesh->mVertices[j].y);
-            newMeshData.vertexData.push_back(mesh->mVertices[j].z);
-            if (mesh->HasNormals()) {
-                newMeshData.vertexData.push_back(mesh->mNormals[j].x);
-                newMeshData.vertexData.push_back(mesh->mNormals[j].y);
-                newMeshData.vertexData.push_back(mesh->mNormals[j].z);
-            } else {
-                newMeshData.vertexData.push_back(0.0f);
-                newMeshData.vertexData.push_back(0.0f);
-                newMeshData.vertexData.push_back(0.0f);
-            }
-            if (mesh->HasTextureCoords(0)) {
-                newMeshData.vertexData.push_back(mesh->mTextureCoords[0][j].x);
-                newMeshData.vertexData.push_back(mesh->mTextureCoords[0][j].y);
-            } else {
-                newMeshData.vertexData.push_back(0.0f);
-                newMeshData.vertexData.push_back(0.0f);
-            }
-        }
-        for (std::size_t j = 0; j < mesh->mNumFaces; j++) {
-            auto face = mesh->mFaces[j];
-            for (std::size_t k = 0; k < face.mNumIndices; k++) {
-                newMeshData.vertexIndices.push_back(face.mIndices[k]);
-            }
-        }
-        aiString diffuseTexture;
-        aiString specularTexture;
-        meshMaterial->GetTexture(aiTextureType_DIFFUSE, 0, &diffuseTexture);
-        meshMaterial->GetTexture(aiTextureType_SPECULAR, 0, &specularTexture);
-        newMeshData.meshMaterial.diffuseMap = diffuseTexture.C_Str();
-        newMeshData.meshMaterial.specularMap = specularTexture.C_Str();
-        newMeshData.meshMaterial.shininess = 128.0f;
-        meshes.push_back(std::move(newMeshData));
-    }
-    return meshes;
-}
-
-void copyLightColor(std::byte* dst, const LightCommon& light) {
-    std::memcpy(dst + 00, glm::value_ptr(light.ambient), 12);
-    std::memcpy(dst + 16, glm::value_ptr(light.diffuse), 12);
-    std::memcpy(dst + 32, glm::value_ptr(light.specular), 12);
-}
-
-void copyLightRadius(std::byte* dst, const PointLight& light) {
-    std::memcpy(dst, &light.radius, 4);
-}
-
-void copyLightPosition(std::byte* dst, const PointLight& light) {
-    std::memcpy(dst, glm::value_ptr(light.position), 12);
-}
-
-void copyLightDirection(std::byte* dst, const DirectionalLight& light) {
-    std::memcpy(dst, glm::value_ptr(light.direction), 12);
+    glVertexAttrib3fv(10, glm::value_ptr(material));
 }
 
-void copyLightAngle(std::byte* dst, const SpotLight& light) {
-    std::memcpy(dst + 0, &light.innerAngleCos, 4);
-    std::memcpy(dst + 4, &light.outerAngleCos, 4);
+void setLampUniforms(const LampUniforms& uniforms, const glm::mat4& model, const glm::vec3& lightColor) {
+    uniforms.model.set(model);
+    uniforms.lightColor.set(lightColor);
 }
 
 void calculatePyramidMatrices(int w, int h, float dX, float dY, std::vector<std::pair<glm::mat4, glm::mat3>>& matrices) {
@@ -279,7 +273,7 @@ void calculateDirectionalLightMatrices(const std::vector<DirectionalLight>& ligh
     }
 }
 
-void setupWindows(std::vector<std::tuple<glm::mat4, glm::mat3, Material>>& windows, float distX, float distY, const Material& windowMaterial) {
+void setupWindows(std::vector<std::tuple<glm::mat4, glm::mat3, MaterialLayers>>& windows, float distX, float distY, const MaterialLayers& windowMaterial) {
     constexpr std::array<glm::vec3, 4> points = {
         glm::vec3{-1.0f, 1.0f, 0.0f},
         glm::vec3{1.0f, 1.0f, 0.0f},
@@ -309,7 +303,7 @@ void setupWindows(std::vector<std::tuple<glm::mat4, glm::mat3, Material>>& windo
     }
 }
 
-void setupGrass(std::vector<std::tuple<glm::mat4, glm::mat3, Material>>& grass, float distX, float distY, const Material& grassMaterial) {
+void setupGrass(std::vector<std::tuple<glm::mat4, glm::mat3, MaterialLayers>>& grass, float distX, float distY, const MaterialLayers& grassMaterial) {
     float radius = std::sqrt(distX * distX + distY * distY) + 1.0f;
     int numGrassTufts = std::floor(glm::radians(360.0f) * radius);
     float angleStep = glm::radians(360.0f) / numGrassTufts;
@@ -346,26 +340,190 @@ void swapBuffers(int& readBufferIndex) {
     glDrawBuffer(GL_COLOR_ATTACHMENT0 + !readBufferIndex);
 }
 
-void drawShadowCasters(GLuint shadowProgram, const std::vector<glm::mat4>& lightTransforms, GLuint cubeVAO, const std::vector<std::pair<glm::mat4, glm::mat3>>& cubeMatrices, int numCubeVertices, GLuint pyramidVAO, const std::vector<std::pair<glm::mat4, glm::mat3>>& pyramidMatrices, int numPyramidVertices) {
+void drawShadowCasters(GLuint shadowProgram, const ShadowUniforms& uniforms, const std::vector<glm::mat4>& lightTransforms, GLuint sceneVAO, const VisibleInstanceBuffer& drawCommands, int firstCommand, int numCommands) {
     glEnable(GL_CULL_FACE);
     glUseProgram(shadowProgram);
 
-    glUniform1i(glGetUniformLocation(shadowProgram, "numLayers"), lightTransforms.size());
-    glUniformMatrix4fv(glGetUniformLocation(shadowProgram, "lightTransforms"), lightTransforms.size(), GL_FALSE, reinterpret_cast<const GLfloat*>(lightTransforms.data()));
+    uniforms.numLayers.set(lightTransforms.size());
+    uniforms.lightTransforms.set(lightTransforms.data(), lightTransforms.size());
 
-    for (const auto& [m, _]: cubeMatrices) {
-        glUniformMatrix4fv(glGetUniformLocation(shadowProgram, "model"), 1, GL_FALSE, glm::value_ptr(m));
-        glBindVertexArray(cubeVAO);
-        glDrawElements(GL_TRIANGLES, numCubeVertices, GL_UNSIGNED_INT, nullptr);
+    glBindVertexArray(sceneVAO);
+    drawCommands.draw(firstCommand, numCommands);
+
+    glDisable(GL_CULL_FACE);
+}
+
+void drawProfilerOverlay(GLuint profilerProgram, const ProfilerUniforms& uniforms, GLuint rectVAO, int numRectIndices) {
+    constexpr float frameBudget = 1000.0f / 60.0f;
+    constexpr float barLeft = -0.98f, barTop = 0.95f, barWidth = 1.0f, barHeight = 0.03f;
+    const std::array<glm::vec4, 6> palette = {
+        glm::vec4{0.90f, 0.30f, 0.25f, 0.9f},
+        glm::vec4{0.95f, 0.65f, 0.20f, 0.9f},
+        glm::vec4{0.90f, 0.90f, 0.30f, 0.9f},
+        glm::vec4{0.35f, 0.80f, 0.35f, 0.9f},
+        glm::vec4{0.30f, 0.60f, 0.95f, 0.9f},
+        glm::vec4{0.70f, 0.40f, 0.90f, 0.9f},
+    };
+    glUseProgram(profilerProgram);
+    glBindVertexArray(rectVAO);
+    glEnable(GL_BLEND);
+    int row = 0;
+    for (const auto& sectionTime: GPUProfiler::getSectionTimes()) {
+        if (!sectionTime.bActive) {
+            continue;
+        }
+        float y = barTop - (row + 1) * barHeight * 1.5f;
+        float fraction = std::min(static_cast<float>(sectionTime.averageTime) / frameBudget, 1.0f);
+        uniforms.rect.set({barLeft, y, barWidth, barHeight});
+        uniforms.barColor.set({0.0f, 0.0f, 0.0f, 0.5f});
+        glDrawElements(GL_TRIANGLES, numRectIndices, GL_UNSIGNED_INT, nullptr);
+        uniforms.rect.set({barLeft, y, barWidth * fraction, barHeight});
+        uniforms.barColor.set(palette[row % palette.size()]);
+        glDrawElements(GL_TRIANGLES, numRectIndices, GL_UNSIGNED_INT, nullptr);
+        row++;
     }
+    glDisable(GL_BLEND);
+}
 
-    for (const auto& [m, _]: pyramidMatrices) {
-        glUniformMatrix4fv(glGetUniformLocation(shadowProgram, "model"), 1, GL_FALSE, glm::value_ptr(m));
-        glBindVertexArray(pyramidVAO);
-        glDrawElements(GL_TRIANGLES, numPyramidVertices, GL_UNSIGNED_INT, nullptr);
+void updateProfilerTitle(GLFWwindow* window) {
+    char title[512];
+    int written = std::snprintf(title, sizeof(title), "OpenGL tutorial | GPU %.2f ms", GPUProfiler::getFrameTime());
+    for (const auto& sectionTime: GPUProfiler::getSectionTimes()) {
+        if (!sectionTime.bActive or written >= static_cast<int>(sizeof(title))) {
+            continue;
+        }
+        written += std::snprintf(title + written, sizeof(title) - written, " | %s %.2f", sectionTime.name.c_str(), sectionTime.averageTime);
+    }
+    auto textureStats = TextureLoader::getStats();
+    if (written < static_cast<int>(sizeof(title))) {
+        std::snprintf(title + written, sizeof(title) - written, " | textures %.1f MiB, %zu pending",
+                      textureStats.residentBytes / 1048576.0, textureStats.numPending);
     }
+    glfwSetWindowTitle(window, title);
+}
 
-    glDisable(GL_CULL_FACE);
+struct LaunchOptions {
+    bool bHeadless = false;
+    int windowW = 0;
+    int windowH = 0;
+    int numFrames = 0;
+    std::filesystem::path benchmarkPath;
+    std::filesystem::path benchmarkReport = "benchmark.csv";
+    std::filesystem::path gpuProfileLog;
+    std::filesystem::path cpuTrace;
+    bool bMeshCache = true;
+    bool bTextureStreaming = true;
+    bool bTextureCache = true;
+    int textureBudget = 0;
+    bool bProgramCache = true;
+    bool bParallelCompile = true;
+    bool bShaderReload = true;
+    int numPointLights = 0;
+    int numSpotLights = 0;
+    bool bShaderStorageLights = true;
+    bool bCulling = true;
+    bool bLayeredShadows = true;
+};
+
+void printUsage(const char* programName) {
+    std::printf("Usage: %s [--headless] [--width W] [--height H] [--frames N]\n"
+                "          [--benchmark PATH] [--benchmark-report FILE] [--gpu-profile-log FILE] [--cpu-trace FILE]\n"
+                "          [--no-mesh-cache] [--sync-textures] [--no-texture-cache] [--texture-budget MB]\n"
+                "          [--no-program-cache] [--serial-compile] [--no-shader-reload]\n"
+                "          [--point-lights N] [--spot-lights N] [--texture-buffer-lights] [--no-culling]\n"
+                "          [--geometry-shader-shadows]\n"
+                "  --headless                render offscreen through EGL without opening a window\n"
+                "  --width W                 framebuffer width in pixels\n"
+                "  --height H                framebuffer height in pixels\n"
+                "  --frames N                exit after N frames (headless runs default to 100)\n"
+                "  --benchmark PATH          replay the camera path in PATH for every benchmark configuration\n"
+                "  --benchmark-report FILE   write benchmark timings to FILE, as JSON if it ends in .json (default benchmark.csv)\n"
+                "  --gpu-profile-log FILE    write the GPU time of every render pass to FILE as CSV\n"
+                "  --cpu-trace FILE          write CPU profiler zones to FILE as Chrome trace JSON\n"
+                "  --no-mesh-cache           always import models with Assimp and leave the mesh cache untouched\n"
+                "  --sync-textures           load textures on first use instead of streaming them in the background\n"
+                "  --no-texture-cache        upload textures from PNG without reading or baking compressed copies\n"
+                "  --texture-budget MB       evict textures that were not bound recently once their memory exceeds MB\n"
+                "  --no-program-cache        compile every shader program from source without reading or storing binaries\n"
+                "  --serial-compile          compile and link shader programs one by one even if the driver can do it in parallel\n"
+                "  --no-shader-reload        do not watch shader files for changes to rebuild programs while running\n"
+                "  --point-lights N          add N randomly placed point lights, only the first ones cast shadows\n"
+                "  --spot-lights N           add N randomly placed spot lights besides the flashlight\n"
+                "  --texture-buffer-lights   read lights from a texture buffer even if shader storage buffers are supported\n"
+                "  --no-culling              draw every object in every view instead of only those inside its frustum\n"
+                "  --geometry-shader-shadows amplify shadow casters into every layer even if the vertex shader can pick layers\n",
+                programName);
+}
+
+bool parseArguments(int argc, char** argv, LaunchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        // Counts accept 0, sizes need at least 1
+        auto nextInt = [&](int& value, int minValue) {
+            if (i + 1 >= argc) {
+                return false;
+            }
+            char* end = nullptr;
+            long parsed = std::strtol(argv[++i], &end, 10);
+            if (end == argv[i] or *end != '\0' or parsed < minValue or parsed > INT_MAX) {
+                return false;
+            }
+            value = parsed;
+            return true;
+        };
+        bool bValid = true;
+        if (arg == "--headless") {
+            options.bHeadless = true;
+        } else if (arg == "--width") {
+            bValid = nextInt(options.windowW, 1);
+        } else if (arg == "--height") {
+            bValid = nextInt(options.windowH, 1);
+        } else if (arg == "--frames") {
+            bValid = nextInt(options.numFrames, 1);
+        } else if (arg == "--benchmark" and i + 1 < argc) {
+            options.benchmarkPath = argv[++i];
+        } else if (arg == "--benchmark-report" and i + 1 < argc) {
+            options.benchmarkReport = argv[++i];
+        } else if (arg == "--gpu-profile-log" and i + 1 < argc) {
+            options.gpuProfileLog = argv[++i];
+        } else if (arg == "--cpu-trace" and i + 1 < argc) {
+            options.cpuTrace = argv[++i];
+        } else if (arg == "--no-mesh-cache") {
+            options.bMeshCache = false;
+        } else if (arg == "--sync-textures") {
+            options.bTextureStreaming = false;
+        } else if (arg == "--no-texture-cache") {
+            options.bTextureCache = false;
+        } else if (arg == "--texture-budget") {
+            bValid = nextInt(options.textureBudget, 0);
+        } else if (arg == "--no-program-cache") {
+            options.bProgramCache = false;
+        } else if (arg == "--serial-compile") {
+            options.bParallelCompile = false;
+        } else if (arg == "--no-shader-reload") {
+            options.bShaderReload = false;
+        } else if (arg == "--point-lights") {
+            bValid = nextInt(options.numPointLights, 0);
+        } else if (arg == "--spot-lights") {
+            bValid = nextInt(options.numSpotLights, 0);
+        } else if (arg == "--texture-buffer-lights") {
+            options.bShaderStorageLights = false;
+        } else if (arg == "--no-culling") {
+            options.bCulling = false;
+        } else if (arg == "--geometry-shader-shadows") {
+            options.bLayeredShadows = false;
+        } else {
+            bValid = false;
+        }
+        if (!bValid) {
+            std::fprintf(stderr, "Invalid argument: %s\n", argv[i]);
+            return false;
+        }
+    }
+    if (options.bHeadless and !options.numFrames) {
+        options.numFrames = 100;
+    }
+    return true;
 }
 
 glm::vec3 calculateLightUp(const glm::vec3& lightDir) {
@@ -379,28 +537,60 @@ glm::vec3 calculateLightUp(const glm::vec3& lightDir) {
     return lightUp;
 }
 
-int main() {
+int main(int argc, char** argv) {
+    LaunchOptions launchOptions;
+    if (!parseArguments(argc, argv, launchOptions)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    CPUProfiler::bEnabled = !launchOptions.cpuTrace.empty();
+    CPUProfiler::setThreadName("main");
+    MeshCache::bEnabled = launchOptions.bMeshCache;
+    TextureLoader::bStreaming = launchOptions.bTextureStreaming;
+    TextureCache::bEnabled = launchOptions.bTextureCache;
+    TextureLoader::setBudget(static_cast<std::size_t>(launchOptions.textureBudget) << 20);
+    ProgramCache::bEnabled = launchOptions.bProgramCache;
+    ProgramCache::bParallelCompile = launchOptions.bParallelCompile;
+    ShaderReloader::bEnabled = launchOptions.bShaderReload;
+
+    Benchmark benchmark;
+    bool bBenchmark = !launchOptions.benchmarkPath.empty();
+    if (bBenchmark) {
+        if (!benchmark.loadCameraPath(launchOptions.benchmarkPath)) {
+            std::fprintf(stderr, "Failed to load camera path %s\n", launchOptions.benchmarkPath.c_str());
+            return 1;
+        }
+        launchOptions.numFrames = benchmark.getNumFrames();
+        RandomSampler::seed(Benchmark::RANDOM_SEED);
+    }
+
     float horizontalFOV = 90.0f;
     int windowW, windowH;
     float windowAspectRatio = 16.0f / 9.0f;
     windowH = 720.0f;
     windowW = windowH * windowAspectRatio;
+    if (launchOptions.windowH) {
+        windowH = launchOptions.windowH;
+        windowW = launchOptions.windowW ? launchOptions.windowW : windowH * windowAspectRatio;
+    } else if (launchOptions.windowW) {
+        windowW = launchOptions.windowW;
+        windowH = windowW / windowAspectRatio;
+    }
     float cameraSpeed = 5.0f;
 
-    constexpr int MAX_POINT_LIGHTS = 10,
-                  MAX_SPOT_LIGHTS = 10,
-                  MAX_DIRECTIONAL_LIGHTS = 10;
-    constexpr int POINT_LIGHT_SIZE = 64,
-                  SPOT_LIGHT_SIZE = 96,
-                  DIRECTIONAL_LIGHT_SIZE = 64;
+    // Any number of lights fits into the light storage, shadow maps are
+    // only rendered for the first few of each type
+    constexpr int MAX_SHADOWED_POINT_LIGHTS = 10,
+                  MAX_SHADOWED_SPOT_LIGHTS = 10,
+                  MAX_SHADOWED_DIRECTIONAL_LIGHTS = 10;
 
-    int numPointLights = 0,
-        numSpotLights = 0 + 1,
+    int numPointLights = launchOptions.numPointLights,
+        numSpotLights = launchOptions.numSpotLights + 1,
         numDirectionalLights = 1;
 
-    numPointLights = std::min(numPointLights, MAX_POINT_LIGHTS);
-    numSpotLights = std::min(numSpotLights, MAX_SPOT_LIGHTS);
-    numDirectionalLights = std::min(numDirectionalLights, MAX_DIRECTIONAL_LIGHTS);
+    int numShadowedPointLights = std::min(numPointLights, MAX_SHADOWED_POINT_LIGHTS),
+        numShadowedSpotLights = std::min(numSpotLights, MAX_SHADOWED_SPOT_LIGHTS),
+        numShadowedDirectionalLights = std::min(numDirectionalLights, MAX_SHADOWED_DIRECTIONAL_LIGHTS);
 
     std::vector<PointLight> pointLights(numPointLights);
     std::vector<SpotLight> spotLights(numSpotLights);
@@ -415,7 +605,9 @@ int main() {
          bBorder = false,
          bSnow = false,
          bShowMag = false,
-         bGammaCorrect = true;
+         bShowProfiler = false,
+         bGammaCorrect = true,
+         bShadows = true;
     float bloomIntencity = 16.0f;
     int TAASamples = 4;
     std::vector<glm::vec3> TAASamplesPositions =
@@ -470,19 +662,16 @@ int main() {
         "skybox/top.png",
         "skybox/bottom.png"};
 
-    std::vector<std::tuple<glm::mat4, glm::mat3, Material>> transparentObjects;
+    std::vector<std::tuple<glm::mat4, glm::mat3, MaterialLayers>> transparentObjects;
     float windowRectDW = numCubesX * cubeDistanceX / 2.0f + 2.0f,
           windowRectDH = numCubesY * cubeDistanceY / 2.0f + 2.0f;
-    setupWindows(transparentObjects, windowRectDW, windowRectDH, windowMaterial);
-    setupGrass(transparentObjects, windowRectDW, windowRectDH, grassMaterial);
 
     glm::vec3 cameraStartPos = {0.0f, 0.0f, 3.0f},
               cameraStartLookDirection = {1.0f, 0.0f, 0.0f};
 
     auto camera = std::make_shared<Camera>(cameraStartPos, cameraStartLookDirection, glm::vec3(0.0f, 0.0f, 1.0f));
 
-    GLuint cubeShaderProgram,
-        cubeNormalShaderProgram,
+    GLuint cubeNormalShaderProgram,
         lampShaderProgram,
         lampBorderShaderProgram,
         TAAShaderProgram,
@@ -493,9 +682,11 @@ int main() {
         screenRectShaderProgram,
         blurShaderProgram,
         cubeMapShaderProgram,
-        snowShaderProgram,
         shadowShaderProgram,
-        depthVisualizationProgram;
+        depthVisualizationProgram,
+        profilerShaderProgram;
+    // Lit programs are specialized for the lights and shadows of each frame
+    ProgramPermutations<LitUniforms, LightingPermutation> cubePrograms, snowPrograms;
     GLuint frameTextureArray;
     std::vector<GLuint> shadowMapArrays(2);
     GLuint& spotLightShadowMapArray = shadowMapArrays[0];
@@ -507,36 +698,26 @@ int main() {
         fullResReadIndex = 0,
         quarterResReadIndex = 0;
 
-    std::vector<GLuint> vertexBuffers(12);
-
-    GLuint& cubeVBO = vertexBuffers[0];
-    GLuint& pyramidVBO = vertexBuffers[1];
-    GLuint& circlePlaneVBO = vertexBuffers[2];
-    GLuint& sphereVBO = vertexBuffers[3];
-    GLuint& coneVBO = vertexBuffers[4];
-    GLuint& squarePlaneVBO = vertexBuffers[5];
-    GLuint& screenRectVBO = vertexBuffers[6];
-    GLuint& magRectVBO = vertexBuffers[7];
-    GLuint& transparentVBO = vertexBuffers[8];
-    GLuint& skyboxVBO = vertexBuffers[9];
-    GLuint& snowPosVBO = vertexBuffers[10];
-    GLuint& snowDirVBO = vertexBuffers[11];
-
-    std::vector<GLuint> elementBuffers(9);
-
-    GLuint& cubeEBO = elementBuffers[0];
-    GLuint& pyramidEBO = elementBuffers[1];
-    GLuint& planeEBO = elementBuffers[2];
-    GLuint& sphereEBO = elementBuffers[3];
-    GLuint& coneEBO = elementBuffers[4];
-    GLuint& squarePlaneEBO = elementBuffers[5];
-    GLuint& screenRectEBO = elementBuffers[6];
-    GLuint& transparentEBO = elementBuffers[7];
-    GLuint& skyboxEBO = elementBuffers[8];
-
-    std::vector<GLuint> uniformBuffers(2);
-    GLuint& matrixUBO = uniformBuffers[0];
-    GLuint& lightUBO = uniformBuffers[1];
+    std::vector<GLuint> vertexBuffers(4);
+
+    GLuint& screenRectVBO = vertexBuffers[0];
+    GLuint& magRectVBO = vertexBuffers[1];
+    GLuint& snowPosVBO = vertexBuffers[2];
+    GLuint& snowDirVBO = vertexBuffers[3];
+
+    std::vector<GLuint> elementBuffers(1);
+
+    GLuint& screenRectEBO = elementBuffers[0];
+
+    GeometryArena geometryArena;
+    DrawCommandBuffer opaqueDrawCommands;
+    VisibleInstanceBuffer visibleSceneInstances;
+    FrustumCuller sceneCuller, transparentCuller;
+
+    // Holds the MatrixBlock and LightsBlock uniform blocks of every frame
+    FrameRingBuffer frameUniforms;
+    LightStorage lightStorage;
+    LightClusters lightClusters;
 
     std::vector<GLuint> frameBuffers(5);
     GLuint& PPFBO = frameBuffers[0];
@@ -550,19 +731,14 @@ int main() {
     GLuint& MSDepthStencilRenderBuffer = renderBuffers[1];
     GLuint& blitDepthStencilRenderBuffer = renderBuffers[2];
 
-    std::vector<GLuint> vertexArrays(11);
+    std::vector<GLuint> vertexArrays(6);
 
-    GLuint& cubeVAO = vertexArrays[0];
-    GLuint& pyramidVAO = vertexArrays[1];
-    GLuint& floorVAO = vertexArrays[2];
-    GLuint& pointLightVAO = vertexArrays[3];
-    GLuint& spotLightVAO = vertexArrays[4];
-    GLuint& directionalLightVAO = vertexArrays[5];
-    GLuint& screenRectVAO = vertexArrays[6];
-    GLuint& magRectVAO = vertexArrays[7];
-    GLuint& transparentVAO = vertexArrays[8];
-    GLuint& skyboxVAO = vertexArrays[9];
-    GLuint& snowVAO = vertexArrays[10];
+    GLuint& sceneVAO = vertexArrays[0];
+    GLuint& modelVAO = vertexArrays[1];
+    GLuint& lampVAO = vertexArrays[2];
+    GLuint& screenRectVAO = vertexArrays[3];
+    GLuint& magRectVAO = vertexArrays[4];
+    GLuint& snowVAO = vertexArrays[5];
 
     constexpr std::array<GLfloat, 16> screenRectVertexData =
         {-1.0f, -1.0f, 0.0f, 0.0f,
@@ -580,11 +756,23 @@ int main() {
         {0, 1, 2,
          2, 3, 0};
 
-    CameraManager::initialize(windowW, windowH);
+    if (!CameraManager::initialize(windowW, windowH, launchOptions.bHeadless)) {
+        std::fprintf(stderr, "Failed to create an OpenGL context\n");
+        CameraManager::terminate();
+        return 1;
+    }
     CameraManager::setHorizontalFOV(horizontalFOV);
     CameraManager::currentCamera = camera;
     CameraManager::enableCameraLook();
-    gladLoadGLLoader(reinterpret_cast<GLADloadproc>(glfwGetProcAddress));
+    if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(CameraManager::getProcAddress))) {
+        std::fprintf(stderr, "Failed to load OpenGL functions\n");
+        CameraManager::terminate();
+        return 1;
+    }
+
+    if (!launchOptions.gpuProfileLog.empty() and !GPUProfiler::openLog(launchOptions.gpuProfileLog)) {
+        std::fprintf(stderr, "Failed to open GPU profile log %s\n", launchOptions.gpuProfileLog.c_str());
+    }
 
     glEnable(GL_DEBUG_OUTPUT);
     glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
@@ -597,15 +785,121 @@ int main() {
     glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
+    // Lit programs are built for the light storage backend
+    lightStorage.create(launchOptions.bShaderStorageLights);
+    if (!lightStorage.setLights(pointLights, spotLights, directionalLights)) {
+        std::fprintf(stderr, "Too many lights, the light storage holds at most %zu texels\n", lightStorage.getMaxTexels());
+        lightStorage.free();
+        CameraManager::terminate();
+        return 1;
+    }
+    lightStorage.upload();
+    lightClusters.create();
+    lightClusters.setLights(pointLights, spotLights);
+
+    // Shadow casters pick their layer in the vertex shader where it can write gl_Layer
+    bool bLayeredShadows = launchOptions.bLayeredShadows and (GLAD_GL_ARB_shader_viewport_layer_array or GLAD_GL_AMD_vertex_shader_layer);
+
+    ShaderReloader::initialize();
+    {
+        ScopedCPUZone cpuZone("Load shaders");
+        ShaderStage cubeVertexShader = {GL_VERTEX_SHADER, "assets/shaders/triangle.vert"};
+        ShaderDefines litDefines = lightStorage.getShaderDefines();
+        ShaderDefines clusterDefines = lightClusters.getShaderDefines();
+        litDefines.insert(litDefines.end(), clusterDefines.begin(), clusterDefines.end());
+        ShaderStage cubeFragmentShader = {GL_FRAGMENT_SHADER, "assets/shaders/triangle.frag", litDefines};
+        ShaderStage cubeNormalVertexShader = {GL_VERTEX_SHADER, "assets/shaders/trianglenormals.vert"};
+        ShaderStage cubeNormalGeometryShader = {GL_GEOMETRY_SHADER, "assets/shaders/trianglenormals.geom"};
+        ShaderStage cubeNormalFragmentShader = {GL_FRAGMENT_SHADER, "assets/shaders/trianglenormals.frag"};
+        ShaderStage lampVertexShader = {GL_VERTEX_SHADER, "assets/shaders/lamp.vert"};
+        ShaderStage lampFragmentShader = {GL_FRAGMENT_SHADER, "assets/shaders/lamp.frag"};
+        ShaderStage lampBorderFragmentShader = {GL_FRAGMENT_SHADER, "assets/shaders/lampborder.frag"};
+        ShaderStage screenRectVertexShader = {GL_VERTEX_SHADER, "assets/shaders/screenrect.vert"};
+        ShaderStage screenRectFragmentShader = {GL_FRAGMENT_SHADER, "assets/shaders/screenrect.frag"};
+        ShaderStage TAAFragmentShader = {GL_FRAGMENT_SHADER, "assets/shaders/taa.frag"};
+        ShaderStage greyscaleFragmentShader = {GL_FRAGMENT_SHADER, "assets/shaders/greyscale.frag"};
+        ShaderStage bloomExtractFragmentShader = {GL_FRAGMENT_SHADER, "assets/shaders/bloomextract.frag"};
+        ShaderStage bloomCombineFragmentShader = {GL_FRAGMENT_SHADER, "assets/shaders/bloomcombine.frag"};
+        ShaderStage blurFragmentShader = {GL_FRAGMENT_SHADER, "assets/shaders/blur.frag"};
+        ShaderStage gammaCorrectionShader = {GL_FRAGMENT_SHADER, "assets/shaders/gamma_correction.frag"};
+        ShaderStage cubeMapVertexShader = {GL_VERTEX_SHADER, "assets/shaders/cube.vert"};
+        ShaderStage cubeMapFragmentShader = {GL_FRAGMENT_SHADER, "assets/shaders/cube.frag"};
+        ShaderStage snowVertexShader = {GL_VERTEX_SHADER, "assets/shaders/snow.vert"};
+        ShaderStage shadowVertexShader = {GL_VERTEX_SHADER, "assets/shaders/shadow.vert"};
+        ShaderStage shadowGeometryShader = {GL_GEOMETRY_SHADER, "assets/shaders/shadow.geom"};
+        ShaderStage shadowLayeredVertexShader = {GL_VERTEX_SHADER, "assets/shaders/shadow.vert", {{"LAYERED_INSTANCING", "1"}}};
+        ShaderStage depthVisualizationFragmentShader = {GL_FRAGMENT_SHADER, "assets/shaders/visualize_depth_map.frag"};
+        ShaderStage profilerVertexShader = {GL_VERTEX_SHADER, "assets/shaders/profiler.vert"};
+        ShaderStage profilerFragmentShader = {GL_FRAGMENT_SHADER, "assets/shaders/profiler.frag"};
+
+        // Programs found in the program cache are created without compiling their shaders,
+        // the others keep compiling while textures, framebuffers and meshes are set up
+
+        cubePrograms.createGenericProgram({cubeVertexShader, cubeFragmentShader});
+        snowPrograms.createGenericProgram({snowVertexShader, cubeFragmentShader});
+        ShaderReloader::createProgram(cubeNormalShaderProgram, {cubeNormalVertexShader, cubeNormalGeometryShader, cubeNormalFragmentShader});
+
+        // Create lamp shader programs
+
+        ShaderReloader::createProgram(lampShaderProgram, {lampVertexShader, lampFragmentShader});
+        ShaderReloader::createProgram(lampBorderShaderProgram, {lampVertexShader, lampBorderFragmentShader});
+
+        // Cube map shader program
+
+        ShaderReloader::createProgram(cubeMapShaderProgram, {cubeMapVertexShader, cubeMapFragmentShader});
+
+        // Create screen rect shader program
+
+        ShaderReloader::createProgram(screenRectShaderProgram, {screenRectVertexShader, screenRectFragmentShader});
+
+        // Create taa shader program
+
+        ShaderReloader::createProgram(TAAShaderProgram, {screenRectVertexShader, TAAFragmentShader});
+
+        // Create greyscale shader program
+
+        ShaderReloader::createProgram(greyscaleShaderProgram, {screenRectVertexShader, greyscaleFragmentShader});
+
+        // Create bloom shader programs
+
+        ShaderReloader::createProgram(bloomExtractShaderProgram, {screenRectVertexShader, bloomExtractFragmentShader});
+        ShaderReloader::createProgram(bloomCombineShaderProgram, {screenRectVertexShader, bloomCombineFragmentShader});
+
+        // Create blur shader program
+
+        ShaderReloader::createProgram(blurShaderProgram, {screenRectVertexShader, blurFragmentShader});
+
+        // Create gamma correction shader program
+
+        ShaderReloader::createProgram(gammaCorrectionShaderProgram, {screenRectVertexShader, gammaCorrectionShader});
+
+        // Create depth visualization shader program
+
+        ShaderReloader::createProgram(depthVisualizationProgram, {screenRectVertexShader, depthVisualizationFragmentShader});
+
+        // Create shadow shader program, the geometry shader is only needed
+        // where the vertex shader cannot write gl_Layer
+
+        if (bLayeredShadows) {
+            ShaderReloader::createProgram(shadowShaderProgram, {shadowLayeredVertexShader});
+        } else {
+            ShaderReloader::createProgram(shadowShaderProgram, {shadowVertexShader, shadowGeometryShader});
+        }
+
+        // Create profiler overlay shader program
+
+        ShaderReloader::createProgram(profilerShaderProgram, {profilerVertexShader, profilerFragmentShader});
+    }
+
     // Setup snow material
     glGenTextures(snowTextures.size(), snowTextures.data());
     for (const auto& tex: snowTextures) {
-        glBindTexture(GL_TEXTURE_2D, tex);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_FLOAT, glm::value_ptr(glm::vec4(1.0f)));
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, tex);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA, 1, 1, 1, 0, GL_RGBA, GL_FLOAT, glm::value_ptr(glm::vec4(1.0f)));
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     }
 
     // Setup rendering textures
@@ -640,9 +934,9 @@ int main() {
 
     glGenTextures(shadowMapArrays.size(), shadowMapArrays.data());
     glBindTexture(GL_TEXTURE_2D_ARRAY, spotLightShadowMapArray);
-    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT, SPOT_LIGHT_SHADOWMAP_RESOLUTION, SPOT_LIGHT_SHADOWMAP_RESOLUTION, numSpotLights * numSpotLightCascades, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_BYTE, nullptr);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT, SPOT_LIGHT_SHADOWMAP_RESOLUTION, SPOT_LIGHT_SHADOWMAP_RESOLUTION, numShadowedSpotLights * numSpotLightCascades, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_BYTE, nullptr);
     glBindTexture(GL_TEXTURE_2D_ARRAY, directionalLightShadowMapArray);
-    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT, DIR_LIGHT_SHADOWMAP_RESOLUTION, DIR_LIGHT_SHADOWMAP_RESOLUTION, numDirectionalLights * numDirLightCascades, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_BYTE, nullptr);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT, DIR_LIGHT_SHADOWMAP_RESOLUTION, DIR_LIGHT_SHADOWMAP_RESOLUTION, numShadowedDirectionalLights * numDirLightCascades, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_BYTE, nullptr);
     for (auto shadowTex: shadowMapArrays) {
         glBindTexture(GL_TEXTURE_2D_ARRAY, shadowTex);
         glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -656,7 +950,7 @@ int main() {
 
     glGenTextures(1, &pointLightShadowCubeMapArray);
     glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY_ARB, pointLightShadowCubeMapArray);
-    glTexImage3D(GL_TEXTURE_CUBE_MAP_ARRAY_ARB, 0, GL_DEPTH_COMPONENT, POINT_LIGHT_SHADOWMAP_RESOLUTION, POINT_LIGHT_SHADOWMAP_RESOLUTION, 6 * numPointLights * numPointLightCascades, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_BYTE, nullptr);
+    glTexImage3D(GL_TEXTURE_CUBE_MAP_ARRAY_ARB, 0, GL_DEPTH_COMPONENT, POINT_LIGHT_SHADOWMAP_RESOLUTION, POINT_LIGHT_SHADOWMAP_RESOLUTION, 6 * numShadowedPointLights * numPointLightCascades, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_BYTE, nullptr);
     glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY_ARB, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY_ARB, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY_ARB, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -712,166 +1006,106 @@ int main() {
     glDrawBuffer(GL_NONE);
     glReadBuffer(GL_NONE);
 
-    {
-        auto cubeVertexShaderSource = loadShaderSource("assets/shaders/triangle.vert");
-        auto cubeFragmentShaderSource = loadShaderSource("assets/shaders/triangle.frag");
-        auto cubeNormalVertexShaderSource = loadShaderSource("assets/shaders/trianglenormals.vert");
-        auto cubeNormalGeometryShaderSource = loadShaderSource("assets/shaders/trianglenormals.geom");
-        auto cubeNormalFragmentShaderSource = loadShaderSource("assets/shaders/trianglenormals.frag");
-        auto lampVertexShaderSource = loadShaderSource("assets/shaders/lamp.vert");
-        auto lampFragmentShaderSource = loadShaderSource("assets/shaders/lamp.frag");
-        auto lampBorderFragmentShaderSource = loadShaderSource("assets/shaders/lampborder.frag");
-        auto screenRectVertexShaderSource = loadShaderSource("assets/shaders/screenrect.vert");
-        auto screenRectFragmentShaderSource = loadShaderSource("assets/shaders/screenrect.frag");
-        auto TAAFragmentShaderSource = loadShaderSource("assets/shaders/taa.frag");
-        auto greyscaleFragmentShaderSource = loadShaderSource("assets/shaders/greyscale.frag");
-        auto bloomExtractFragmentShaderSource = loadShaderSource("assets/shaders/bloomextract.frag");
-        auto bloomCombineFragmentShaderSource = loadShaderSource("assets/shaders/bloomcombine.frag");
-        auto blurFragmentShaderSource = loadShaderSource("assets/shaders/blur.frag");
-        auto gammaCorrectionShaderSource = loadShaderSource("assets/shaders/gamma_correction.frag");
-        auto cubeMapVertexShaderSource = loadShaderSource("assets/shaders/cube.vert");
-        auto cubeMapFragmentShaderSource = loadShaderSource("assets/shaders/cube.frag");
-        auto snowVertexShaderSource = loadShaderSource("assets/shaders/snow.vert");
-        auto shadowVertexShaderSource = loadShaderSource("assets/shaders/shadow.vert");
-        auto shadowGeometryShaderSource = loadShaderSource("assets/shaders/shadow.geom");
-        auto depthVisualizationFragmentShaderSource = loadShaderSource("assets/shaders/visualize_depth_map.frag");
-
-        // Create cube shader program
-
-        GLuint cubeVertexShader = createShader(GL_VERTEX_SHADER, cubeVertexShaderSource);
-        GLuint cubeFragmentShader = createShader(GL_FRAGMENT_SHADER, cubeFragmentShaderSource);
-        cubeShaderProgram = createProgram({cubeVertexShader, cubeFragmentShader});
-        GLuint snowVertexShader = createShader(GL_VERTEX_SHADER, snowVertexShaderSource);
-        snowShaderProgram = createProgram({snowVertexShader, cubeFragmentShader});
-        glDeleteShader(snowVertexShader);
-        GLuint cubeNormalVertexShader = createShader(GL_VERTEX_SHADER, cubeNormalVertexShaderSource);
-        GLuint cubeNormalGeometryShader = createShader(GL_GEOMETRY_SHADER, cubeNormalGeometryShaderSource);
-        GLuint cubeNormalFragmentShader = createShader(GL_FRAGMENT_SHADER, cubeNormalFragmentShaderSource);
-        cubeNormalShaderProgram = createProgram({cubeNormalVertexShader, cubeNormalGeometryShader, cubeNormalFragmentShader});
-        glDeleteShader(cubeVertexShader);
-        glDeleteShader(cubeFragmentShader);
-        glDeleteShader(cubeNormalGeometryShader);
-        glDeleteShader(cubeNormalFragmentShader);
-
-        // Create lamp shader programs
-
-        GLuint lampVertexShader = createShader(GL_VERTEX_SHADER, lampVertexShaderSource);
-        GLuint lampFragmentShader = createShader(GL_FRAGMENT_SHADER, lampFragmentShaderSource);
-        lampShaderProgram = createProgram({lampVertexShader, lampFragmentShader});
-        glDeleteShader(lampFragmentShader);
-
-        GLuint lampBorderFragmentShader = createShader(GL_FRAGMENT_SHADER, lampBorderFragmentShaderSource);
-        lampBorderShaderProgram = createProgram({lampVertexShader, lampBorderFragmentShader});
-        glDeleteShader(lampBorderFragmentShader);
+    ProgramCache::update();
+
+    auto models = ModelLoader::loadModels({
+        "assets/meshes/cube.obj",
+        "assets/meshes/pyramid.obj",
+        "assets/meshes/circularplane.obj",
+        "assets/meshes/cone.obj",
+        "assets/meshes/sphere.obj",
+        "assets/meshes/squareplane.obj",
+        "assets/meshes/skybox.obj",
+        "assets/meshes/transparentplane.obj",
+    });
+    auto [cubeVertexData, cubeVertexIndices, cubeMaterial] = std::move(models[0][0]);
+    auto [pyramidVertexData, pyramidVertexIndices, pyramidMaterial] = std::move(models[1][0]);
+    auto [circularPlaneVertexData, circularPlaneVertexIndices, circularPlaneMaterial] = std::move(models[2][0]);
+    auto [coneVertexData, coneVertexIndices, coneMaterial] = std::move(models[3][0]);
+    auto [sphereVertexData, sphereVertexIndices, sphereMaterial] = std::move(models[4][0]);
+    auto [squarePlaneVertexData, squarePlaneVertexIndices, squarePlaneMaterial] = std::move(models[5][0]);
+    auto [skyboxVertexData, skyboxVertexIndices, skyboxMaterial] = std::move(models[6][0]);
+    auto [transparentObjectVertexData, transparentObjectVertexIndices, transparentObjectMaterial] = std::move(models[7][0]);
 
-        glDeleteShader(lampVertexShader);
-
-        // Cube map shader program
-
-        GLuint cubeMapVertexShader = createShader(GL_VERTEX_SHADER, cubeMapVertexShaderSource);
-        GLuint cubeMapFragmentShader = createShader(GL_FRAGMENT_SHADER, cubeMapFragmentShaderSource);
-        cubeMapShaderProgram = createProgram({cubeMapVertexShader, cubeMapFragmentShader});
-        glDeleteShader(cubeMapVertexShader);
-        glDeleteShader(cubeMapFragmentShader);
-
-        // Create screen rect shader program
-
-        GLuint screenRectVertexShader = createShader(GL_VERTEX_SHADER, screenRectVertexShaderSource);
-        GLuint screenRectFragmentShader = createShader(GL_FRAGMENT_SHADER, screenRectFragmentShaderSource);
-        screenRectShaderProgram = createProgram({screenRectVertexShader, screenRectFragmentShader});
-        glDeleteShader(screenRectFragmentShader);
-
-        // Create taa shader program
-
-        GLuint TAAFragmentShader = createShader(GL_FRAGMENT_SHADER, TAAFragmentShaderSource);
-        TAAShaderProgram = createProgram({screenRectVertexShader, TAAFragmentShader});
-        glDeleteShader(TAAFragmentShader);
-
-        // Create greyscale shader program
-
-        GLuint greyscaleFragmentShader = createShader(GL_FRAGMENT_SHADER, greyscaleFragmentShaderSource);
-        greyscaleShaderProgram = createProgram({screenRectVertexShader, greyscaleFragmentShader});
-        glDeleteShader(greyscaleFragmentShader);
-
-        // Create bloom shader programs
-
-        GLuint bloomExtractFragmentShader = createShader(GL_FRAGMENT_SHADER, bloomExtractFragmentShaderSource);
-        bloomExtractShaderProgram = createProgram({screenRectVertexShader, bloomExtractFragmentShader});
-        glDeleteShader(bloomExtractFragmentShader);
+    // Setup data
 
-        GLuint bloomCombineFragmentShader = createShader(GL_FRAGMENT_SHADER, bloomCombineFragmentShaderSource);
-        bloomCombineShaderProgram = createProgram({screenRectVertexShader, bloomCombineFragmentShader});
-        glDeleteShader(bloomCombineFragmentShader);
+    MeshRange cubeMesh = geometryArena.addMesh(cubeVertexData, cubeVertexIndices);
+    MeshRange pyramidMesh = geometryArena.addMesh(pyramidVertexData, pyramidVertexIndices);
+    MeshRange circularPlaneMesh = geometryArena.addMesh(circularPlaneVertexData, circularPlaneVertexIndices);
+    MeshRange sphereMesh = geometryArena.addMesh(sphereVertexData, sphereVertexIndices);
+    MeshRange coneMesh = geometryArena.addMesh(coneVertexData, coneVertexIndices);
+    MeshRange squarePlaneMesh = geometryArena.addMesh(squarePlaneVertexData, squarePlaneVertexIndices);
+    MeshRange transparentObjectMesh = geometryArena.addMesh(transparentObjectVertexData, transparentObjectVertexIndices);
+    MeshRange skyboxMesh = geometryArena.addMesh(skyboxVertexData, skyboxVertexIndices);
+    geometryArena.upload();
 
-        // Create blur shader program
+    glGenBuffers(vertexBuffers.size(), vertexBuffers.data());
+    glGenBuffers(elementBuffers.size(), elementBuffers.data());
+    storeData(screenRectVertexData, rectVertexIndices, screenRectVBO, screenRectEBO);
+    storeData(magRectVertexData, rectVertexIndices, magRectVBO, 0);
+    setupSnowData(snowPosVBO, snowDirVBO, numSnowParticles, 30.0, 30.0f, 20.0f, -1.0f);
 
-        GLuint blurFragmentShader = createShader(GL_FRAGMENT_SHADER, blurFragmentShaderSource);
-        blurShaderProgram = createProgram({screenRectVertexShader, blurFragmentShader});
-        glDeleteShader(blurFragmentShader);
+    // Opaque scene objects share one instance buffer, each draw command
+    // starts at the first instance of its object type
 
-        // Create gamma correction shader program
+    std::vector<std::pair<glm::mat4, glm::mat3>> sceneInstances;
+    sceneInstances.insert(sceneInstances.end(), cubeMatrices.begin(), cubeMatrices.end());
+    sceneInstances.insert(sceneInstances.end(), pyramidMatrices.begin(), pyramidMatrices.end());
+    sceneInstances.emplace_back(floorModel, floorNormal);
 
-        GLuint gammaCorrectionFragmentShader = createShader(GL_FRAGMENT_SHADER, gammaCorrectionShaderSource);
-        gammaCorrectionShaderProgram = createProgram({screenRectVertexShader, gammaCorrectionFragmentShader});
-        glDeleteShader(gammaCorrectionFragmentShader);
+    // Texture layers are fixed once allocated, so the materials go into the
+    // instance buffer as well. Allocating them starts streaming the textures.
 
-        // Create depth visualization shader program
+    auto cubeLayers = getMaterialLayers(cubeMaterial),
+         pyramidLayers = getMaterialLayers(pyramidMaterial),
+         floorLayers = getMaterialLayers(circularPlaneMaterial);
+    std::vector<glm::vec3> sceneMaterials;
+    sceneMaterials.insert(sceneMaterials.end(), cubeMatrices.size(), cubeLayers.attributes);
+    sceneMaterials.insert(sceneMaterials.end(), pyramidMatrices.size(), pyramidLayers.attributes);
+    sceneMaterials.push_back(floorLayers.attributes);
+    visibleSceneInstances.create(packInstanceData(sceneInstances, sceneMaterials));
 
-        GLuint depthVizualizationFragmentShader = createShader(GL_FRAGMENT_SHADER, depthVisualizationFragmentShaderSource);
-        depthVisualizationProgram = createProgram({screenRectVertexShader, depthVizualizationFragmentShader});
-        glDeleteShader(depthVizualizationFragmentShader);
+    int cubeDraw = opaqueDrawCommands.addDraw(cubeMesh, cubeMatrices.size(), 0);
+    opaqueDrawCommands.addDraw(pyramidMesh, pyramidMatrices.size(), cubeMatrices.size());
+    int floorDraw = opaqueDrawCommands.addDraw(circularPlaneMesh, 1, cubeMatrices.size() + pyramidMatrices.size());
 
-        glDeleteShader(screenRectVertexShader);
+    // Scene objects never move, so their bounds are placed in the world once
 
-        // Create shadow shader program
-        GLuint shadowVertexShader = createShader(GL_VERTEX_SHADER, shadowVertexShaderSource);
-        GLuint shadowGeometryShader = createShader(GL_GEOMETRY_SHADER, shadowGeometryShaderSource);
-        shadowShaderProgram = createProgram({shadowVertexShader, shadowGeometryShader});
-        glDeleteShader(shadowVertexShader);
+    std::vector<BoundingSphere> sceneSpheres;
+    for (const auto& [model, normal]: cubeMatrices) {
+        sceneSpheres.push_back(transformBoundingSphere(cubeMesh.bounds, model));
+    }
+    for (const auto& [model, normal]: pyramidMatrices) {
+        sceneSpheres.push_back(transformBoundingSphere(pyramidMesh.bounds, model));
     }
+    sceneSpheres.push_back(transformBoundingSphere(circularPlaneMesh.bounds, floorModel));
+    sceneCuller.setSpheres(sceneSpheres);
 
-    auto [cubeVertexData, cubeVertexIndices, cubeMaterial] = loadModelData("assets/meshes/cube.obj")[0];
-    auto [pyramidVertexData, pyramidVertexIndices, pyramidMaterial] = loadModelData("assets/meshes/pyramid.obj")[0];
-    auto [circularPlaneVertexData, circularPlaneVertexIndices, circularPlaneMaterial] = loadModelData("assets/meshes/circularplane.obj")[0];
-    auto [coneVertexData, coneVertexIndices, coneMaterial] = loadModelData("assets/meshes/cone.obj")[0];
-    auto [sphereVertexData, sphereVertexIndices, sphereMaterial] = loadModelData("assets/meshes/sphere.obj")[0];
-    auto [squarePlaneVertexData, squarePlaneVertexIndices, squarePlaneMaterial] = loadModelData("assets/meshes/squareplane.obj")[0];
-    auto [skyboxVertexData, skyboxVertexIndices, skyboxMaterial] = loadModelData("assets/meshes/skybox.obj")[0];
-    auto [transparentObjectVertexData, transparentObjectVertexIndices, transparentObjectMaterial] = loadModelData("assets/meshes/transparentplane.obj")[0];
+    // Transparent objects are drawn one at a time, their layers are resolved
+    // here once so drawing them needs no texture lookups
 
-    // Setup data
+    setupWindows(transparentObjects, windowRectDW, windowRectDH, getMaterialLayers(windowMaterial));
+    setupGrass(transparentObjects, windowRectDW, windowRectDH, getMaterialLayers(grassMaterial));
 
-    glGenBuffers(vertexBuffers.size(), vertexBuffers.data());
-    glGenBuffers(elementBuffers.size(), elementBuffers.data());
-    storeData(cubeVertexData, cubeVertexIndices, cubeVBO, cubeEBO);
-    storeData(pyramidVertexData, pyramidVertexIndices, pyramidVBO, pyramidEBO);
-    storeData(circularPlaneVertexData, circularPlaneVertexIndices, circlePlaneVBO, planeEBO);
-    storeData(sphereVertexData, sphereVertexIndices, sphereVBO, sphereEBO);
-    storeData(coneVertexData, coneVertexIndices, coneVBO, coneEBO);
-    storeData(squarePlaneVertexData, squarePlaneVertexIndices, squarePlaneVBO, squarePlaneEBO);
-    storeData(screenRectVertexData, rectVertexIndices, screenRectVBO, screenRectEBO);
-    storeData(magRectVertexData, rectVertexIndices, magRectVBO, 0);
-    storeData(transparentObjectVertexData, transparentObjectVertexIndices, transparentVBO, transparentEBO);
-    storeData(skyboxVertexData, skyboxVertexIndices, skyboxVBO, skyboxEBO);
-    setupSnowData(snowPosVBO, snowDirVBO, numSnowParticles, 30.0, 30.0f, 20.0f, -1.0f);
+    std::vector<BoundingSphere> transparentSpheres;
+    for (const auto& [model, normal, material]: transparentObjects) {
+        transparentSpheres.push_back(transformBoundingSphere(transparentObjectMesh.bounds, model));
+    }
+    transparentCuller.setSpheres(transparentSpheres);
 
     // Setup VAOs
 
     glGenVertexArrays(vertexArrays.size(), vertexArrays.data());
-    setupModel(cubeVAO, cubeVBO, cubeEBO);
-    setupModel(pyramidVAO, pyramidVBO, pyramidEBO);
-    setupModel(floorVAO, circlePlaneVBO, planeEBO);
-    setupLamp(pointLightVAO, sphereVBO, sphereEBO);
-    setupLamp(spotLightVAO, coneVBO, coneEBO);
-    setupLamp(directionalLightVAO, squarePlaneVBO, squarePlaneEBO);
+    geometryArena.setupVertexArray(sceneVAO);
+    visibleSceneInstances.setupVertexArray(sceneVAO);
+    geometryArena.setupVertexArray(modelVAO);
+    geometryArena.setupPositionVertexArray(lampVAO);
     setupRenderRect(screenRectVAO, screenRectVBO, screenRectEBO);
     setupRenderRect(magRectVAO, magRectVBO, screenRectEBO);
-    setupModel(transparentVAO, transparentVBO, transparentEBO);
-    setupLamp(skyboxVAO, skyboxVBO, skyboxEBO);
 
     glBindVertexArray(snowVAO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphereEBO);
-    glBindBuffer(GL_ARRAY_BUFFER, sphereVBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometryArena.getElementBuffer());
+    glBindBuffer(GL_ARRAY_BUFFER, geometryArena.getVertexBuffer());
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), nullptr);
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), nullptr);
     glBindBuffer(GL_ARRAY_BUFFER, snowPosVBO);
@@ -885,125 +1119,181 @@ int main() {
     glEnableVertexAttribArray(2);
     glEnableVertexAttribArray(3);
 
-    // Set floor texture wrapping parameters
-
-    glBindTexture(GL_TEXTURE_2D, TextureLoader::getTextureId2D(circularPlaneMaterial.diffuseMap));
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glBindTexture(GL_TEXTURE_2D, TextureLoader::getTextureId2D(circularPlaneMaterial.specularMap, false));
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-    glGenBuffers(uniformBuffers.size(), uniformBuffers.data());
-
-    glBindBuffer(GL_UNIFORM_BUFFER, matrixUBO);
-    glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
-    glBindBufferBase(GL_UNIFORM_BUFFER, 0, matrixUBO);
-
-    constexpr int LIGHT_BUFFER_SIZE = POINT_LIGHT_SIZE * MAX_POINT_LIGHTS +
-                                      SPOT_LIGHT_SIZE * MAX_SPOT_LIGHTS +
-                                      DIRECTIONAL_LIGHT_SIZE * MAX_DIRECTIONAL_LIGHTS +
-                                      64 * (MAX_POINT_LIGHTS + MAX_SPOT_LIGHTS + MAX_DIRECTIONAL_LIGHTS * DIR_LIGHT_NUM_CASCADES) +
-                                      16;
-    glBindBuffer(GL_UNIFORM_BUFFER, lightUBO);
-    glBufferData(GL_UNIFORM_BUFFER, LIGHT_BUFFER_SIZE, nullptr, GL_DYNAMIC_DRAW);
-    std::vector<std::byte> bufferData(LIGHT_BUFFER_SIZE);
-    auto bufferPointer = bufferData.data();
-    for (std::size_t i = 0; i < pointLights.size(); i++) {
-        int offset = POINT_LIGHT_SIZE * i;
-        const auto& light = pointLights[i];
-        copyLightColor(bufferPointer + offset, light);
-        copyLightPosition(bufferPointer + offset + 48, light);
-        copyLightRadius(bufferPointer + offset + 60, light);
-    }
-    for (std::size_t i = 0; i < spotLights.size(); i++) {
-        int offset = POINT_LIGHT_SIZE * MAX_POINT_LIGHTS + SPOT_LIGHT_SIZE * i;
-        const auto& light = spotLights[i];
-        copyLightColor(bufferPointer + offset, light);
-        copyLightPosition(bufferPointer + offset + 48, light);
-        copyLightRadius(bufferPointer + offset + 60, light);
-        copyLightDirection(bufferPointer + offset + 64, light);
-        copyLightAngle(bufferPointer + offset + 76, light);
-    }
-    for (std::size_t i = 0; i < directionalLights.size(); i++) {
-        int offset = POINT_LIGHT_SIZE * MAX_POINT_LIGHTS + SPOT_LIGHT_SIZE * MAX_SPOT_LIGHTS + DIRECTIONAL_LIGHT_SIZE * i;
-        const auto& light = directionalLights[i];
-        copyLightColor(bufferPointer + offset, light);
-        copyLightDirection(bufferPointer + offset + 48, light);
-    }
-    {
-        int baseOffset = LIGHT_BUFFER_SIZE - 16;
-        std::memcpy(bufferPointer + baseOffset + 0, &numPointLights, 4);
-        std::memcpy(bufferPointer + baseOffset + 8, &numDirectionalLights, 4);
-    }
-    glBufferSubData(GL_UNIFORM_BUFFER, 0, LIGHT_BUFFER_SIZE, bufferData.data());
-    bufferData.clear();
-    glBindBufferBase(GL_UNIFORM_BUFFER, 1, lightUBO);
-
-    glUseProgram(cubeShaderProgram);
-    glUniformBlockBinding(cubeShaderProgram, glGetUniformBlockIndex(cubeShaderProgram, "MatrixBlock"), 0);
-    glUniformBlockBinding(cubeShaderProgram, glGetUniformBlockIndex(cubeShaderProgram, "LightsBlock"), 1);
-    glUniform1i(glGetUniformLocation(cubeShaderProgram, "material.diffuseMap"), 0);
-    glUniform1i(glGetUniformLocation(cubeShaderProgram, "material.specularMap"), 1);
-    glUniform1i(glGetUniformLocation(cubeShaderProgram, "pointLightShadowMapArray"), 10);
-    glUniform1i(glGetUniformLocation(cubeShaderProgram, "spotLightShadowMapArray"), 11);
-    glUniform1i(glGetUniformLocation(cubeShaderProgram, "dirLightShadowMapArray"), 12);
-
-    glUseProgram(cubeNormalShaderProgram);
-    glUniformBlockBinding(cubeNormalShaderProgram, glGetUniformBlockIndex(cubeNormalShaderProgram, "MatrixBlock"), 0);
-    glUniform1f(glGetUniformLocation(cubeNormalShaderProgram, "normalScale"), 0.2f);
-    glUniform3fv(glGetUniformLocation(cubeNormalShaderProgram, "normalColor"), 1, glm::value_ptr(glm::vec3(1.0f, 1.0f, 0.0f)));
-
-    glUseProgram(lampShaderProgram);
-    glUniformBlockBinding(lampShaderProgram, glGetUniformBlockIndex(lampShaderProgram, "MatrixBlock"), 0);
-
-    glUseProgram(TAAShaderProgram);
-    glUniform1i(glGetUniformLocation(TAAShaderProgram, "frames"), 0);
-    glUniform1i(glGetUniformLocation(TAAShaderProgram, "numFrames"), TAASamples);
-
-    glUseProgram(greyscaleShaderProgram);
-    glUniform1i(glGetUniformLocation(greyscaleShaderProgram, "inputFrame"), 0);
-
-    glUseProgram(bloomExtractShaderProgram);
-    glUniform1i(glGetUniformLocation(bloomExtractShaderProgram, "inputFrame"), 0);
-    glUniform1f(glGetUniformLocation(bloomExtractShaderProgram, "intencity"), bloomIntencity);
-
-    glUseProgram(bloomCombineShaderProgram);
-    glUniform1i(glGetUniformLocation(bloomCombineShaderProgram, "baseFrame"), 0);
-    glUniform1i(glGetUniformLocation(bloomCombineShaderProgram, "bloomFrame"), 1);
-
-    glUseProgram(blurShaderProgram);
-    glUniform1i(glGetUniformLocation(blurShaderProgram, "inputFrame"), 0);
-
-    glUseProgram(cubeMapShaderProgram);
-    glUniform1i(glGetUniformLocation(cubeMapShaderProgram, "cubeMap"), 0);
-
-    glUseProgram(snowShaderProgram);
-    glUniformBlockBinding(snowShaderProgram, glGetUniformBlockIndex(snowShaderProgram, "MatrixBlock"), 0);
-    glUniformBlockBinding(snowShaderProgram, glGetUniformBlockIndex(snowShaderProgram, "LightsBlock"), 1);
-    glUniformMatrix4fv(glGetUniformLocation(snowShaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(snowParticleModel));
-    glUniform1f(glGetUniformLocation(snowShaderProgram, "freq"), 0.1f);
-    glUniform1i(glGetUniformLocation(snowShaderProgram, "material.diffuseMap"), 0);
-    glUniform1i(glGetUniformLocation(snowShaderProgram, "material.specularMap"), 1);
-    glUniform1i(glGetUniformLocation(snowShaderProgram, "pointLightShadowMapArray"), 10);
-    glUniform1i(glGetUniformLocation(snowShaderProgram, "spotLightShadowMapArray"), 11);
-    glUniform1i(glGetUniformLocation(snowShaderProgram, "dirLightShadowMapArray"), 12);
-    glUniform1f(glGetUniformLocation(snowShaderProgram, "material.shininess"), 64.0f);
-
-    glUseProgram(gammaCorrectionShaderProgram);
-    glUniform1i(glGetUniformLocation(gammaCorrectionShaderProgram, "inputFrame"), 0);
-    glUniform1f(glGetUniformLocation(gammaCorrectionShaderProgram, "correctionFactor"), 1.0f / gammaValue);
+    // Start streaming the remaining textures
+
+    TextureLoader::requestTextureCubeMap(cubeMapFaceTextures);
+    ProgramCache::update();
+
+    // The LightsBlock of triangle.frag, std140 packs the matrices and the
+    // ints without padding and rounds the block up to a vec4
+    struct alignas(16) LightsBlock {
+        glm::mat4 pointLightTransforms[MAX_SHADOWED_POINT_LIGHTS];
+        glm::mat4 spotLightTransforms[MAX_SHADOWED_SPOT_LIGHTS];
+        glm::mat4 directionalLightTransforms[MAX_SHADOWED_DIRECTIONAL_LIGHTS * DIR_LIGHT_NUM_CASCADES];
+        GLint numPointLights;
+        GLint numSpotLights;
+        GLint numDirectionalLights;
+        GLint spotLightsStart;
+        GLint directionalLightsStart;
+    };
+    GLintptr matrixBlockOffset = frameUniforms.reserve(2 * sizeof(glm::mat4));
+    GLintptr lightBlockOffset = frameUniforms.reserve(sizeof(LightsBlock));
+    frameUniforms.create();
+
+    ProgramCache::finishPrograms();
+    ProgramCache::releaseShaders();
+
+    LampUniforms lampUniforms(lampShaderProgram), lampBorderUniforms(lampBorderShaderProgram);
+    ShadowUniforms shadowUniforms(shadowShaderProgram);
+    SkyboxUniforms skyboxUniforms(cubeMapShaderProgram);
+    BlurUniforms blurUniforms(blurShaderProgram);
+    ProfilerUniforms profilerUniforms(profilerShaderProgram);
+
+    // Setup functions run again whenever their program is reloaded
+
+    auto setupLitProgram = [&](GLuint program) {
+        glUseProgram(program);
+        glUniformBlockBinding(program, glGetUniformBlockIndex(program, "MatrixBlock"), 0);
+        glUniformBlockBinding(program, glGetUniformBlockIndex(program, "LightsBlock"), 1);
+        glUniform1i(glGetUniformLocation(program, "diffuseMaps"), 0);
+        glUniform1i(glGetUniformLocation(program, "specularMaps"), 1);
+        glUniform1i(glGetUniformLocation(program, "pointLightShadowMapArray"), 10);
+        glUniform1i(glGetUniformLocation(program, "spotLightShadowMapArray"), 11);
+        glUniform1i(glGetUniformLocation(program, "dirLightShadowMapArray"), 12);
+        lightStorage.setupProgram(program);
+        lightClusters.setupProgram(program);
+    };
+    cubePrograms.setSetupFunction(setupLitProgram);
+
+    ShaderReloader::setSetupFunction(cubeNormalShaderProgram, [](GLuint program) {
+        glUseProgram(program);
+        glUniformBlockBinding(program, glGetUniformBlockIndex(program, "MatrixBlock"), 0);
+        glUniform1f(glGetUniformLocation(program, "normalScale"), 0.2f);
+        glUniform3fv(glGetUniformLocation(program, "normalColor"), 1, glm::value_ptr(glm::vec3(1.0f, 1.0f, 0.0f)));
+    });
+
+    ShaderReloader::setSetupFunction(lampShaderProgram, [&](GLuint program) {
+        glUseProgram(program);
+        glUniformBlockBinding(program, glGetUniformBlockIndex(program, "MatrixBlock"), 0);
+        lampUniforms = LampUniforms(program);
+    });
+    ShaderReloader::setSetupFunction(lampBorderShaderProgram, [&](GLuint program) {
+        lampBorderUniforms = LampUniforms(program);
+    });
+
+    ShaderReloader::setSetupFunction(TAAShaderProgram, [&](GLuint program) {
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "frames"), 0);
+        glUniform1i(glGetUniformLocation(program, "numFrames"), TAASamples);
+    });
+
+    ShaderReloader::setSetupFunction(greyscaleShaderProgram, [](GLuint program) {
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "inputFrame"), 0);
+    });
+
+    ShaderReloader::setSetupFunction(bloomExtractShaderProgram, [&](GLuint program) {
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "inputFrame"), 0);
+        glUniform1f(glGetUniformLocation(program, "intencity"), bloomIntencity);
+    });
+
+    ShaderReloader::setSetupFunction(bloomCombineShaderProgram, [](GLuint program) {
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "baseFrame"), 0);
+        glUniform1i(glGetUniformLocation(program, "bloomFrame"), 1);
+    });
+
+    ShaderReloader::setSetupFunction(blurShaderProgram, [&](GLuint program) {
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "inputFrame"), 0);
+        blurUniforms = BlurUniforms(program);
+    });
+
+    ShaderReloader::setSetupFunction(cubeMapShaderProgram, [&](GLuint program) {
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "cubeMap"), 0);
+        skyboxUniforms = SkyboxUniforms(program);
+    });
+
+    snowPrograms.setSetupFunction([&](GLuint program) {
+        setupLitProgram(program);
+        glUniformMatrix4fv(glGetUniformLocation(program, "model"), 1, GL_FALSE, glm::value_ptr(snowParticleModel));
+        glUniform1f(glGetUniformLocation(program, "freq"), 0.1f);
+        glUniform1f(glGetUniformLocation(program, "shininess"), 64.0f);
+    });
+
+    ShaderReloader::setSetupFunction(gammaCorrectionShaderProgram, [&](GLuint program) {
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "inputFrame"), 0);
+        glUniform1f(glGetUniformLocation(program, "correctionFactor"), 1.0f / gammaValue);
+    });
+
+    ShaderReloader::setSetupFunction(shadowShaderProgram, [&](GLuint program) {
+        shadowUniforms = ShadowUniforms(program);
+    });
+
+    ShaderReloader::setSetupFunction(profilerShaderProgram, [&](GLuint program) {
+        profilerUniforms = ProfilerUniforms(program);
+    });
 
     glUseProgram(shadowShaderProgram);
 
     float forwardAxisValue, rightAxisValue, upAxisValue;
 
     float previousTime = 0.0f;
+    int frameNumber = 0;
 
     auto window = CameraManager::getWindow();
 
-    while (not glfwWindowShouldClose(window)) {
-        float currentTime = glfwGetTime();
+    // Appends the instances of a range of opaque draws inside of any of the view volumes
+    auto cullInstances = [&](const std::vector<glm::mat4>& viewProjections, bool bDepth, int firstCommand, int numCommands, std::vector<GLuint>& visible) {
+        const auto& firstDraw = opaqueDrawCommands.getCommand(firstCommand);
+        const auto& lastDraw = opaqueDrawCommands.getCommand(firstCommand + numCommands - 1);
+        GLuint firstInstance = firstDraw.baseInstance, endInstance = lastDraw.baseInstance + lastDraw.instanceCount;
+        if (launchOptions.bCulling) {
+            sceneCuller.cull(viewProjections, bDepth, firstInstance, endInstance - firstInstance, visible);
+        } else {
+            for (GLuint i = firstInstance; i < endInstance; i++) {
+                visible.push_back(i);
+            }
+        }
+    };
+
+    std::vector<GLuint> visibleInstances;
+    auto cullScene = [&](const std::vector<glm::mat4>& viewProjections, bool bDepth, int firstCommand, int numCommands) {
+        ScopedCPUZone cpuZone("Cull scene");
+        visibleInstances.clear();
+        cullInstances(viewProjections, bDepth, firstCommand, numCommands, visibleInstances);
+        visibleSceneInstances.update(opaqueDrawCommands, firstCommand, numCommands, visibleInstances);
+    };
+
+    // With layered instancing every layer gets the casters inside of its own
+    // view volume. The geometry shader draws every caster into all layers, so
+    // there a caster inside of any of them is kept.
+    std::vector<std::vector<GLuint>> layerInstances;
+    auto cullShadowCasters = [&](const std::vector<glm::mat4>& lightTransforms, bool bDepth) {
+        if (!bLayeredShadows) {
+            cullScene(lightTransforms, bDepth, cubeDraw, 2);
+            return;
+        }
+        ScopedCPUZone cpuZone("Cull shadow casters");
+        layerInstances.resize(lightTransforms.size());
+        for (std::size_t layer = 0; layer < lightTransforms.size(); layer++) {
+            layerInstances[layer].clear();
+            cullInstances({lightTransforms[layer]}, bDepth, cubeDraw, 2, layerInstances[layer]);
+        }
+        visibleSceneInstances.updateLayered(opaqueDrawCommands, cubeDraw, 2, layerInstances);
+    };
+
+    // Benchmark frames should not include texture uploads
+    if (bBenchmark) {
+        TextureLoader::waitForTextures();
+    }
+
+    while (not CameraManager::shouldClose() and (!launchOptions.numFrames or frameNumber < launchOptions.numFrames)) {
+        ScopedCPUZone frameZone("Frame");
+        float currentTime = bBenchmark ? benchmark.getFrameTime(frameNumber) : CameraManager::getTime();
         float deltaTime = currentTime - previousTime;
 
         forwardAxisValue = 0.0f;
@@ -1012,91 +1302,121 @@ int main() {
         bFlashLight = false;
         bGreyScale = false;
 
+        if (bBenchmark) {
+            const auto& configuration = benchmark.getConfiguration(frameNumber);
+            bMSAA = configuration.bMSAA;
+            bTAA = configuration.bTAA;
+            bBloom = configuration.bBloom;
+            bSnow = configuration.bSnow;
+            bSkybox = configuration.bSkybox;
+            benchmark.applyCameraPath(*camera, frameNumber);
+            benchmark.beginFrame(frameNumber);
+        }
+        GPUProfiler::beginFrame();
+        ShaderReloader::update();
+        ProgramCache::update();
+        TextureLoader::update();
+
         // Input
 
-        if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS) {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        }
-        if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS) {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        }
-        if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS) {
-            bTAA = false;
-        }
-        if (glfwGetKey(window, GLFW_KEY_4) == GLFW_PRESS) {
-            bTAA = true;
-        }
-        if (glfwGetKey(window, GLFW_KEY_5) == GLFW_PRESS) {
-            bMSAA = false;
-        }
-        if (glfwGetKey(window, GLFW_KEY_6) == GLFW_PRESS) {
-            bMSAA = true;
-        }
-        if (glfwGetKey(window, GLFW_KEY_7) == GLFW_PRESS) {
-            bBloom = false;
-        }
-        if (glfwGetKey(window, GLFW_KEY_8) == GLFW_PRESS) {
-            bBloom = true;
-        }
-        if (glfwGetKey(window, GLFW_KEY_9) == GLFW_PRESS) {
-            bSkybox = false;
-        }
-        if (glfwGetKey(window, GLFW_KEY_0) == GLFW_PRESS) {
-            bSkybox = true;
-        }
-        if (glfwGetKey(window, GLFW_KEY_LEFT_BRACKET) == GLFW_PRESS) {
-            bBorder = false;
-        }
-        if (glfwGetKey(window, GLFW_KEY_RIGHT_BRACKET) == GLFW_PRESS) {
-            bBorder = true;
-        }
-        if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS) {
-            bSnow = false;
-        }
-        if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS) {
-            bSnow = true;
-        }
-        if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS) {
-            bGammaCorrect = false;
-        }
-        if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS) {
-            bGammaCorrect = true;
-        }
-        if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
-            CameraManager::disableCameraLook();
-        }
-        if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) {
-            CameraManager::enableCameraLook();
-        }
-        if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
-            forwardAxisValue += 1.0f;
-        }
-        if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
-            forwardAxisValue -= 1.0f;
-        }
-        if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
-            rightAxisValue += 1.0f;
-        }
-        if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
-            rightAxisValue -= 1.0f;
-        }
-        if (glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS) {
-            upAxisValue -= 1.0f;
-        }
-        if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS) {
-            upAxisValue += 1.0f;
-        }
-        if (glfwGetKey(window, GLFW_KEY_TAB) == GLFW_PRESS) {
-            bGreyScale = true;
-        }
-        if (glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS) {
-            bShowMag = true;
-        }
-        if (glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS) {
-            bShowMag = false;
-        }
-        if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS) {
-            bFlashLight = true;
+        if (window and !bBenchmark) {
+            if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS) {
+                glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+            }
+            if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS) {
+                glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+            }
+            if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS) {
+                bTAA = false;
+            }
+            if (glfwGetKey(window, GLFW_KEY_4) == GLFW_PRESS) {
+                bTAA = true;
+            }
+            if (glfwGetKey(window, GLFW_KEY_5) == GLFW_PRESS) {
+                bMSAA = false;
+            }
+            if (glfwGetKey(window, GLFW_KEY_6) == GLFW_PRESS) {
+                bMSAA = true;
+            }
+            if (glfwGetKey(window, GLFW_KEY_7) == GLFW_PRESS) {
+                bBloom = false;
+            }
+            if (glfwGetKey(window, GLFW_KEY_8) == GLFW_PRESS) {
+                bBloom = true;
+            }
+            if (glfwGetKey(window, GLFW_KEY_9) == GLFW_PRESS) {
+                bSkybox = false;
+            }
+            if (glfwGetKey(window, GLFW_KEY_0) == GLFW_PRESS) {
+                bSkybox = true;
+            }
+            if (glfwGetKey(window, GLFW_KEY_LEFT_BRACKET) == GLFW_PRESS) {
+                bBorder = false;
+            }
+            if (glfwGetKey(window, GLFW_KEY_RIGHT_BRACKET) == GLFW_PRESS) {
+                bBorder = true;
+            }
+            if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS) {
+                bSnow = false;
+            }
+            if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS) {
+                bSnow = true;
+            }
+            if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS) {
+                bGammaCorrect = false;
+            }
+            if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS) {
+                bGammaCorrect = true;
+            }
+            if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS) {
+                bShadows = false;
+            }
+            if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS) {
+                bShadows = true;
+            }
+            if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
+                CameraManager::disableCameraLook();
+            }
+            if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) {
+                CameraManager::enableCameraLook();
+            }
+            if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
+                forwardAxisValue += 1.0f;
+            }
+            if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
+                forwardAxisValue -= 1.0f;
+            }
+            if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
+                rightAxisValue += 1.0f;
+            }
+            if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
+                rightAxisValue -= 1.0f;
+            }
+            if (glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS) {
+                upAxisValue -= 1.0f;
+            }
+            if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS) {
+                upAxisValue += 1.0f;
+            }
+            if (glfwGetKey(window, GLFW_KEY_TAB) == GLFW_PRESS) {
+                bGreyScale = true;
+            }
+            if (glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS) {
+                bShowMag = true;
+            }
+            if (glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS) {
+                bShowMag = false;
+            }
+            if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS) {
+                bFlashLight = true;
+            }
+            if (glfwGetKey(window, GLFW_KEY_F1) == GLFW_PRESS) {
+                bShowProfiler = true;
+            }
+            if (glfwGetKey(window, GLFW_KEY_F2) == GLFW_PRESS) {
+                bShowProfiler = false;
+                glfwSetWindowTitle(window, "OpenGL tutorial");
+            }
         }
 
         auto cameraForward = camera->getCameraForwardVector();
@@ -1110,28 +1430,42 @@ int main() {
             camera->addLocationOffset(glm::normalize(inputVector) * deltaTime * cameraSpeed);
         }
 
-        glBindBuffer(GL_UNIFORM_BUFFER, lightUBO);
+        // Uniform blocks of this frame are written straight into the ring buffer
+
+        frameUniforms.beginFrame();
+        // The flashlight is the last spot light and only counts while it is on
+        int numUsedSpotLights = std::max(numSpotLights - !bFlashLight, 0);
+        std::byte* lightBlock = frameUniforms.getPointer(lightBlockOffset);
         if (bFlashLight and numSpotLights > 0) {
             spotLights.back().direction = camera->getCameraForwardVector();
             spotLights.back().position = camera->getCameraPos();
-            int offset = POINT_LIGHT_SIZE * MAX_POINT_LIGHTS + SPOT_LIGHT_SIZE * (spotLights.size() - 1);
-            glBufferSubData(GL_UNIFORM_BUFFER, offset + 48, 12, glm::value_ptr(spotLights.back().position));
-            glBufferSubData(GL_UNIFORM_BUFFER, offset + 64, 12, glm::value_ptr(spotLights.back().direction));
+            lightStorage.updateSpotLight(spotLights.size() - 1, spotLights.back());
+            lightStorage.upload();
+            lightClusters.updateSpotLight(spotLights.size() - 1, spotLights.back());
         }
         {
-            int numUsedSpotlights = std::max(numSpotLights - !bFlashLight, 0);
-            int offset = LIGHT_BUFFER_SIZE - 16 + 4;
-            glBufferSubData(GL_UNIFORM_BUFFER, offset, 4, &numUsedSpotlights);
+            GLint spotLightsStart = lightStorage.getSpotLightsStart(), directionalLightsStart = lightStorage.getDirectionalLightsStart();
+            std::memcpy(lightBlock + offsetof(LightsBlock, numPointLights), &numPointLights, sizeof(GLint));
+            std::memcpy(lightBlock + offsetof(LightsBlock, numSpotLights), &numUsedSpotLights, sizeof(GLint));
+            std::memcpy(lightBlock + offsetof(LightsBlock, numDirectionalLights), &numDirectionalLights, sizeof(GLint));
+            std::memcpy(lightBlock + offsetof(LightsBlock, spotLightsStart), &spotLightsStart, sizeof(GLint));
+            std::memcpy(lightBlock + offsetof(LightsBlock, directionalLightsStart), &directionalLightsStart, sizeof(GLint));
         }
 
         glm::mat4 view = CameraManager::getViewMatrix(),
                   projection = CameraManager::getProjectionMatrix();
+        lightClusters.setFrustum(CameraManager::getVerticalFOV(), CameraManager::getAspectRatio(), CameraManager::getNearPlane(), CameraManager::getFarPlane());
+        lightClusters.assign(view, numUsedSpotLights);
+        lightClusters.upload();
+        glm::vec4 clusterScale = lightClusters.getClusterScale(windowW, windowH);
+        glm::vec2 clusterDepthRange(CameraManager::getNearPlane(), CameraManager::getFarPlane());
         if (bTAA) {
             glm::vec3 sampleTrans = TAASamplesPositions[colorIndex];
             sampleTrans.x /= windowW;
             sampleTrans.y /= windowH;
             projection = glm::translate(glm::mat4(1.0f), sampleTrans) * projection;
         }
+        glm::mat4 cameraViewProjection = projection * view;
 
         // Generate shadowmaps
 
@@ -1151,7 +1485,8 @@ int main() {
             {{0.0f, -1.0f, 0.0f}, {0.0f, 0.0f, -1.0f}},
             {{0.0f, 0.0f, 1.0f}, {0.0f, -1.0f, 0.0f}},
             {{0.0f, 0.0f, -1.0f}, {0.0f, -1.0f, 0.0f}}};
-        for (const auto& pl: pointLights) {
+        for (auto it = pointLights.begin(); it < pointLights.begin() + numShadowedPointLights; it++) {
+            const auto& pl = *it;
             const auto& lightPos = pl.position;
             float lightRadius = pl.radius;
             glm::mat4 lightProjection = glm::perspective(glm::radians(90.0f), 1.0f, lightRadius, 100.0f);
@@ -1166,15 +1501,17 @@ int main() {
             pointLightMinSampleSizes.push_back(lightMinSampleSize);
             pointLightMaxSampleSizes.push_back(lightMaxSampleSize);
         }
-        if (numPointLights) {
+        if (bShadows and numShadowedPointLights) {
+            ScopedGPUTimer gpuTimer("Point light shadows");
             glViewport(0, 0, POINT_LIGHT_SHADOWMAP_RESOLUTION, POINT_LIGHT_SHADOWMAP_RESOLUTION);
             glBindFramebuffer(GL_FRAMEBUFFER, shadowMapFBO);
             glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, pointLightShadowCubeMapArray, 0);
             glClear(GL_DEPTH_BUFFER_BIT);
-            drawShadowCasters(shadowShaderProgram, pointLightRenderTransformMatrices, cubeVAO, cubeMatrices, cubeVertexIndices.size(), pyramidVAO, pyramidMatrices, pyramidVertexIndices.size());
+            cullShadowCasters(pointLightRenderTransformMatrices, true);
+            drawShadowCasters(shadowShaderProgram, shadowUniforms, pointLightRenderTransformMatrices, sceneVAO, visibleSceneInstances, cubeDraw, 2);
         }
 
-        for (auto it = spotLights.begin(); it < spotLights.end() - !bFlashLight; it++) {
+        for (auto it = spotLights.begin(); it < spotLights.begin() + std::min(numUsedSpotLights, MAX_SHADOWED_SPOT_LIGHTS); it++) {
             const auto& sl = *it;
             const auto& lightDir = sl.direction;
             const auto& lightPos = sl.position;
@@ -1191,15 +1528,17 @@ int main() {
             spotLightMinSampleSizes.push_back(lightMinSampleSize);
             spotLightMaxSampleSizes.push_back(lightMaxSampleSize);
         }
-        int numUsedSpotLights = std::max(numSpotLights - !bFlashLight, 0);
-        if (numUsedSpotLights) {
+        if (bShadows and numUsedSpotLights) {
+            ScopedGPUTimer gpuTimer("Spot light shadows");
             glViewport(0, 0, SPOT_LIGHT_SHADOWMAP_RESOLUTION, SPOT_LIGHT_SHADOWMAP_RESOLUTION);
             glBindFramebuffer(GL_FRAMEBUFFER, shadowMapFBO);
             glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, spotLightShadowMapArray, 0);
             glClear(GL_DEPTH_BUFFER_BIT);
-            drawShadowCasters(shadowShaderProgram, spotLightTransformMatrices, cubeVAO, cubeMatrices, cubeVertexIndices.size(), pyramidVAO, pyramidMatrices, pyramidVertexIndices.size());
+            cullShadowCasters(spotLightTransformMatrices, true);
+            drawShadowCasters(shadowShaderProgram, shadowUniforms, spotLightTransformMatrices, sceneVAO, visibleSceneInstances, cubeDraw, 2);
         }
 
+        auto cascadeZoneStart = CPUProfiler::now();
         float cascadePlaneRelation = glm::pow(CameraManager::getFarPlane() / CameraManager::getNearPlane(), 1.0f / numDirLightCascades);
         std::vector<std::pair<glm::mat4, float>> cascadeProperties;
         glm::vec4 cascadeNearPlanes, cascadeFarPlanes;
@@ -1243,8 +1582,8 @@ int main() {
             cascadeFarPlanes[i] = convertDepth(f);
         }
 
-        for (const auto& dl: directionalLights) {
-            const auto& lightDir = dl.direction;
+        for (auto it = directionalLights.begin(); it < directionalLights.begin() + numShadowedDirectionalLights; it++) {
+            const auto& lightDir = it->direction;
             glm::vec3 lightUp = calculateLightUp(lightDir);
             glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), lightDir, lightUp);
 
@@ -1281,29 +1620,29 @@ int main() {
                 dirLightSampleSizes.push_back(cascadeBoundingBoxSize / DIR_LIGHT_SHADOWMAP_RESOLUTION);
             }
         }
-        if (numDirectionalLights) {
+        CPUProfiler::recordZone("Cascade matrices", cascadeZoneStart, CPUProfiler::now());
+        if (bShadows and numShadowedDirectionalLights) {
+            ScopedGPUTimer gpuTimer("Directional light shadows");
             glViewport(0, 0, DIR_LIGHT_SHADOWMAP_RESOLUTION, DIR_LIGHT_SHADOWMAP_RESOLUTION);
             glEnable(GL_DEPTH_CLAMP);
             glBindFramebuffer(GL_FRAMEBUFFER, shadowMapFBO);
             glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, directionalLightShadowMapArray, 0);
             glClear(GL_DEPTH_BUFFER_BIT);
-            drawShadowCasters(shadowShaderProgram, directionalLightTransformMatrices, cubeVAO, cubeMatrices, cubeVertexIndices.size(), pyramidVAO, pyramidMatrices, pyramidVertexIndices.size());
+            // Casters in front of a cascade are clamped onto its near plane, so only the sides cull
+            cullShadowCasters(directionalLightTransformMatrices, false);
+            drawShadowCasters(shadowShaderProgram, shadowUniforms, directionalLightTransformMatrices, sceneVAO, visibleSceneInstances, cubeDraw, 2);
             glDisable(GL_DEPTH_CLAMP);
         }
         glViewport(0, 0, windowW, windowH);
 
         {
-            int bufferSize = 64 * (MAX_DIRECTIONAL_LIGHTS * DIR_LIGHT_NUM_CASCADES + MAX_SPOT_LIGHTS + MAX_POINT_LIGHTS);
-            int bufferOffset = LIGHT_BUFFER_SIZE - 16 - bufferSize;
-            std::vector<std::byte> ptr(bufferSize);
-            int writeOffset = 0;
-            std::memcpy(ptr.data() + writeOffset, pointLightTransformMatrices.data(), sizeof(glm::mat4) * pointLightTransformMatrices.size());
-            writeOffset += 64 * MAX_POINT_LIGHTS;
-            std::memcpy(ptr.data() + writeOffset, spotLightTransformMatrices.data(), sizeof(glm::mat4) * spotLightTransformMatrices.size());
-            writeOffset += 64 * MAX_SPOT_LIGHTS;
-            std::memcpy(ptr.data() + writeOffset, directionalLightTransformMatrices.data(), sizeof(glm::mat4) * directionalLightTransformMatrices.size());
-            glBindBuffer(GL_UNIFORM_BUFFER, lightUBO);
-            glBufferSubData(GL_UNIFORM_BUFFER, bufferOffset, bufferSize, ptr.data());
+            ScopedCPUZone cpuZone("Upload light transforms");
+            std::memcpy(lightBlock + offsetof(LightsBlock, pointLightTransforms), pointLightTransformMatrices.data(),
+                        sizeof(glm::mat4) * pointLightTransformMatrices.size());
+            std::memcpy(lightBlock + offsetof(LightsBlock, spotLightTransforms), spotLightTransformMatrices.data(),
+                        sizeof(glm::mat4) * spotLightTransformMatrices.size());
+            std::memcpy(lightBlock + offsetof(LightsBlock, directionalLightTransforms), directionalLightTransformMatrices.data(),
+                        sizeof(glm::mat4) * directionalLightTransformMatrices.size());
         }
 
         // Start drawing
@@ -1313,29 +1652,42 @@ int main() {
         if (bMSAA) {
             glBindFramebuffer(GL_FRAMEBUFFER, MSFBO);
         }
-        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+        {
+            ScopedGPUTimer gpuTimer("Clear");
+            glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+        }
 
-        glBindBuffer(GL_UNIFORM_BUFFER, matrixUBO);
-        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(projection));
-        glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(view));
+        std::byte* matrixBlock = frameUniforms.getPointer(matrixBlockOffset);
+        std::memcpy(matrixBlock, glm::value_ptr(projection), sizeof(glm::mat4));
+        std::memcpy(matrixBlock + sizeof(glm::mat4), glm::value_ptr(view), sizeof(glm::mat4));
+        frameUniforms.flush();
+        frameUniforms.bindRange(GL_UNIFORM_BUFFER, 0, matrixBlockOffset, 2 * sizeof(glm::mat4));
+        frameUniforms.bindRange(GL_UNIFORM_BUFFER, 1, lightBlockOffset, sizeof(LightsBlock));
 
         // Setup model draw parameters
 
         glEnable(GL_CULL_FACE);
 
-        glUseProgram(cubeShaderProgram);
-
-        glUniform3fv(glGetUniformLocation(cubeShaderProgram, "cameraPos"), 1, glm::value_ptr(camera->getCameraPos()));
-        glUniform1fv(glGetUniformLocation(cubeShaderProgram, "pointLightMinSampleSizes"), pointLightMinSampleSizes.size(), pointLightMinSampleSizes.data());
-        glUniform1fv(glGetUniformLocation(cubeShaderProgram, "pointLightMaxSampleSizes"), pointLightMaxSampleSizes.size(), pointLightMaxSampleSizes.data());
-        glUniform1fv(glGetUniformLocation(cubeShaderProgram, "spotLightMinSampleSizes"), spotLightMinSampleSizes.size(), spotLightMinSampleSizes.data());
-        glUniform1fv(glGetUniformLocation(cubeShaderProgram, "spotLightMaxSampleSizes"), spotLightMaxSampleSizes.size(), spotLightMaxSampleSizes.data());
-        glUniform1fv(glGetUniformLocation(cubeShaderProgram, "dirLightSampleSizes"), dirLightSampleSizes.size(), dirLightSampleSizes.data());
-        glUniform4fv(glGetUniformLocation(cubeShaderProgram, "dirLightCascadeNearDepths"), 1, glm::value_ptr(cascadeNearPlanes));
-        glUniform4fv(glGetUniformLocation(cubeShaderProgram, "dirLightCascadeFarDepths"), 1, glm::value_ptr(cascadeFarPlanes));
-        glUniform1i(glGetUniformLocation(cubeShaderProgram, "dirLightNumCascades"), numDirLightCascades);
-
+        LightingPermutation lightingPermutation = {numPointLights, numUsedSpotLights, numDirectionalLights, numDirLightCascades, bShadows};
+        const auto& cubeVariant = cubePrograms.get(lightingPermutation);
+        const auto& cubeUniforms = *cubeVariant.uniforms;
+        glUseProgram(cubeVariant.program);
+
+        cubeUniforms.cameraPos.set(camera->getCameraPos());
+        cubeUniforms.pointLightMinSampleSizes.set(pointLightMinSampleSizes.data(), pointLightMinSampleSizes.size());
+        cubeUniforms.pointLightMaxSampleSizes.set(pointLightMaxSampleSizes.data(), pointLightMaxSampleSizes.size());
+        cubeUniforms.spotLightMinSampleSizes.set(spotLightMinSampleSizes.data(), spotLightMinSampleSizes.size());
+        cubeUniforms.spotLightMaxSampleSizes.set(spotLightMaxSampleSizes.data(), spotLightMaxSampleSizes.size());
+        cubeUniforms.dirLightSampleSizes.set(dirLightSampleSizes.data(), dirLightSampleSizes.size());
+        cubeUniforms.dirLightCascadeNearDepths.set(cascadeNearPlanes);
+        cubeUniforms.dirLightCascadeFarDepths.set(cascadeFarPlanes);
+        cubeUniforms.dirLightNumCascades.set(numDirLightCascades);
+        cubeUniforms.clusterScale.set(clusterScale);
+        cubeUniforms.clusterDepthRange.set(clusterDepthRange);
+
+        lightStorage.bind();
+        lightClusters.bind();
         glActiveTexture(GL_TEXTURE10);
         glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY_ARB, pointLightShadowCubeMapArray);
         glActiveTexture(GL_TEXTURE11);
@@ -1343,96 +1695,89 @@ int main() {
         glActiveTexture(GL_TEXTURE12);
         glBindTexture(GL_TEXTURE_2D_ARRAY, directionalLightShadowMapArray);
 
-        // Draw cubes
-
-        setShaderMatrial(cubeShaderProgram, cubeMaterial);
-
-        for (const auto& [m, n]: cubeMatrices) {
-            setModelUniforms(cubeShaderProgram, m, n);
-            glBindVertexArray(cubeVAO);
-            glDrawElements(GL_TRIANGLES, cubeVertexIndices.size(), GL_UNSIGNED_INT, nullptr);
-        }
-
-        // Draw pyramids
-
-        setShaderMatrial(cubeShaderProgram, pyramidMaterial);
-
-        for (const auto& [m, n]: pyramidMatrices) {
-            setModelUniforms(cubeShaderProgram, m, n);
-            glBindVertexArray(pyramidVAO);
-            glDrawElements(GL_TRIANGLES, pyramidVertexIndices.size(), GL_UNSIGNED_INT, nullptr);
+        // Draw cubes and pyramids
+        cullScene({cameraViewProjection}, true, cubeDraw, 3);
+        {
+            ScopedGPUTimer gpuTimer("Draw cubes and pyramids");
+            glBindVertexArray(sceneVAO);
+            bindMaterialTextures(cubeLayers);
+            if (hasSameArrays(cubeLayers, pyramidLayers)) {
+                visibleSceneInstances.draw(cubeDraw, 2);
+            } else {
+                visibleSceneInstances.draw(cubeDraw, 1);
+                bindMaterialTextures(pyramidLayers);
+                visibleSceneInstances.draw(cubeDraw + 1, 1);
+            }
         }
 
         // Draw floor
+        {
+            ScopedGPUTimer gpuTimer("Draw floor");
+            glDisable(GL_CULL_FACE);
 
-        glDisable(GL_CULL_FACE);
-
-        setShaderMatrial(cubeShaderProgram, circularPlaneMaterial);
-
-        setModelUniforms(cubeShaderProgram, floorModel, floorNormal);
-        glBindVertexArray(floorVAO);
-        glDrawElements(GL_TRIANGLES, circularPlaneVertexIndices.size(), GL_UNSIGNED_INT, nullptr);
+            bindMaterialTextures(floorLayers);
+            visibleSceneInstances.draw(floorDraw, 1);
 
-        glEnable(GL_CULL_FACE);
+            glEnable(GL_CULL_FACE);
+        }
 
         // Draw lamps
+        {
+            ScopedGPUTimer gpuTimer("Draw lamps");
+            if (bBorder) {
+                glEnable(GL_STENCIL_TEST);
+                glStencilFunc(GL_ALWAYS, 1, 0xFF);
+            }
 
-        if (bBorder) {
-            glEnable(GL_STENCIL_TEST);
-            glStencilFunc(GL_ALWAYS, 1, 0xFF);
-        }
+            glUseProgram(lampShaderProgram);
+            glBindVertexArray(lampVAO);
 
-        glUseProgram(lampShaderProgram);
+            for (int i = 0; i < numPointLights; i++) {
+                setLampUniforms(lampUniforms, pointLightMatrices[i], pointLights[i].diffuse);
+                GeometryArena::drawMesh(sphereMesh);
+            }
 
-        for (int i = 0; i < numPointLights; i++) {
-            setLampUniforms(lampShaderProgram, pointLightMatrices[i], pointLights[i].diffuse);
-            glBindVertexArray(pointLightVAO);
-            glDrawElements(GL_TRIANGLES, sphereVertexIndices.size(), GL_UNSIGNED_INT, nullptr);
-        }
+            for (int i = 0; i < numSpotLights - 1; i++) {
+                setLampUniforms(lampUniforms, spotLightMatrices[i], spotLights[i].diffuse);
+                GeometryArena::drawMesh(coneMesh);
+            }
 
-        for (int i = 0; i < numSpotLights - 1; i++) {
-            setLampUniforms(lampShaderProgram, spotLightMatrices[i], spotLights[i].diffuse);
-            glBindVertexArray(spotLightVAO);
-            glDrawElements(GL_TRIANGLES, coneVertexIndices.size(), GL_UNSIGNED_INT, nullptr);
-        }
+            glDisable(GL_CULL_FACE);
 
-        glDisable(GL_CULL_FACE);
+            for (int i = 0; i < numDirectionalLights; i++) {
+                setLampUniforms(lampUniforms, directionalLightMatrices[i], directionalLights[i].diffuse);
+                GeometryArena::drawMesh(squarePlaneMesh);
+            }
 
-        for (int i = 0; i < numDirectionalLights; i++) {
-            setLampUniforms(lampShaderProgram, directionalLightMatrices[i], directionalLights[i].diffuse);
-            glBindVertexArray(directionalLightVAO);
-            glDrawElements(GL_TRIANGLES, squarePlaneVertexIndices.size(), GL_UNSIGNED_INT, nullptr);
+            glEnable(GL_CULL_FACE);
         }
 
-        glEnable(GL_CULL_FACE);
-
         // Draw lamp borders
 
         if (bBorder) {
+            ScopedGPUTimer gpuTimer("Draw lamp borders");
             glStencilFunc(GL_GREATER, 1, 0xFF);
             glStencilMask(0x00);
 
             glm::mat4 silhoutte = glm::scale(glm::mat4(1.0f), 1.05f * glm::vec3(1.0f));
             glUseProgram(lampBorderShaderProgram);
+            glBindVertexArray(lampVAO);
 
             for (int i = 0; i < numPointLights; i++) {
-                setLampUniforms(lampBorderShaderProgram, pointLightMatrices[i] * silhoutte, pointLights[i].diffuse);
-                glBindVertexArray(pointLightVAO);
-                glDrawElements(GL_TRIANGLES, sphereVertexIndices.size(), GL_UNSIGNED_INT, nullptr);
+                setLampUniforms(lampBorderUniforms, pointLightMatrices[i] * silhoutte, pointLights[i].diffuse);
+                GeometryArena::drawMesh(sphereMesh);
             }
 
             for (int i = 0; i < numSpotLights - 1; i++) {
-                setLampUniforms(lampBorderShaderProgram, spotLightMatrices[i] * silhoutte, spotLights[i].diffuse);
-                glBindVertexArray(spotLightVAO);
-                glDrawElements(GL_TRIANGLES, coneVertexIndices.size(), GL_UNSIGNED_INT, nullptr);
+                setLampUniforms(lampBorderUniforms, spotLightMatrices[i] * silhoutte, spotLights[i].diffuse);
+                GeometryArena::drawMesh(coneMesh);
             }
 
             glDisable(GL_CULL_FACE);
 
             for (int i = 0; i < numDirectionalLights; i++) {
-                setLampUniforms(lampBorderShaderProgram, directionalLightMatrices[i] * silhoutte, directionalLights[i].diffuse);
-                glBindVertexArray(directionalLightVAO);
-                glDrawElements(GL_TRIANGLES, squarePlaneVertexIndices.size(), GL_UNSIGNED_INT, nullptr);
+                setLampUniforms(lampBorderUniforms, directionalLightMatrices[i] * silhoutte, directionalLights[i].diffuse);
+                GeometryArena::drawMesh(squarePlaneMesh);
             }
 
             glEnable(GL_CULL_FACE);
@@ -1445,73 +1790,102 @@ int main() {
         // Draw snow
 
         if (bSnow) {
+            ScopedGPUTimer gpuTimer("Draw snow");
             glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, snowDiffuseTexture);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, snowDiffuseTexture);
             glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, snowSpecularTexture);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, snowSpecularTexture);
+            lightStorage.bind();
+            lightClusters.bind();
             glActiveTexture(GL_TEXTURE10);
             glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY_ARB, pointLightShadowCubeMapArray);
             glActiveTexture(GL_TEXTURE11);
             glBindTexture(GL_TEXTURE_2D_ARRAY, spotLightShadowMapArray);
             glActiveTexture(GL_TEXTURE12);
             glBindTexture(GL_TEXTURE_2D_ARRAY, directionalLightShadowMapArray);
-            glUseProgram(snowShaderProgram);
-            glUniform1f(glGetUniformLocation(snowShaderProgram, "time"), glfwGetTime());
-            glUniform3fv(glGetUniformLocation(snowShaderProgram, "cameraPos"), 1, glm::value_ptr(camera->getCameraPos()));
-            glUniform1fv(glGetUniformLocation(snowShaderProgram, "pointLightMinSampleSizes"), pointLightMinSampleSizes.size(), pointLightMinSampleSizes.data());
-            glUniform1fv(glGetUniformLocation(snowShaderProgram, "pointLightMaxSampleSizes"), pointLightMaxSampleSizes.size(), pointLightMaxSampleSizes.data());
-            glUniform1fv(glGetUniformLocation(snowShaderProgram, "spotLightMinSampleSizes"), spotLightMinSampleSizes.size(), spotLightMinSampleSizes.data());
-            glUniform1fv(glGetUniformLocation(snowShaderProgram, "spotLightMaxSampleSizes"), spotLightMaxSampleSizes.size(), spotLightMaxSampleSizes.data());
-            glUniform1fv(glGetUniformLocation(snowShaderProgram, "dirLightSampleSizes"), dirLightSampleSizes.size(), dirLightSampleSizes.data());
-            glUniform4fv(glGetUniformLocation(snowShaderProgram, "dirLightCascadeNearDepths"), 1, glm::value_ptr(cascadeNearPlanes));
-            glUniform4fv(glGetUniformLocation(snowShaderProgram, "dirLightCascadeFarDepths"), 1, glm::value_ptr(cascadeFarPlanes));
-            glUniform1i(glGetUniformLocation(snowShaderProgram, "dirLightNumCascades"), numDirLightCascades);
+            const auto& snowVariant = snowPrograms.get(lightingPermutation);
+            const auto& snowUniforms = *snowVariant.uniforms;
+            glUseProgram(snowVariant.program);
+            snowUniforms.time.set(currentTime);
+            snowUniforms.cameraPos.set(camera->getCameraPos());
+            snowUniforms.pointLightMinSampleSizes.set(pointLightMinSampleSizes.data(), pointLightMinSampleSizes.size());
+            snowUniforms.pointLightMaxSampleSizes.set(pointLightMaxSampleSizes.data(), pointLightMaxSampleSizes.size());
+            snowUniforms.spotLightMinSampleSizes.set(spotLightMinSampleSizes.data(), spotLightMinSampleSizes.size());
+            snowUniforms.spotLightMaxSampleSizes.set(spotLightMaxSampleSizes.data(), spotLightMaxSampleSizes.size());
+            snowUniforms.dirLightSampleSizes.set(dirLightSampleSizes.data(), dirLightSampleSizes.size());
+            snowUniforms.dirLightCascadeNearDepths.set(cascadeNearPlanes);
+            snowUniforms.dirLightCascadeFarDepths.set(cascadeFarPlanes);
+            snowUniforms.dirLightNumCascades.set(numDirLightCascades);
+            snowUniforms.clusterScale.set(clusterScale);
+            snowUniforms.clusterDepthRange.set(clusterDepthRange);
 
             glBindVertexArray(snowVAO);
-            glDrawElementsInstanced(GL_TRIANGLES, sphereVertexIndices.size(), GL_UNSIGNED_INT, nullptr, numSnowParticles);
+            GeometryArena::drawMesh(sphereMesh, numSnowParticles);
         }
 
         // Draw skybox
 
         if (bSkybox) {
+            ScopedGPUTimer gpuTimer("Draw skybox");
             glCullFace(GL_FRONT);
             view = glm::mat4(glm::mat3(view));
             glUseProgram(cubeMapShaderProgram);
-            glUniformMatrix4fv(glGetUniformLocation(cubeMapShaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
-            glUniformMatrix4fv(glGetUniformLocation(cubeMapShaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+            skyboxUniforms.view.set(view);
+            skyboxUniforms.projection.set(projection);
             glActiveTexture(GL_TEXTURE0);
             glBindTexture(GL_TEXTURE_CUBE_MAP, TextureLoader::getTextureIdCubeMap(cubeMapFaceTextures));
-            glBindVertexArray(skyboxVAO);
-            glDrawElements(GL_TRIANGLES, skyboxVertexIndices.size(), GL_UNSIGNED_INT, nullptr);
+            glBindVertexArray(lampVAO);
+            GeometryArena::drawMesh(skyboxMesh);
             glCullFace(GL_BACK);
         }
 
         // Draw transparent objects
+        {
+            ScopedGPUTimer gpuTimer("Draw transparent objects");
+            glEnable(GL_BLEND);
 
-        glEnable(GL_BLEND);
+            glUseProgram(cubeVariant.program);
 
-        glUseProgram(cubeShaderProgram);
+            // Only the visible objects are sorted, the objects themselves keep
+            // the order their bounds were placed in
+            visibleInstances.clear();
+            if (launchOptions.bCulling) {
+                ScopedCPUZone cpuZone("Cull transparent objects");
+                transparentCuller.cull({cameraViewProjection}, true, 0, transparentObjects.size(), visibleInstances);
+            } else {
+                for (GLuint i = 0; i < transparentObjects.size(); i++) {
+                    visibleInstances.push_back(i);
+                }
+            }
+            {
+                ScopedCPUZone cpuZone("Sort transparent objects");
+                auto cameraPos = camera->getCameraPos();
+                std::sort(visibleInstances.begin(), visibleInstances.end(), [&](GLuint lhs, GLuint rhs) {
+                    auto lhsPos = glm::vec3(std::get<0>(transparentObjects[lhs])[3]);
+                    auto rhsPos = glm::vec3(std::get<0>(transparentObjects[rhs])[3]);
+                    return glm::length(lhsPos - cameraPos) > glm::length(rhsPos - cameraPos);
+                });
+            }
 
-        std::sort(transparentObjects.begin(), transparentObjects.end(),
-                  [&camera](const std::tuple<glm::mat4, glm::mat3, Material>& rhs, const std::tuple<glm::mat4, glm::mat3, Material>& lhs) {
-                      auto cameraPos = camera->getCameraPos();
-                      auto rhs_pos = glm::vec3(std::get<0>(rhs)[3]);
-                      auto lhs_pos = glm::vec3(std::get<0>(lhs)[3]);
-                      return glm::length(rhs_pos - cameraPos) > glm::length(lhs_pos - cameraPos);
-                  });
+            glBindVertexArray(modelVAO);
+            const MaterialLayers* boundLayers = nullptr;
+            for (GLuint i: visibleInstances) {
+                const auto& [model, normal, material] = transparentObjects[i];
+                if (!boundLayers or !hasSameArrays(*boundLayers, material)) {
+                    bindMaterialTextures(material);
+                    boundLayers = &material;
+                }
+                setModelAttributes(model, normal, material.attributes);
+                GeometryArena::drawMesh(transparentObjectMesh);
+            }
 
-        for (const auto& [model, normal, material]: transparentObjects) {
-            setShaderMatrial(cubeShaderProgram, material);
-            setModelUniforms(cubeShaderProgram, model, normal);
-            glBindVertexArray(transparentVAO);
-            glDrawElements(GL_TRIANGLES, transparentObjectVertexIndices.size(), GL_UNSIGNED_INT, nullptr);
+            glDisable(GL_BLEND);
         }
 
-        glDisable(GL_BLEND);
-
         // Blit MSAA framebuffer
 
         if (bMSAA) {
+            ScopedGPUTimer gpuTimer("Blit MSAA framebuffer");
             glBindFramebuffer(GL_READ_FRAMEBUFFER, MSFBO);
             glBindFramebuffer(GL_DRAW_FRAMEBUFFER, blitFBO);
             glBlitFramebuffer(0, 0, windowW, windowH, 0, 0, windowW, windowH, GL_COLOR_BUFFER_BIT, GL_LINEAR);
@@ -1523,28 +1897,31 @@ int main() {
         glDisable(GL_DEPTH_TEST);
 
         // Setup initial input texture
+        {
+            ScopedGPUTimer gpuTimer("Resolve frame");
+            glBindFramebuffer(GL_FRAMEBUFFER, PPFBO);
+            swapBuffers(fullResReadIndex);
 
-        glBindFramebuffer(GL_FRAMEBUFFER, PPFBO);
-        swapBuffers(fullResReadIndex);
-
-        if (bTAA) {
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D_ARRAY, frameTextureArray);
-            glUseProgram(TAAShaderProgram);
-            glBindVertexArray(screenRectVAO);
-            glDrawElements(GL_TRIANGLES, rectVertexIndices.size(), GL_UNSIGNED_INT, nullptr);
-        } else {
-            glBindFramebuffer(GL_READ_FRAMEBUFFER, blitFBO);
-            glReadBuffer(GL_COLOR_ATTACHMENT0 + colorIndex);
-            glBlitFramebuffer(0, 0, windowW, windowH, 0, 0, windowW, windowH, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+            if (bTAA) {
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D_ARRAY, frameTextureArray);
+                glUseProgram(TAAShaderProgram);
+                glBindVertexArray(screenRectVAO);
+                glDrawElements(GL_TRIANGLES, rectVertexIndices.size(), GL_UNSIGNED_INT, nullptr);
+            } else {
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, blitFBO);
+                glReadBuffer(GL_COLOR_ATTACHMENT0 + colorIndex);
+                glBlitFramebuffer(0, 0, windowW, windowH, 0, 0, windowW, windowH, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, PPFBO);
+            swapBuffers(fullResReadIndex);
         }
-        glBindFramebuffer(GL_FRAMEBUFFER, PPFBO);
-        swapBuffers(fullResReadIndex);
 
         glBindVertexArray(screenRectVAO);
         glActiveTexture(GL_TEXTURE0);
 
         if (bBloom) {
+            ScopedGPUTimer gpuTimer("Bloom");
             glBindFramebuffer(GL_DRAW_FRAMEBUFFER, QRFBO);
             glViewport(0, 0, windowW / 2, windowH / 2);
             swapBuffers(quarterResReadIndex);
@@ -1559,12 +1936,12 @@ int main() {
             swapBuffers(quarterResReadIndex);
 
             glUseProgram(blurShaderProgram);
-            glUniform1i(glGetUniformLocation(blurShaderProgram, "inputFrame"), 0);
-            glUniform1i(glGetUniformLocation(blurShaderProgram, "filterWidth"), 7);
+            blurUniforms.inputFrame.set(0);
+            blurUniforms.filterWidth.set(7);
 
             for (auto horizontal: {0, 1}) {
-                glUniform1i(glGetUniformLocation(blurShaderProgram, "bHorizontal"), horizontal);
-            glUniform1f(glGetUniformLocation(blurShaderProgram, "stride"), 2.0f / (horizontal ? windowW : windowH));
+                blurUniforms.bHorizontal.set(horizontal);
+                blurUniforms.stride.set(2.0f / (horizontal ? windowW : windowH));
                 glBindTexture(GL_TEXTURE_2D, quarterResPPTextures[quarterResReadIndex]);
                 glDrawElements(GL_TRIANGLES, rectVertexIndices.size(), GL_UNSIGNED_INT, nullptr);
                 swapBuffers(quarterResReadIndex);
@@ -1582,6 +1959,7 @@ int main() {
         }
 
         if (bGreyScale) {
+            ScopedGPUTimer gpuTimer("Greyscale");
             glUseProgram(greyscaleShaderProgram);
             glBindTexture(GL_TEXTURE_2D, fullResPPTextures[fullResReadIndex]);
             glDrawElements(GL_TRIANGLES, rectVertexIndices.size(), GL_UNSIGNED_INT, nullptr);
@@ -1589,14 +1967,18 @@ int main() {
         }
 
         if (bGammaCorrect) {
+            ScopedGPUTimer gpuTimer("Gamma correction");
             glUseProgram(gammaCorrectionShaderProgram);
             glBindTexture(GL_TEXTURE_2D, fullResPPTextures[fullResReadIndex]);
             glDrawElements(GL_TRIANGLES, rectVertexIndices.size(), GL_UNSIGNED_INT, nullptr);
             swapBuffers(fullResReadIndex);
         }
 
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-        glBlitFramebuffer(0, 0, windowW, windowH, 0, 0, windowW, windowH, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        {
+            ScopedGPUTimer gpuTimer("Present");
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            glBlitFramebuffer(0, 0, windowW, windowH, 0, 0, windowW, windowH, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        }
 
         if (bShowMag) {
             glUseProgram(screenRectShaderProgram);
@@ -1605,14 +1987,53 @@ int main() {
             glDrawElements(GL_TRIANGLES, rectVertexIndices.size(), GL_UNSIGNED_INT, nullptr);
         }
 
+        GPUProfiler::endFrame();
+
+        if (bShowProfiler) {
+            drawProfilerOverlay(profilerShaderProgram, profilerUniforms, screenRectVAO, rectVertexIndices.size());
+            if (window and frameNumber % 30 == 0) {
+                updateProfilerTitle(window);
+            }
+        }
+
         glEnable(GL_DEPTH_TEST);
 
         colorIndex = (colorIndex + 1) % TAASamples;
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        if (bBenchmark) {
+            benchmark.endFrame();
+        }
+        frameUniforms.endFrame();
+
+        {
+            ScopedCPUZone cpuZone("Swap buffers");
+            CameraManager::swapBuffers();
+        }
 
         previousTime = currentTime;
+        frameNumber++;
+    }
+
+    GPUProfiler::terminate();
+    opaqueDrawCommands.free();
+    visibleSceneInstances.free();
+    geometryArena.free();
+    frameUniforms.free();
+    lightStorage.free();
+    lightClusters.free();
+    TextureLoader::freeTextures();
+    ShaderReloader::terminate();
+    ThreadPool::terminate();
+
+    if (!launchOptions.cpuTrace.empty() and !CPUProfiler::writeTrace(launchOptions.cpuTrace)) {
+        std::fprintf(stderr, "Failed to write CPU trace %s\n", launchOptions.cpuTrace.c_str());
+    }
+
+    if (bBenchmark) {
+        benchmark.finish();
+        if (!benchmark.writeReport(launchOptions.benchmarkReport)) {
+            std::fprintf(stderr, "Failed to write benchmark report %s\n", launchOptions.benchmarkReport.c_str());
+        }
     }
 
     CameraManager::terminate();